@@ -0,0 +1,168 @@
+// Decodes an /api/export body into one CSV row per sample, with a summary on
+// stderr. With -t it instead round-trips synthetic samples through the codec
+// and checks they come back unchanged.
+//
+//   curl -s http://goldsensor.local/api/export?since=0 | build-host/export_decode
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sample_codec.h"
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+        "usage: %s [-t] [-n samples] [file]\n"
+        "  reads stdin if no file is given\n"
+        "  -t round-trips n synthetic samples instead (default 100000)\n", argv0);
+}
+
+static int same(const sample_codec_sample *a, const sample_codec_sample *b)
+{
+    return a->seq == b->seq && a->time_ms == b->time_ms && a->range_mm == b->range_mm &&
+        a->signal_rate == b->signal_rate && a->ambient_rate == b->ambient_rate &&
+        a->sigma == b->sigma && a->range_status == b->range_status && a->rejected == b->rejected;
+}
+
+// A target drifting back and forth at ~30 Hz with jittery timing, noisy
+// values, the odd invalid or rejected sample (status 255 included), dropped
+// samples and extremes, starting just short of the ms clock wrapping.
+static void synthesize(uint32_t i, sample_codec_sample *prev, sample_codec_sample *s)
+{
+    uint32_t r = (uint32_t)rand();
+
+    s->seq = prev->seq + 1 + (r % 500 == 0 ? r % 40 : r % 4999 == 0 ? 0xFFFFFFF0u : 0);
+    s->time_ms = i == 0 ? 0xFFFF0000u : prev->time_ms + 30 + r % 7 + (r % 997 == 0 ? 5000 : 0);
+    s->range_status = r % 23 == 0 ? 4 : r % 101 == 0 ? 2 : r % 53 == 0 ? 255 : 0;
+    s->rejected = (s->range_status != 0 && r % 3 != 0) || r % 37 == 0;
+    s->range_mm = s->range_status == 4 ? 8190 : (uint16_t)(500 + (i / 3) % 1500 + r % 9);
+    s->signal_rate = (uint16_t)(r % 211 == 0 ? 0xFFFF : 1200 + (r >> 8) % 300);
+    s->ambient_rate = (uint16_t)(60 + (r >> 16) % 5);
+    s->sigma = (uint16_t)(r % 307 == 0 ? 0 : 150 + (r >> 4) % 64);
+}
+
+static int self_check(uint32_t samples)
+{
+    sample_codec_state enc, dec;
+    sample_codec_sample prev, s, out;
+    uint8_t *buf = malloc((size_t)samples * SAMPLE_CODEC_MAX_SAMPLE);
+    size_t len = 0, pos = 0, n;
+    uint32_t status_none = 0, status_none_rejected = 0;
+
+    srand(1);
+    memset(&prev, 0, sizeof(prev));
+    prev.seq = 1000;
+    sample_codec_start(&enc, prev.seq);
+    sample_codec_start(&dec, prev.seq);
+    for (uint32_t i = 0; i < samples; i++) {
+        synthesize(i, &prev, &s);
+        n = sample_codec_encode(&enc, &s, buf + len);
+        if (n > SAMPLE_CODEC_MAX_SAMPLE) {
+            fprintf(stderr, "sample %u took %zu bytes\n", i, n);
+            return 1;
+        }
+        len += n;
+        prev = s;
+    }
+
+    srand(1);
+    memset(&prev, 0, sizeof(prev));
+    prev.seq = 1000;
+    for (uint32_t i = 0; i < samples; i++) {
+        synthesize(i, &prev, &s);
+        n = sample_codec_decode(&dec, buf + pos, len - pos, &out);
+        if (!n || !same(&s, &out)) {
+            fprintf(stderr, "sample %u didn't survive: seq %u time %u range %u -> seq %u time %u range %u\n",
+                i, s.seq, s.time_ms, s.range_mm, out.seq, out.time_ms, out.range_mm);
+            return 1;
+        }
+        // Every prefix short of the whole sample must be refused.
+        for (size_t cut = 0; cut < n; cut++) {
+            sample_codec_state copy = dec;
+            if (sample_codec_decode(&copy, buf + pos, cut, &out)) {
+                fprintf(stderr, "sample %u decoded from %zu of its %zu bytes\n", i, cut, n);
+                return 1;
+            }
+        }
+        if (s.range_status == 255) {
+            status_none++;
+            status_none_rejected += s.rejected;
+        }
+        pos += n;
+        prev = s;
+    }
+    if (pos != len) {
+        fprintf(stderr, "%zu bytes left over\n", len - pos);
+        return 1;
+    }
+    fprintf(stderr, "ok: %u samples in %zu bytes, %.2f bytes/sample; status 255 %u times, %u of them rejected\n",
+        samples, len, (double)len / samples, status_none, status_none_rejected);
+    free(buf);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t samples = 100000;
+    int test = 0, opt;
+    FILE *in = stdin;
+    uint8_t *body = NULL;
+    size_t len = 0, cap = 0, pos, n, count = 0;
+    sample_codec_header header;
+    sample_codec_state state;
+    sample_codec_sample s;
+
+    while ((opt = getopt(argc, argv, "tn:h")) != -1) {
+        switch (opt) {
+        case 't': test = 1; break;
+        case 'n': samples = strtoul(optarg, NULL, 0); break;
+        default: usage(argv[0]); return 2;
+        }
+    }
+    if (test) {
+        return self_check(samples);
+    }
+    if (optind < argc && !(in = fopen(argv[optind], "rb"))) {
+        perror(argv[optind]);
+        return 1;
+    }
+
+    do {
+        if (len == cap) {
+            cap = cap ? cap * 2 : 65536;
+            body = realloc(body, cap);
+        }
+        n = fread(body + len, 1, cap - len, in);
+        len += n;
+    } while (n);
+
+    // The header only ever grows at the end, so read what we know of it.
+    memset(&header, 0, sizeof(header));
+    if (len < 8 || memcmp(body, "RSMP", 4) != 0 || body[5] > len) {
+        fprintf(stderr, "not an export\n");
+        return 1;
+    }
+    memcpy(&header, body, body[5] < sizeof(header) ? body[5] : sizeof(header));
+    if (header.version != SAMPLE_CODEC_VERSION) {
+        fprintf(stderr, "export version %u, expected %u\n", header.version, SAMPLE_CODEC_VERSION);
+        return 1;
+    }
+
+    printf("seq,age_ms,range_mm,range_status,rejected,signal_rate_mcps,ambient_rate_mcps,sigma_mm\n");
+    sample_codec_start(&state, header.since);
+    for (pos = header.header_size; pos < len; pos += n) {
+        n = sample_codec_decode(&state, body + pos, len - pos, &s);
+        if (!n) {
+            fprintf(stderr, "export truncated after %zu samples\n", count);
+            return 1;
+        }
+        printf("%u,%u,%u,%u,%u,%.4f,%.4f,%.3f\n", s.seq, header.now_ms - s.time_ms, s.range_mm, s.range_status,
+            s.rejected, s.signal_rate / 256.0, s.ambient_rate / 256.0, s.sigma / 64.0);
+        count++;
+    }
+    fprintf(stderr, "%zu samples in %zu bytes; next since=%u\n", count, len, header.next_since);
+    free(body);
+    return 0;
+}
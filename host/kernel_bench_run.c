@@ -0,0 +1,137 @@
+// Host side of src/kernel_bench.c: times each kernel over the recorded cases
+// in wall-clock ns and, where perf counters are available, retired
+// instructions. The device behind the API is the simulator, so dmax and range
+// status include its register accesses rather than real bus time.
+
+#include <getopt.h>
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "kernel_bench.h"
+#include "sim_ranger.h"
+#include "vl53l0x_sim.h"
+
+static int open_instruction_counter(void)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static uint64_t read_counter(int fd)
+{
+    uint64_t count = 0;
+    if (fd < 0 || read(fd, &count, sizeof(count)) != sizeof(count)) {
+        return 0;
+    }
+    return count;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+    vl53l0x_sim_target target = { .distance_mm = 500, .reflectance = 1.0, .ambient_mcps = 0.2, .seed = 1 };
+    uint32_t iterations = 100000;
+    int verbose = 0, opt, fd;
+    volatile uint32_t sink = 0;
+    VL53L0X_Dev_t *dev;
+    kernel_bench_case live;
+    size_t cases;
+
+    while ((opt = getopt(argc, argv, "n:vh")) != -1) {
+        switch (opt) {
+        case 'n': iterations = strtoul(optarg, NULL, 0); break;
+        case 'v': verbose = 1; break;
+        default:
+            fprintf(stderr, "usage: %s [-n iterations] [-v]\n  -v reports every case\n", argv[0]);
+            return 2;
+        }
+    }
+    if (iterations == 0) {
+        iterations = 1;
+    }
+
+    vl53l0x_sim_reset(&target);
+    dev = calloc(1, sizeof(*dev));
+    if (sim_ranger_init(dev, 30000) ||
+            sim_ranger_check("kernel_bench_record", kernel_bench_record(dev, &live))) {
+        return 1;
+    }
+    cases = kernel_bench_case_count + 1;
+
+    fd = open_instruction_counter();
+    if (fd < 0) {
+        fprintf(stderr, "perf counters unavailable; instructions not reported\n");
+    }
+
+    printf("%-22s %10s %12s %10s  %s\n", "kernel", "ns/call", "instr/call", "worst ns", "worst case");
+    for (int k = 0; k < KERNEL_BENCH_COUNT; k++) {
+        uint64_t total_ns = 0, total_instr = 0, worst_ns = 0;
+        const char *worst_label = "";
+        char instr_str[24] = "-";
+
+        for (size_t i = 0; i < cases; i++) {
+            const kernel_bench_case *c = i < kernel_bench_case_count ? &kernel_bench_cases[i] : &live;
+            uint64_t start, ns, instr;
+
+            // Warm the caches and branch predictors first.
+            for (uint32_t n = 0; n < iterations / 10 + 1; n++) {
+                sink = sink + kernel_bench_call(dev, (kernel_bench_kernel)k, c);
+            }
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+            start = now_ns();
+            for (uint32_t n = 0; n < iterations; n++) {
+                sink = sink + kernel_bench_call(dev, (kernel_bench_kernel)k, c);
+            }
+            ns = now_ns() - start;
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            }
+            instr = read_counter(fd);
+
+            total_ns += ns;
+            total_instr += instr;
+            if (ns > worst_ns) {
+                worst_ns = ns;
+                worst_label = c->label;
+            }
+            if (verbose) {
+                printf("  %-20s %10.1f %12.1f  %s\n", kernel_bench_name((kernel_bench_kernel)k),
+                    (double)ns / iterations, fd >= 0 ? (double)instr / iterations : 0.0, c->label);
+            }
+        }
+        if (fd >= 0) {
+            snprintf(instr_str, sizeof(instr_str), "%.1f", (double)total_instr / ((double)iterations * cases));
+        }
+        printf("%-22s %10.1f %12s %10.1f  %s\n", kernel_bench_name((kernel_bench_kernel)k),
+            (double)total_ns / ((double)iterations * cases), instr_str,
+            (double)worst_ns / iterations, worst_label);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    free(dev);
+    return 0;
+}
@@ -0,0 +1,451 @@
+// Stand-in for a Prometheus remote_write receiver. Listens for POSTs, undoes
+// the snappy and protobuf with its own decoders and prints a line per series,
+// so the device's push mode can be checked without a Prometheus to hand:
+//
+//   build-host/remote_write_receiver -p 9201 -f 3
+//   # const.hpp: #define REMOTE_WRITE_URL "http://<this host>:9201/api/v1/write"
+//
+// -f N answers every Nth request with a 503 to exercise the device's backoff.
+// With -t it instead round-trips synthetic series through
+// src/remote_write_codec.c and checks they come back unchanged.
+
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "remote_write_codec.h"
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+        "usage: %s [-p port] [-f n] [-v]\n"
+        "       %s -t [-n samples]\n"
+        "  -f n   fail every nth request with a 503\n"
+        "  -v     print every sample\n"
+        "  -t     round-trip n synthetic samples per series instead (default 5000)\n", argv0, argv0);
+}
+
+// Returns the decompressed length, or 0 if in isn't valid snappy or doesn't
+// fit cap.
+static size_t unsnappy(const uint8_t *in, size_t len, uint8_t *out, size_t cap)
+{
+    size_t pos = 0, n = 0, expected = 0;
+    int shift = 0;
+
+    do {
+        if (pos == len || shift > 28) {
+            return 0;
+        }
+        expected |= (size_t)(in[pos] & 0x7F) << shift;
+        shift += 7;
+    } while (in[pos++] & 0x80);
+    if (expected > cap) {
+        return 0;
+    }
+
+    while (pos < len) {
+        uint8_t tag = in[pos++];
+        size_t length, offset = 0;
+
+        switch (tag & 3) {
+        case 0:
+            length = tag >> 2;
+            if (length >= 60) {
+                size_t bytes = length - 59;
+                if (pos + bytes > len) {
+                    return 0;
+                }
+                length = 0;
+                for (size_t i = 0; i < bytes; i++) {
+                    length |= (size_t)in[pos++] << (8 * i);
+                }
+            }
+            length++;
+            if (pos + length > len || n + length > expected) {
+                return 0;
+            }
+            memcpy(out + n, in + pos, length);
+            pos += length;
+            n += length;
+            continue;
+        case 1:
+            if (pos + 1 > len) {
+                return 0;
+            }
+            length = ((tag >> 2) & 7) + 4;
+            offset = ((size_t)(tag >> 5) << 8) | in[pos++];
+            break;
+        case 2:
+            if (pos + 2 > len) {
+                return 0;
+            }
+            length = (tag >> 2) + 1;
+            offset = in[pos] | (size_t)in[pos + 1] << 8;
+            pos += 2;
+            break;
+        default:
+            if (pos + 4 > len) {
+                return 0;
+            }
+            length = (tag >> 2) + 1;
+            offset = in[pos] | (size_t)in[pos + 1] << 8 | (size_t)in[pos + 2] << 16 | (size_t)in[pos + 3] << 24;
+            pos += 4;
+            break;
+        }
+        if (offset == 0 || offset > n || n + length > expected) {
+            return 0;
+        }
+        // Copies may overlap what they write, so go a byte at a time.
+        for (size_t i = 0; i < length; i++, n++) {
+            out[n] = out[n - offset];
+        }
+    }
+    return n == expected ? n : 0;
+}
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+} pb_in;
+
+static int get_varint(pb_in *in, uint64_t *value)
+{
+    *value = 0;
+    for (int shift = 0; shift < 64 && in->p < in->end; shift += 7) {
+        uint8_t b = *in->p++;
+        *value |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Reads a field header and, for length-delimited fields, the body as sub.
+static int get_field(pb_in *in, uint32_t *field, uint32_t *wire, pb_in *sub)
+{
+    uint64_t key, len;
+
+    if (!get_varint(in, &key)) {
+        return 0;
+    }
+    *field = (uint32_t)(key >> 3);
+    *wire = (uint32_t)(key & 7);
+    if (*wire == 2) {
+        if (!get_varint(in, &len) || len > (uint64_t)(in->end - in->p)) {
+            return 0;
+        }
+        sub->p = in->p;
+        sub->end = in->p + len;
+        in->p += len;
+    }
+    return 1;
+}
+
+typedef struct {
+    char name[64];
+    char hostname[64];
+    size_t count;
+    remote_write_sample first;
+    remote_write_sample last;
+} series_summary;
+
+// Calls back with each sample of each series; returns the series count, or -1
+// if the request is malformed.
+typedef int (*sample_fn)(void *ctx, const series_summary *series, const remote_write_sample *s);
+
+static int parse_request(const uint8_t *body, size_t len, sample_fn on_sample, void *ctx, int verbose)
+{
+    pb_in request = { body, body + len }, series, item, part;
+    uint32_t field, wire;
+    int count = 0;
+
+    while (request.p < request.end) {
+        series_summary summary;
+
+        if (!get_field(&request, &field, &wire, &series) || field != 1 || wire != 2) {
+            return -1;
+        }
+        memset(&summary, 0, sizeof(summary));
+        while (series.p < series.end) {
+            if (!get_field(&series, &field, &wire, &item) || wire != 2) {
+                return -1;
+            }
+            if (field == 1) {
+                char name[64] = "", value[64] = "";
+                while (item.p < item.end) {
+                    uint32_t f, w;
+                    if (!get_field(&item, &f, &w, &part) || w != 2) {
+                        return -1;
+                    }
+                    size_t n = (size_t)(part.end - part.p) < sizeof(name) - 1 ? (size_t)(part.end - part.p) : sizeof(name) - 1;
+                    memcpy(f == 1 ? name : value, part.p, n);
+                    (f == 1 ? name : value)[n] = 0;
+                }
+                if (strcmp(name, "__name__") == 0) {
+                    strcpy(summary.name, value);
+                } else if (strcmp(name, "hostname") == 0) {
+                    strcpy(summary.hostname, value);
+                }
+            } else if (field == 2) {
+                remote_write_sample s = { 0, 0 };
+                while (item.p < item.end) {
+                    uint32_t f, w;
+                    uint64_t v;
+                    if (!get_field(&item, &f, &w, &part)) {
+                        return -1;
+                    }
+                    if (f == 1 && w == 1 && item.end - item.p >= 8) {
+                        memcpy(&s.value, item.p, 8);
+                        item.p += 8;
+                    } else if (f == 2 && w == 0 && get_varint(&item, &v)) {
+                        s.timestamp_ms = (int64_t)v;
+                    } else {
+                        return -1;
+                    }
+                }
+                if (!summary.count) {
+                    summary.first = s;
+                }
+                summary.last = s;
+                summary.count++;
+                if (on_sample && !on_sample(ctx, &summary, &s)) {
+                    return -1;
+                }
+                if (verbose) {
+                    printf("  %s %lld %g\n", summary.name, (long long)s.timestamp_ms, s.value);
+                }
+            }
+        }
+        if (!on_sample) {
+            printf("%s{hostname=\"%s\"} %zu samples, %lld..%lld ms, first %g last %g\n", summary.name,
+                summary.hostname, summary.count, (long long)summary.first.timestamp_ms,
+                (long long)summary.last.timestamp_ms, summary.first.value, summary.last.value);
+        }
+        count++;
+    }
+    return count;
+}
+
+// Self-check: three series, one of which skips every seventh sample and one
+// of which is left empty entirely.
+static const char *const test_names[] = { "ranger_range_mm", "ranger_signal_rate_mcps", "ranger_empty" };
+
+static void test_sample(size_t series, size_t index, remote_write_sample *out)
+{
+    out->timestamp_ms = 1700000000000LL + (int64_t)index * 33;
+    out->value = series == 0 ? (double)(500 + index % 1500) : 1.5 + (double)(index % 13) / 256;
+}
+
+static bool test_get(void *ctx, size_t series, size_t index, remote_write_sample *out)
+{
+    (void)ctx;
+    if (series == 2 || (series == 0 && index % 7 == 3)) {
+        return false;
+    }
+    test_sample(series, index, out);
+    return true;
+}
+
+typedef struct {
+    size_t next[3];
+    int errors;
+} test_state;
+
+static int test_check(void *ctx, const series_summary *series, const remote_write_sample *s)
+{
+    test_state *state = ctx;
+    remote_write_sample expected;
+    size_t i;
+
+    for (i = 0; i < 3 && strcmp(series->name, test_names[i]) != 0; i++) {
+    }
+    if (i == 3 || strcmp(series->hostname, "test") != 0) {
+        return 0;
+    }
+    while (!test_get(NULL, i, state->next[i], &expected)) {
+        state->next[i]++;
+    }
+    state->next[i]++;
+    if (expected.value != s->value || expected.timestamp_ms != s->timestamp_ms) {
+        fprintf(stderr, "%s sample %zu: expected %g@%lld, got %g@%lld\n", series->name, state->next[i] - 1,
+            expected.value, (long long)expected.timestamp_ms, s->value, (long long)s->timestamp_ms);
+        state->errors++;
+    }
+    return 1;
+}
+
+static int self_check(size_t samples)
+{
+    static uint16_t table[REMOTE_WRITE_SNAPPY_TABLE_SIZE];
+    size_t len = remote_write_encode(test_names, 3, samples, "test", test_get, NULL, NULL, 0);
+    uint8_t *pb = malloc(len), *compressed = malloc(remote_write_snappy_bound(len)), *back = malloc(len);
+    test_state state;
+    size_t clen, n;
+    int series;
+
+    if (remote_write_encode(test_names, 3, samples, "test", test_get, NULL, pb, len) != len ||
+            remote_write_encode(test_names, 3, samples, "test", test_get, NULL, pb, len - 1) != 0) {
+        fprintf(stderr, "encode disagrees with its own measurement\n");
+        return 1;
+    }
+    clen = remote_write_snappy(pb, len, compressed, table);
+    if (clen > remote_write_snappy_bound(len)) {
+        fprintf(stderr, "snappy overran its bound\n");
+        return 1;
+    }
+    n = unsnappy(compressed, clen, back, len);
+    if (n != len || memcmp(pb, back, len) != 0) {
+        fprintf(stderr, "snappy didn't round-trip\n");
+        return 1;
+    }
+
+    memset(&state, 0, sizeof(state));
+    series = parse_request(back, len, test_check, &state, 0);
+    if (series != 2 || state.errors || state.next[1] != samples) {
+        fprintf(stderr, "protobuf didn't round-trip: %d series, %d errors\n", series, state.errors);
+        return 1;
+    }
+    fprintf(stderr, "ok: %zu samples in %zu bytes of protobuf, %zu snappy (%.1f%%)\n",
+        samples, len, clen, 100.0 * clen / len);
+    free(pb);
+    free(compressed);
+    free(back);
+    return 0;
+}
+
+// Reads one request and returns its body, or NULL if the connection ended.
+static uint8_t *read_request(int fd, size_t *body_len, char *request_line, size_t line_cap, int *snappy)
+{
+    static char head[8192];
+    size_t n = 0, content_length = 0;
+    char *end = NULL, *line;
+    uint8_t *body;
+    ssize_t r;
+
+    while (!end) {
+        if (n == sizeof(head) - 1 || (r = read(fd, head + n, sizeof(head) - 1 - n)) <= 0) {
+            return NULL;
+        }
+        n += (size_t)r;
+        head[n] = 0;
+        end = strstr(head, "\r\n\r\n");
+    }
+    *end = 0;
+    snprintf(request_line, line_cap, "%.*s", (int)strcspn(head, "\r\n"), head);
+    *snappy = 0;
+    for (line = strstr(head, "\r\n"); line; line = strstr(line + 2, "\r\n")) {
+        if (strncasecmp(line + 2, "Content-Length:", 15) == 0) {
+            content_length = strtoul(line + 17, NULL, 10);
+        } else if (strncasecmp(line + 2, "Content-Encoding: snappy", 24) == 0) {
+            *snappy = 1;
+        }
+    }
+
+    body = malloc(content_length + 1);
+    size_t have = n - (size_t)(end + 4 - head);
+    if (have > content_length) {
+        have = content_length;
+    }
+    memcpy(body, end + 4, have);
+    while (have < content_length) {
+        if ((r = read(fd, body + have, content_length - have)) <= 0) {
+            free(body);
+            return NULL;
+        }
+        have += (size_t)r;
+    }
+    *body_len = content_length;
+    return body;
+}
+
+static void respond(int fd, const char *status)
+{
+    char buf[128];
+    int n = snprintf(buf, sizeof(buf), "HTTP/1.1 %s\r\nContent-Length: 0\r\n\r\n", status);
+    if (write(fd, buf, (size_t)n) != n) {
+        perror("write");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int port = 9201, fail_every = 0, verbose = 0, test = 0, opt, listener, one = 1;
+    size_t samples = 5000;
+    unsigned long requests = 0;
+    struct sockaddr_in addr;
+
+    while ((opt = getopt(argc, argv, "p:f:vtn:h")) != -1) {
+        switch (opt) {
+        case 'p': port = atoi(optarg); break;
+        case 'f': fail_every = atoi(optarg); break;
+        case 'v': verbose = 1; break;
+        case 't': test = 1; break;
+        case 'n': samples = strtoul(optarg, NULL, 0); break;
+        default: usage(argv[0]); return 2;
+        }
+    }
+    if (test) {
+        return self_check(samples ? samples : 1);
+    }
+
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons((uint16_t)port);
+    if (bind(listener, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listener, 4) < 0) {
+        perror("listen");
+        return 1;
+    }
+    fprintf(stderr, "listening on port %d\n", port);
+
+    while (1) {
+        struct sockaddr_in peer;
+        socklen_t peer_len = sizeof(peer);
+        int fd = accept(listener, (struct sockaddr *)&peer, &peer_len);
+        if (fd < 0) {
+            perror("accept");
+            continue;
+        }
+        // Keep-alive: serve requests until the client hangs up.
+        while (1) {
+            char request_line[128];
+            size_t len, plain_len;
+            int snappy;
+            uint8_t *body = read_request(fd, &len, request_line, sizeof(request_line), &snappy);
+            if (!body) {
+                break;
+            }
+            requests++;
+            printf("#%lu %s from %s: %zu bytes\n", requests, request_line, inet_ntoa(peer.sin_addr), len);
+            if (fail_every && requests % (unsigned long)fail_every == 0) {
+                printf("  failing it on purpose\n");
+                respond(fd, "503 Service Unavailable");
+                free(body);
+                continue;
+            }
+
+            // Remote write bodies are small; real receivers cap them too.
+            uint8_t *plain = malloc(1 << 22);
+            plain_len = snappy ? unsnappy(body, len, plain, 1 << 22) : 0;
+            if (!plain_len || parse_request(plain, plain_len, NULL, NULL, verbose) < 0) {
+                printf("  malformed\n");
+                respond(fd, "400 Bad Request");
+            } else {
+                respond(fd, "204 No Content");
+            }
+            fflush(stdout);
+            free(plain);
+            free(body);
+        }
+        close(fd);
+    }
+}
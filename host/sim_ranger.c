@@ -0,0 +1,45 @@
+#include <stdio.h>
+
+#include "vl53l0x_api.h"
+#include "sim_ranger.h"
+
+int sim_ranger_check(const char *op, VL53L0X_Error Status)
+{
+    char buf[VL53L0X_MAX_STRING_LENGTH];
+    if (Status == VL53L0X_ERROR_NONE) {
+        return 0;
+    }
+    VL53L0X_GetPalErrorString(Status, buf);
+    fprintf(stderr, "API(%s) Status: %i : %s\n", op, Status, buf);
+    return 1;
+}
+
+int sim_ranger_init(VL53L0X_Dev_t *dev, uint32_t budget_us)
+{
+    VL53L0X_DeviceInfo_t info;
+    uint8_t vhv, phase;
+
+    dev->I2cDevAddr = 0x29;
+    dev->comms_type = 1;
+    dev->comms_speed_khz = 400;
+
+    if (sim_ranger_check("VL53L0X_DataInit", VL53L0X_DataInit(dev)) ||
+            sim_ranger_check("VL53L0X_GetDeviceInfo", VL53L0X_GetDeviceInfo(dev, &info))) {
+        return 1;
+    }
+    fprintf(stderr, "%s %s rev %d.%d\n", info.Name, info.ProductId,
+        info.ProductRevisionMajor, info.ProductRevisionMinor);
+
+    if (sim_ranger_check("VL53L0X_StaticInit", VL53L0X_StaticInit(dev)) ||
+            sim_ranger_check("VL53L0X_PerformRefCalibration", VL53L0X_PerformRefCalibration(dev, &vhv, &phase)) ||
+            sim_ranger_check("VL53L0X_SetLimitCheckValue", VL53L0X_SetLimitCheckValue(dev,
+                VL53L0X_CHECKENABLE_SIGNAL_RATE_FINAL_RANGE, (FixPoint1616_t)(0.5*65536))) ||
+            sim_ranger_check("VL53L0X_SetLimitCheckValue", VL53L0X_SetLimitCheckValue(dev,
+                VL53L0X_CHECKENABLE_SIGMA_FINAL_RANGE, (FixPoint1616_t)(18*65536))) ||
+            sim_ranger_check("VL53L0X_SetMeasurementTimingBudgetMicroSeconds",
+                VL53L0X_SetMeasurementTimingBudgetMicroSeconds(dev, budget_us))) {
+        return 1;
+    }
+    fprintf(stderr, "ref calibration: vhv %u phase %u\n", vhv, phase);
+    return 0;
+}
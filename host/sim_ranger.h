@@ -0,0 +1,11 @@
+#pragma once
+
+#include <stdint.h>
+#include "vl53l0x_api.h"
+
+// ranger_init() from src/ranger.cpp for the host tools: DataInit through the
+// timing budget, reporting API errors on stderr. Returns non-zero on failure.
+int sim_ranger_init(VL53L0X_Dev_t *dev, uint32_t budget_us);
+
+// Prints the API error for op to stderr. Returns non-zero if Status is an error.
+int sim_ranger_check(const char *op, VL53L0X_Error Status);
@@ -0,0 +1,616 @@
+// Host stand-in for src/vl53l0x_i2c_platform.cpp. See vl53l0x_sim.h.
+//
+// The model covers what the ST API actually touches: register pages selected
+// through 0xFF, the NVM read strobe on page 7, soft reset, reference
+// calibration, single/back-to-back/timed ranging and the interrupt status and
+// clear registers. Everything else is plain storage.
+
+#include <math.h>
+#include <string.h>
+
+#include "vl53l0x_i2c_platform.h"
+#include "vl53l0x_sim.h"
+
+#define STATUS_OK              0x00
+#define STATUS_FAIL            0x01
+
+#define I2C_FREQ_HZ            400000
+#define SIM_I2C_ADDRESS        0x29
+
+// Measurement overheads, roughly as the API budgets them.
+#define SIM_START_OVERHEAD_US  1910
+#define SIM_REF_CAL_US         1500
+
+// Device range status codes as reported in RESULT_RANGE_STATUS bits 3..6.
+#define SIM_DEVICE_STATUS_SIGNAL_FAIL 4
+#define SIM_DEVICE_STATUS_RANGE_VALID 11
+
+// Return signal from the 88% calibration target at 400 mm, in Mcps.
+#define SIM_SIGNAL_AT_400MM    12.5
+#define SIM_NVM_OFFSET_MM      5
+
+typedef enum {
+    SIM_IDLE,
+    SIM_SINGLE,
+    SIM_BACK_TO_BACK,
+    SIM_TIMED,
+} sim_mode;
+
+static uint8_t regs[256][256];
+static uint8_t page;
+static uint32_t nvm[256];
+static bool in_reset;
+
+static vl53l0x_sim_target target;
+static uint64_t rng_state;
+
+static uint64_t now_us;
+static uint64_t bus_time_us;
+static uint32_t transaction_count;
+
+static sim_mode mode;
+static bool ref_cal;
+static uint64_t measurement_done_us;
+static uint64_t next_start_us;
+
+static uint16_t reg_word(uint8_t p, uint8_t index)
+{
+    return ((uint16_t)regs[p][index] << 8) | regs[p][(uint8_t)(index + 1)];
+}
+
+static uint32_t reg_dword(uint8_t p, uint8_t index)
+{
+    return ((uint32_t)reg_word(p, index) << 16) | reg_word(p, (uint8_t)(index + 2));
+}
+
+static void set_reg_word(uint8_t p, uint8_t index, uint16_t value)
+{
+    regs[p][index] = (uint8_t)(value >> 8);
+    regs[p][(uint8_t)(index + 1)] = (uint8_t)value;
+}
+
+// Product id as the API unpacks it: 7-bit characters packed MSB first across
+// four consecutive NVM words.
+static void nvm_pack_product_id(const char *id)
+{
+    int bit = 0;
+    for (int i = 0; i < 18 && id[i]; i++) {
+        for (int b = 6; b >= 0; b--, bit++) {
+            if ((id[i] >> b) & 1) {
+                nvm[0x77 + bit / 32] |= 0x80000000u >> (bit % 32);
+            }
+        }
+    }
+}
+
+static void nvm_init(void)
+{
+    uint16_t signal_97 = (uint16_t)(SIM_SIGNAL_AT_400MM * 128);
+    uint16_t distance_114 = (uint16_t)((400 + SIM_NVM_OFFSET_MM) * 16);
+
+    memset(nvm, 0, sizeof(nvm));
+    // Reference SPADs: 4 aperture SPADs, all 44 good.
+    nvm[0x6b] = (1u << 15) | (4u << 8);
+    nvm[0x24] = 0xFFFFFFFF;
+    nvm[0x25] = 0xFF0F0000;
+    nvm[0x02] = 0x01000000;
+    nvm[0x7B] = 0x10A2B3C4;
+    nvm[0x7C] = 0xD5E6F708;
+    nvm_pack_product_id("VL53L0CBV0DH/1$1");
+    nvm[0x73] = signal_97 >> 8;
+    nvm[0x74] = (uint32_t)(signal_97 & 0xFF) << 24;
+    nvm[0x75] = distance_114 >> 8;
+    nvm[0x76] = (uint32_t)(distance_114 & 0xFF) << 24;
+}
+
+// Register values after boot. Only those the API reads before writing them
+// matter.
+static void regs_init(void)
+{
+    memset(regs, 0, sizeof(regs));
+    page = 0;
+    in_reset = false;
+    mode = SIM_IDLE;
+    ref_cal = false;
+
+    regs[0][VL53L0X_REG_SYSTEM_SEQUENCE_CONFIG] = 0xFF;
+    regs[0][VL53L0X_REG_SYSTEM_INTERRUPT_CONFIG_GPIO] = 0x04;
+    regs[0][VL53L0X_REG_GPIO_HV_MUX_ACTIVE_HIGH] = 0x01;
+    regs[0][VL53L0X_REG_PRE_RANGE_CONFIG_VCSEL_PERIOD] = 0x06;
+    regs[0][VL53L0X_REG_FINAL_RANGE_CONFIG_VCSEL_PERIOD] = 0x04;
+    regs[0][VL53L0X_REG_MSRC_CONFIG_TIMEOUT_MACROP] = 0x2B;
+    set_reg_word(0, VL53L0X_REG_PRE_RANGE_CONFIG_TIMEOUT_MACROP_HI, 0x0037);
+    set_reg_word(0, VL53L0X_REG_FINAL_RANGE_CONFIG_TIMEOUT_MACROP_HI, 0x02C4);
+    set_reg_word(0, VL53L0X_REG_FINAL_RANGE_CONFIG_MIN_COUNT_RATE_RTN_LIMIT, 0x0020);
+    set_reg_word(0, VL53L0X_REG_OSC_CALIBRATE_VAL, 0x03E8);
+    // Boot firmware loads the part-to-part offset from NVM.
+    set_reg_word(0, VL53L0X_REG_ALGO_PART_TO_PART_RANGE_OFFSET_MM,
+        (uint16_t)(-SIM_NVM_OFFSET_MM * 4) & 0x0FFF);
+    regs[0][VL53L0X_REG_IDENTIFICATION_MODEL_ID] = 0xEE;
+    regs[0][VL53L0X_REG_IDENTIFICATION_REVISION_ID] = 0x10;
+    regs[0][VL53L0X_REG_SOFT_RESET_GO2_SOFT_RESET_N] = 0x01;
+    regs[0][0xCB] = 0x20;
+    regs[0][0xEE] = 0x80;
+    // Stop variable and oscillator frequency (4.12 MHz) on page 1.
+    regs[1][0x91] = 0x3C;
+    set_reg_word(1, 0x84, 0x970A);
+    set_reg_word(1, VL53L0X_REG_RESULT_PEAK_SIGNAL_RATE_REF, 0x0020);
+}
+
+// xorshift64* and Box-Muller; the same seed always yields the same samples.
+static double rng_uniform(void)
+{
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return ((rng_state * 0x2545F4914F6CDD1DULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double rng_gaussian(void)
+{
+    double u1 = rng_uniform();
+    double u2 = rng_uniform();
+    if (u1 < 1e-300) {
+        u1 = 1e-300;
+    }
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+static uint32_t decode_timeout(uint16_t encoded)
+{
+    return ((uint32_t)(encoded & 0xFF) << (encoded >> 8)) + 1;
+}
+
+static double macro_period_us(uint8_t vcsel_reg)
+{
+    uint32_t pclks = ((uint32_t)vcsel_reg + 1) << 1;
+    return 2304.0 * pclks * 1655.0 / 1e6;
+}
+
+// How long one ranging takes with the sequence and timeouts currently
+// programmed; this is what SetMeasurementTimingBudget is aiming at.
+static uint64_t measurement_us(void)
+{
+    uint8_t seq = regs[0][VL53L0X_REG_SYSTEM_SEQUENCE_CONFIG];
+    double pre_macro = macro_period_us(regs[0][VL53L0X_REG_PRE_RANGE_CONFIG_VCSEL_PERIOD]);
+    double final_macro = macro_period_us(regs[0][VL53L0X_REG_FINAL_RANGE_CONFIG_VCSEL_PERIOD]);
+    uint32_t msrc = regs[0][VL53L0X_REG_MSRC_CONFIG_TIMEOUT_MACROP] + 1;
+    uint32_t pre = decode_timeout(reg_word(0, VL53L0X_REG_PRE_RANGE_CONFIG_TIMEOUT_MACROP_HI));
+    uint32_t final = decode_timeout(reg_word(0, VL53L0X_REG_FINAL_RANGE_CONFIG_TIMEOUT_MACROP_HI));
+    double us = SIM_START_OVERHEAD_US;
+
+    if (seq & 0x10) {
+        us += msrc * pre_macro + 590;
+    }
+    if (seq & 0x0C) {
+        us += 2 * (msrc * pre_macro + 690);
+    }
+    if (seq & 0x40) {
+        us += pre * pre_macro + 660;
+    }
+    if (seq & 0x80) {
+        // The final range timeout includes the pre-range window.
+        if ((seq & 0x40) && final > pre) {
+            final -= pre;
+        }
+        us += final * final_macro + 550;
+    }
+    return (uint64_t)us;
+}
+
+static uint64_t inter_measurement_us(void)
+{
+    uint32_t period = reg_dword(0, VL53L0X_REG_SYSTEM_INTERMEASUREMENT_PERIOD);
+    uint16_t osc = reg_word(0, VL53L0X_REG_OSC_CALIBRATE_VAL);
+    if (osc) {
+        period /= osc;
+    }
+    return (uint64_t)period * 1000;
+}
+
+static void start_measurement(sim_mode m, bool calibration)
+{
+    mode = m;
+    ref_cal = calibration;
+    measurement_done_us = now_us + (calibration ? SIM_REF_CAL_US : measurement_us());
+    next_start_us = now_us;
+}
+
+static void raise_interrupt(void)
+{
+    uint8_t config = regs[0][VL53L0X_REG_SYSTEM_INTERRUPT_CONFIG_GPIO] & 0x07;
+    regs[0][VL53L0X_REG_RESULT_INTERRUPT_STATUS] = config ? config : 0x04;
+}
+
+// The threshold functions only interrupt for ranges past the thresholds,
+// which hold half the distance in mm; the firmware doubles them.
+static void range_interrupt(double range_mm)
+{
+    uint8_t config = regs[0][VL53L0X_REG_SYSTEM_INTERRUPT_CONFIG_GPIO] & 0x07;
+    double low = reg_word(0, VL53L0X_REG_SYSTEM_THRESH_LOW) * 2.0;
+    double high = reg_word(0, VL53L0X_REG_SYSTEM_THRESH_HIGH) * 2.0;
+
+    switch (config) {
+    case VL53L0X_REG_SYSTEM_INTERRUPT_GPIO_LEVEL_LOW:
+        if (range_mm < low) {
+            raise_interrupt();
+        }
+        break;
+    case VL53L0X_REG_SYSTEM_INTERRUPT_GPIO_LEVEL_HIGH:
+        if (range_mm > high) {
+            raise_interrupt();
+        }
+        break;
+    case VL53L0X_REG_SYSTEM_INTERRUPT_GPIO_OUT_OF_WINDOW:
+        if (range_mm < low || range_mm > high) {
+            raise_interrupt();
+        }
+        break;
+    default:
+        raise_interrupt();
+        break;
+    }
+}
+
+static void complete_measurement(void)
+{
+    uint64_t duration = measurement_done_us - next_start_us;
+    double d = target.distance_mm > 1 ? target.distance_mm : 1;
+    double signal = SIM_SIGNAL_AT_400MM * target.reflectance * (400.0 / d) * (400.0 / d);
+    double ambient = target.ambient_mcps;
+    double limit = reg_word(0, VL53L0X_REG_FINAL_RANGE_CONFIG_MIN_COUNT_RATE_RTN_LIMIT) / 128.0;
+    uint8_t *result = &regs[0][VL53L0X_REG_RESULT_RANGE_STATUS];
+    uint8_t device_status;
+    double spads, sd_mm, range_mm;
+    int16_t offset_q2;
+
+    if (ref_cal) {
+        raise_interrupt();
+        return;
+    }
+
+    // Shot noise on the return: the spread grows with ambient and shrinks
+    // with the integration time.
+    signal *= 1.0 + 0.02 * rng_gaussian();
+    if (signal < 0) {
+        signal = 0;
+    }
+    ambient *= 1.0 + 0.05 * fabs(rng_gaussian());
+    sd_mm = 1.0;
+    if (signal > 0) {
+        double shot = 5.0 * sqrt(25000.0 / (double)duration) * sqrt(signal + ambient) / signal;
+        sd_mm = sqrt(1.0 + shot * shot);
+    }
+
+    // The offset register is 12-bit signed in quarter millimetres and is
+    // applied by the device itself.
+    offset_q2 = (int16_t)(reg_word(0, VL53L0X_REG_ALGO_PART_TO_PART_RANGE_OFFSET_MM) << 4) >> 4;
+    range_mm = target.distance_mm + SIM_NVM_OFFSET_MM + offset_q2 / 4.0 + sd_mm * rng_gaussian();
+
+    // Dynamic SPAD selection keeps the per-SPAD rate roughly constant.
+    spads = signal > 0 ? 300.0 / signal : 180;
+    spads = spads < 4 ? 4 : (spads > 180 ? 180 : spads);
+
+    if (signal < limit || signal <= 0) {
+        device_status = SIM_DEVICE_STATUS_SIGNAL_FAIL;
+        range_mm = 8190;
+    } else {
+        device_status = SIM_DEVICE_STATUS_RANGE_VALID;
+    }
+    if (range_mm < 0) {
+        range_mm = 0;
+    }
+    if (regs[0][VL53L0X_REG_SYSTEM_RANGE_CONFIG] & 0x01) {
+        range_mm *= 4;
+    }
+    if (range_mm > 0xFFFF) {
+        range_mm = 0xFFFF;
+    }
+    if (signal > 511) {
+        signal = 511;
+    }
+    if (ambient > 511) {
+        ambient = 511;
+    }
+
+    memset(result, 0, 12);
+    result[0] = (uint8_t)(device_status << 3) | 0x01;
+    set_reg_word(0, VL53L0X_REG_RESULT_RANGE_STATUS + 2, (uint16_t)(spads * 256));
+    set_reg_word(0, VL53L0X_REG_RESULT_RANGE_STATUS + 6, (uint16_t)(signal * 128));
+    set_reg_word(0, VL53L0X_REG_RESULT_RANGE_STATUS + 8, (uint16_t)(ambient * 128));
+    set_reg_word(0, VL53L0X_REG_RESULT_RANGE_STATUS + 10, (uint16_t)range_mm);
+    range_interrupt(regs[0][VL53L0X_REG_SYSTEM_RANGE_CONFIG] & 0x01 ? range_mm / 4 : range_mm);
+}
+
+// Runs the state machine up to the current virtual time.
+static void advance(void)
+{
+    while (mode != SIM_IDLE && now_us >= measurement_done_us) {
+        complete_measurement();
+        switch (mode) {
+        case SIM_BACK_TO_BACK:
+            next_start_us = measurement_done_us;
+            measurement_done_us = next_start_us + measurement_us();
+            break;
+        case SIM_TIMED: {
+            uint64_t period = inter_measurement_us();
+            uint64_t duration = measurement_us();
+            next_start_us += period > duration ? period : duration;
+            measurement_done_us = next_start_us + duration;
+            break;
+        }
+        default:
+            mode = SIM_IDLE;
+            ref_cal = false;
+            break;
+        }
+    }
+}
+
+static void bus_transfer(int32_t bytes, bool read)
+{
+    // Start, address, index, data, plus a repeated start and address for reads.
+    uint32_t bits = 1 + 9 * (2 + bytes) + 1 + (read ? 10 : 0);
+    uint64_t us = ((uint64_t)bits * 1000000 + I2C_FREQ_HZ - 1) / I2C_FREQ_HZ;
+
+    bus_time_us += us;
+    now_us += us;
+    advance();
+}
+
+static void write_register(uint8_t index, uint8_t data)
+{
+    if (index == 0xFF) {
+        page = data;
+        return;
+    }
+    if (page == 0 && index == VL53L0X_REG_SOFT_RESET_GO2_SOFT_RESET_N) {
+        if (data == 0x00) {
+            in_reset = true;
+        } else if (in_reset) {
+            regs_init();
+        }
+        return;
+    }
+    regs[page][index] = data;
+
+    if (page == 0 && index == VL53L0X_REG_SYSRANGE_START) {
+        uint8_t start = data & VL53L0X_REG_SYSRANGE_MODE_MASK;
+        if (start & VL53L0X_REG_SYSRANGE_MODE_BACKTOBACK) {
+            start_measurement(SIM_BACK_TO_BACK, false);
+        } else if (start & VL53L0X_REG_SYSRANGE_MODE_TIMED) {
+            start_measurement(SIM_TIMED, false);
+        } else if (mode == SIM_BACK_TO_BACK || mode == SIM_TIMED) {
+            // Stop request: let the ranging in flight finish, then idle.
+            mode = SIM_SINGLE;
+        } else if (start & VL53L0X_REG_SYSRANGE_MODE_START_STOP) {
+            // Bit 6 (0x40) selects VHV calibration, sequence step 0x02
+            // phase calibration; both are short and produce no result.
+            uint8_t seq = regs[0][VL53L0X_REG_SYSTEM_SEQUENCE_CONFIG];
+            start_measurement(SIM_SINGLE, (data & 0x40) || seq == 0x01 || seq == 0x02);
+        }
+        // The start bit self-clears once the sequencer has picked it up.
+        regs[0][VL53L0X_REG_SYSRANGE_START] &= ~VL53L0X_REG_SYSRANGE_MODE_START_STOP;
+    } else if (page == 0 && index == VL53L0X_REG_SYSTEM_INTERRUPT_CLEAR) {
+        if (data & 0x01) {
+            regs[0][VL53L0X_REG_RESULT_INTERRUPT_STATUS] = 0;
+            regs[0][VL53L0X_REG_RESULT_RANGE_STATUS] &= ~0x01;
+        }
+    } else if (page == 7 && index == 0x83 && data == 0x00) {
+        // NVM read strobe: latch the word addressed through 0x94.
+        uint32_t word = nvm[regs[7][0x94]];
+        regs[7][0x90] = (uint8_t)(word >> 24);
+        regs[7][0x91] = (uint8_t)(word >> 16);
+        regs[7][0x92] = (uint8_t)(word >> 8);
+        regs[7][0x93] = (uint8_t)word;
+        regs[7][0x83] = 0x01;
+    }
+}
+
+static uint8_t read_register(uint8_t index)
+{
+    if (index == 0xFF) {
+        return page;
+    }
+    if (page == 0 && index == VL53L0X_REG_IDENTIFICATION_MODEL_ID && in_reset) {
+        return 0x00;
+    }
+    if (page == 1 && index == 0x04) {
+        // Non-zero while the sequencer is still busy after a stop request.
+        return mode != SIM_IDLE;
+    }
+    return regs[page][index];
+}
+
+void vl53l0x_sim_reset(const vl53l0x_sim_target *t)
+{
+    now_us = 0;
+    bus_time_us = 0;
+    transaction_count = 0;
+    nvm_init();
+    regs_init();
+    vl53l0x_sim_set_target(t);
+    rng_state = t->seed ? t->seed : 0x9E3779B97F4A7C15ULL;
+}
+
+void vl53l0x_sim_set_target(const vl53l0x_sim_target *t)
+{
+    target = *t;
+}
+
+uint64_t vl53l0x_sim_now_us(void)
+{
+    return now_us;
+}
+
+void vl53l0x_sim_advance_us(uint64_t us)
+{
+    now_us += us;
+    advance();
+}
+
+bool vl53l0x_sim_gpio1_asserted(void)
+{
+    return (regs[0][VL53L0X_REG_RESULT_INTERRUPT_STATUS] & 0x07) != 0;
+}
+
+uint64_t vl53l0x_sim_bus_time_us(void)
+{
+    return bus_time_us;
+}
+
+// vl53l0x_i2c_platform.h
+
+uint32_t VL53L0X_get_transaction_count(void)
+{
+    return transaction_count;
+}
+
+uint64_t VL53L0X_get_bus_time_us(void)
+{
+    return bus_time_us;
+}
+
+int32_t VL53L0X_comms_initialise(uint8_t comms_type, uint16_t comms_speed_khz)
+{
+    return STATUS_OK;
+}
+
+int32_t VL53L0X_comms_close(void)
+{
+    return STATUS_OK;
+}
+
+int32_t VL53L0X_write_multi(uint8_t address, uint8_t index, uint8_t *pdata, int32_t count)
+{
+    if (address != SIM_I2C_ADDRESS) {
+        return STATUS_FAIL;
+    }
+    transaction_count++;
+    bus_transfer(count, false);
+    for (int32_t i = 0; i < count; i++) {
+        write_register((uint8_t)(index + i), pdata[i]);
+    }
+    return STATUS_OK;
+}
+
+int32_t VL53L0X_read_multi(uint8_t address, uint8_t index, uint8_t *pdata, int32_t count)
+{
+    if (address != SIM_I2C_ADDRESS) {
+        return STATUS_FAIL;
+    }
+    transaction_count++;
+    bus_transfer(count, true);
+    for (int32_t i = 0; i < count; i++) {
+        pdata[i] = read_register((uint8_t)(index + i));
+    }
+    return STATUS_OK;
+}
+
+int32_t VL53L0X_write_batch(uint8_t address, uint8_t *pqueue, int32_t size)
+{
+    int32_t pos = 0;
+
+    if (address != SIM_I2C_ADDRESS) {
+        return STATUS_FAIL;
+    }
+    transaction_count++;
+    while (pos + 2 <= size) {
+        uint8_t index = pqueue[pos];
+        uint8_t count = pqueue[pos + 1];
+        // Each record after the first costs a repeated start, not a stop/start.
+        bus_transfer(count, false);
+        for (int32_t i = 0; i < count; i++) {
+            write_register((uint8_t)(index + i), pqueue[pos + 2 + i]);
+        }
+        pos += 2 + count;
+    }
+    return STATUS_OK;
+}
+
+int32_t VL53L0X_write_byte(uint8_t address, uint8_t index, uint8_t data)
+{
+    return VL53L0X_write_multi(address, index, &data, 1);
+}
+
+int32_t VL53L0X_write_word(uint8_t address, uint8_t index, uint16_t data)
+{
+    uint8_t buffer[BYTES_PER_WORD] = { (uint8_t)(data >> 8), (uint8_t)data };
+    return VL53L0X_write_multi(address, index, buffer, BYTES_PER_WORD);
+}
+
+int32_t VL53L0X_write_dword(uint8_t address, uint8_t index, uint32_t data)
+{
+    uint8_t buffer[BYTES_PER_DWORD] = {
+        (uint8_t)(data >> 24), (uint8_t)(data >> 16), (uint8_t)(data >> 8), (uint8_t)data,
+    };
+    return VL53L0X_write_multi(address, index, buffer, BYTES_PER_DWORD);
+}
+
+int32_t VL53L0X_read_byte(uint8_t address, uint8_t index, uint8_t *pdata)
+{
+    return VL53L0X_read_multi(address, index, pdata, 1);
+}
+
+int32_t VL53L0X_read_word(uint8_t address, uint8_t index, uint16_t *pdata)
+{
+    uint8_t buffer[BYTES_PER_WORD];
+    int32_t status = VL53L0X_read_multi(address, index, buffer, BYTES_PER_WORD);
+    *pdata = ((uint16_t)buffer[0] << 8) + (uint16_t)buffer[1];
+    return status;
+}
+
+int32_t VL53L0X_read_dword(uint8_t address, uint8_t index, uint32_t *pdata)
+{
+    uint8_t buffer[BYTES_PER_DWORD];
+    int32_t status = VL53L0X_read_multi(address, index, buffer, BYTES_PER_DWORD);
+    *pdata = ((uint32_t)buffer[0] << 24) + ((uint32_t)buffer[1] << 16) +
+        ((uint32_t)buffer[2] << 8) + (uint32_t)buffer[3];
+    return status;
+}
+
+int32_t VL53L0X_platform_wait_us(int32_t wait_us)
+{
+    vl53l0x_sim_advance_us(wait_us);
+    return STATUS_OK;
+}
+
+int32_t VL53L0X_wait_ms(int32_t wait_ms)
+{
+    vl53l0x_sim_advance_us((uint64_t)wait_ms * 1000);
+    return STATUS_OK;
+}
+
+int32_t VL53L0X_set_gpio(uint8_t level)
+{
+    return STATUS_OK;
+}
+
+int32_t VL53L0X_get_gpio(uint8_t *plevel)
+{
+    *plevel = vl53l0x_sim_gpio1_asserted();
+    return STATUS_OK;
+}
+
+int32_t VL53L0X_release_gpio(void)
+{
+    return STATUS_OK;
+}
+
+int32_t VL53L0X_cycle_power(void)
+{
+    vl53l0x_sim_reset(&target);
+    return STATUS_OK;
+}
+
+int32_t VL53L0X_get_timer_frequency(int32_t *ptimer_freq_hz)
+{
+    *ptimer_freq_hz = 1000000;
+    return STATUS_OK;
+}
+
+int32_t VL53L0X_get_timer_value(int32_t *ptimer_count)
+{
+    *ptimer_count = (int32_t)now_us;
+    return STATUS_OK;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+// Simulated VL53L0X for host builds of the ST API. It stands in for
+// src/vl53l0x_i2c_platform.cpp: the API's bus calls land in a paged register
+// file backed by fake NVM, and measurements run on a virtual clock which only
+// moves with bus traffic and waits.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    // What the sensor is looking at.
+    double distance_mm;
+    // Target reflectance relative to the 88% white card ST calibrates with.
+    double reflectance;
+    // Ambient return rate in Mcps; ~0.1 indoors, tens in direct sun.
+    double ambient_mcps;
+    // Seed for the measurement noise, so runs are reproducible.
+    uint32_t seed;
+} vl53l0x_sim_target;
+
+// Power-on reset: registers back to defaults, clock to zero, counters cleared.
+void vl53l0x_sim_reset(const vl53l0x_sim_target *);
+
+// May be called between samples to move the target.
+void vl53l0x_sim_set_target(const vl53l0x_sim_target *);
+
+uint64_t vl53l0x_sim_now_us(void);
+
+// Lets time pass without touching the bus, e.g. to stand in for a task
+// blocked on the GPIO1 interrupt.
+void vl53l0x_sim_advance_us(uint64_t);
+
+// True while GPIO1 is asserting an interrupt, whatever its configured polarity.
+bool vl53l0x_sim_gpio1_asserted(void);
+
+// Virtual microseconds spent on the bus since reset.
+uint64_t vl53l0x_sim_bus_time_us(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,152 @@
+// Brings the ST API up against the simulated sensor, then ranges continuously
+// and prints one CSV row per sample followed by a summary on stderr. With -w
+// the sensor only interrupts for samples outside the window, as the
+// firmware's event mode runs it, and only those are printed.
+
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vl53l0x_api.h"
+#include "vl53l0x_platform.h"
+#include "vl53l0x_sim.h"
+#include "sim_ranger.h"
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+        "usage: %s [-d distance_mm] [-r reflectance] [-a ambient_mcps] [-s seed]\n"
+        "          [-n samples] [-b budget_us] [-p period_ms] [-v mm_per_s]\n"
+        "          [-w low_mm:high_mm [-t seconds]]\n"
+        "  reflectance is relative to the 88%% white target (1.0)\n"
+        "  period_ms of 0 ranges back-to-back\n"
+        "  mm_per_s moves the target away (or closer if negative) as time passes\n"
+        "  -w interrupts only outside the window, for up to -t virtual seconds\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    vl53l0x_sim_target target = {
+        .distance_mm = 500,
+        .reflectance = 1.0,
+        .ambient_mcps = 0.2,
+        .seed = 1,
+    };
+    uint32_t samples = 100, budget_us = 30000, period_ms = 0;
+    double start_mm, velocity = 0, seconds = 60;
+    unsigned window_low = 0, window_high = 0;
+    bool window = false;
+    VL53L0X_GpioFunctionality gpio = VL53L0X_GPIOFUNCTIONALITY_NEW_MEASURE_READY;
+    VL53L0X_Dev_t *dev;
+    VL53L0X_DeviceModes mode;
+    VL53L0X_RangingMeasurementData_t m;
+    uint32_t valid = 0, transactions, shadow_hits, register_reads;
+    uint64_t start_us, bus_us;
+    double sum = 0, sum_sq = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:r:a:s:n:b:p:v:w:t:h")) != -1) {
+        switch (opt) {
+        case 'd': target.distance_mm = atof(optarg); break;
+        case 'r': target.reflectance = atof(optarg); break;
+        case 'a': target.ambient_mcps = atof(optarg); break;
+        case 's': target.seed = strtoul(optarg, NULL, 0); break;
+        case 'n': samples = strtoul(optarg, NULL, 0); break;
+        case 'b': budget_us = strtoul(optarg, NULL, 0); break;
+        case 'p': period_ms = strtoul(optarg, NULL, 0); break;
+        case 'v': velocity = atof(optarg); break;
+        case 'w':
+            if (sscanf(optarg, "%u:%u", &window_low, &window_high) != 2 || window_low > window_high) {
+                usage(argv[0]);
+                return 2;
+            }
+            window = true;
+            gpio = VL53L0X_GPIOFUNCTIONALITY_THRESHOLD_CROSSED_OUT;
+            break;
+        case 't': seconds = atof(optarg); break;
+        default: usage(argv[0]); return 2;
+        }
+    }
+
+    start_mm = target.distance_mm;
+    vl53l0x_sim_reset(&target);
+    // calloc: the platform layer expects its batching state zeroed.
+    dev = calloc(1, sizeof(*dev));
+    if (sim_ranger_init(dev, budget_us)) {
+        return 1;
+    }
+    fprintf(stderr, "init: %llu us virtual, %u transactions, %u register reads, %u shadow hits\n",
+        (unsigned long long)vl53l0x_sim_now_us(), VL53L0X_get_transaction_count(),
+        VL53L0X_GetRegisterReadCount(), VL53L0X_GetShadowHitCount());
+
+    mode = period_ms ? VL53L0X_DEVICEMODE_CONTINUOUS_TIMED_RANGING : VL53L0X_DEVICEMODE_CONTINUOUS_RANGING;
+    if (sim_ranger_check("VL53L0X_SetDeviceMode", VL53L0X_SetDeviceMode(dev, mode)) ||
+            (period_ms && sim_ranger_check("VL53L0X_SetInterMeasurementPeriodMilliSeconds",
+                VL53L0X_SetInterMeasurementPeriodMilliSeconds(dev, period_ms))) ||
+            (window && sim_ranger_check("VL53L0X_SetInterruptThresholds", VL53L0X_SetInterruptThresholds(dev, mode,
+                (FixPoint1616_t)window_low << 16, (FixPoint1616_t)window_high << 16))) ||
+            sim_ranger_check("VL53L0X_SetGpioConfig", VL53L0X_SetGpioConfig(dev, 0, mode,
+                gpio, VL53L0X_INTERRUPTPOLARITY_LOW)) ||
+            sim_ranger_check("VL53L0X_StartMeasurement", VL53L0X_StartMeasurement(dev))) {
+        return 1;
+    }
+
+    start_us = vl53l0x_sim_now_us();
+    bus_us = vl53l0x_sim_bus_time_us();
+    transactions = VL53L0X_get_transaction_count();
+    shadow_hits = VL53L0X_GetShadowHitCount();
+    register_reads = VL53L0X_GetRegisterReadCount();
+    printf("time_us,range_mm,range_status,signal_mcps,ambient_mcps,sigma_mm,effective_spads\n");
+    for (uint32_t i = 0; i < samples; i++) {
+        // Sleep until GPIO1 fires, as the sensor task does on the device.
+        while (!vl53l0x_sim_gpio1_asserted() && (!window || vl53l0x_sim_now_us() - start_us < seconds * 1e6)) {
+            vl53l0x_sim_advance_us(100);
+            if (velocity != 0) {
+                target.distance_mm = start_mm + velocity * (vl53l0x_sim_now_us() - start_us) / 1e6;
+                vl53l0x_sim_set_target(&target);
+            }
+        }
+        if (!vl53l0x_sim_gpio1_asserted()) {
+            // Nothing left the window in time.
+            samples = i;
+            break;
+        }
+        if (sim_ranger_check("VL53L0X_GetRangingMeasurementData", VL53L0X_GetRangingMeasurementData(dev, &m)) ||
+                sim_ranger_check("VL53L0X_ClearInterruptMask", VL53L0X_ClearInterruptMask(dev, 0))) {
+            return 1;
+        }
+        printf("%llu,%u,%u,%.3f,%.3f,%.2f,%.1f\n",
+            (unsigned long long)vl53l0x_sim_now_us(), m.RangeMilliMeter, m.RangeStatus,
+            m.SignalRateRtnMegaCps / 65536.0, m.AmbientRateRtnMegaCps / 65536.0,
+            PALDevDataGet(dev, SigmaEstimate) / 65536.0, m.EffectiveSpadRtnCount / 256.0);
+        if (m.RangeStatus == 0) {
+            valid++;
+            sum += m.RangeMilliMeter;
+            sum_sq += (double)m.RangeMilliMeter * m.RangeMilliMeter;
+        }
+    }
+
+    if (sim_ranger_check("VL53L0X_StopMeasurement", VL53L0X_StopMeasurement(dev))) {
+        return 1;
+    }
+
+    fprintf(stderr, "%u/%u valid", valid, samples);
+    if (valid) {
+        double mean = sum / valid;
+        fprintf(stderr, ", mean %.1f mm, sd %.2f mm", mean, sqrt(sum_sq / valid - mean * mean));
+    }
+    if (samples) {
+        fprintf(stderr, "; %.0f us/sample, %.1f transactions/sample, %.1f register reads/sample, %.1f shadow hits/sample, %.0f us bus/sample\n",
+            (double)(vl53l0x_sim_now_us() - start_us) / samples,
+            (double)(VL53L0X_get_transaction_count() - transactions) / samples,
+            (double)(VL53L0X_GetRegisterReadCount() - register_reads) / samples,
+            (double)(VL53L0X_GetShadowHitCount() - shadow_hits) / samples,
+            (double)(vl53l0x_sim_bus_time_us() - bus_us) / samples);
+    } else {
+        fprintf(stderr, "\n");
+    }
+    free(dev);
+    return 0;
+}
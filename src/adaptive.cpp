@@ -0,0 +1,141 @@
+#include "adaptive.hpp"
+#include "metrics.hpp"
+
+#include <atomic>
+#include <esp_log.h>
+#include <esp_timer.h>
+
+static const char *TAG = "adaptive";
+
+// The long-range profile's periods.
+#define LONG_PRE_RANGE_VCSEL_PCLKS   18
+#define LONG_FINAL_RANGE_VCSEL_PCLKS 14
+
+// Sensor task only.
+static const char *profile_name; // the profile the state below is for
+static uint32_t budget_us;
+static bool long_vcsel;
+static uint64_t sigma_sum;
+static uint32_t sigma_count;
+static int64_t hold_until_us;
+
+static std::atomic<uint32_t> budget_gauge_us(0);
+static std::atomic<uint32_t> window_sigma(0);
+static std::atomic<uint32_t> changes(0);
+
+static void collect_adaptive(metrics_writer *w) {
+    metrics_write_family(w, "ranger_adaptive_timing_budget_seconds", "Timing budget the controller has chosen; 0 for fixed profiles.", "gauge");
+    metrics_write_sample(w, "ranger_adaptive_timing_budget_seconds", NULL, budget_gauge_us.load(std::memory_order_relaxed) / 1e6);
+    metrics_write_family(w, "ranger_adaptive_sigma_mm", "Mean sigma over the controller's last window.", "gauge");
+    metrics_write_sample(w, "ranger_adaptive_sigma_mm", NULL, window_sigma.load(std::memory_order_relaxed) / 65536.0);
+    metrics_write_family(w, "ranger_adaptive_target_sigma_mm", "Sigma the controller aims for.", "gauge");
+    metrics_write_sample(w, "ranger_adaptive_target_sigma_mm", NULL, ADAPTIVE_TARGET_SIGMA_MM / 65536.0);
+    metrics_write_family(w, "ranger_adaptive_changes", "Total number of times the controller reconfigured the sensor.", "counter");
+    metrics_write_sample(w, "ranger_adaptive_changes", NULL, changes.load(std::memory_order_relaxed));
+}
+
+void adaptive_init(void) {
+    metrics_add_collector(collect_adaptive);
+}
+
+static bool adaptive(const ranger_profile *profile) {
+    return profile->max_timing_budget_us > profile->timing_budget_us;
+}
+
+// Starts over at the profile's shortest budget.
+static void reset(const ranger_profile *profile) {
+    profile_name = profile->name;
+    budget_us = profile->timing_budget_us;
+    long_vcsel = false;
+    sigma_sum = 0;
+    sigma_count = 0;
+    hold_until_us = 0;
+    budget_gauge_us.store(adaptive(profile) ? budget_us : 0, std::memory_order_relaxed);
+}
+
+// Picks the next budget for a window's mean sigma, or returns the current
+// one if it's close enough to the target.
+static uint32_t next_budget(const ranger_profile *profile, FixPoint1616_t sigma) {
+    const uint64_t target = ADAPTIVE_TARGET_SIGMA_MM;
+    uint64_t band = target * ADAPTIVE_HYSTERESIS_PCT / 100;
+
+    if (sigma <= target + band && sigma + band >= target) {
+        return budget_us;
+    }
+    // budget * (sigma / target)^2, in 8.8 so the squares stay small.
+    uint64_t s = sigma >> 8, t = target >> 8;
+    uint64_t next = t ? (uint64_t)budget_us * s * s / (t * t) : budget_us;
+    if (next > (uint64_t)budget_us * 2) {
+        next = (uint64_t)budget_us * 2;
+    } else if (next < budget_us / 2) {
+        next = budget_us / 2;
+    }
+    if (next > profile->max_timing_budget_us) {
+        next = profile->max_timing_budget_us;
+    } else if (next < profile->timing_budget_us) {
+        next = profile->timing_budget_us;
+    }
+    return (uint32_t)next;
+}
+
+void adaptive_observe(const VL53L0X_RangingMeasurementData_t *measurement, FixPoint1616_t sigma_mm) {
+    const ranger_profile *profile = profiles_selected();
+
+    if (profile->name != profile_name) {
+        reset(profile);
+    }
+    // Sigma only says something about the budget when there's a target;
+    // signal and phase failures would just run it up to the maximum.
+    if (!adaptive(profile) || measurement->RangeStatus > 1) {
+        return;
+    }
+    sigma_sum += sigma_mm;
+    if (++sigma_count < ADAPTIVE_WINDOW_SAMPLES) {
+        return;
+    }
+    FixPoint1616_t sigma = (FixPoint1616_t)(sigma_sum / sigma_count);
+    sigma_sum = 0;
+    sigma_count = 0;
+    window_sigma.store(sigma, std::memory_order_relaxed);
+
+    int64_t now_us = esp_timer_get_time();
+    if (now_us < hold_until_us) {
+        return;
+    }
+    uint32_t next = next_budget(profile, sigma);
+    bool next_long_vcsel = long_vcsel;
+    if (ADAPTIVE_VCSEL && next == budget_us) {
+        // The budget has gone as far as it can; try the pulse length.
+        if (!long_vcsel && budget_us == profile->max_timing_budget_us && sigma > ADAPTIVE_TARGET_SIGMA_MM) {
+            next_long_vcsel = true;
+        } else if (long_vcsel && budget_us == profile->timing_budget_us && sigma < ADAPTIVE_TARGET_SIGMA_MM) {
+            next_long_vcsel = false;
+        }
+    }
+    if (next == budget_us && next_long_vcsel == long_vcsel) {
+        return;
+    }
+    ESP_LOGI(TAG, "sigma %.1f mm: budget %lu -> %lu us%s", sigma / 65536.0, (unsigned long)budget_us,
+        (unsigned long)next, next_long_vcsel ? ", long VCSEL periods" : "");
+    budget_us = next;
+    long_vcsel = next_long_vcsel;
+    hold_until_us = now_us + ADAPTIVE_HOLD_MS * 1000LL;
+    budget_gauge_us.store(budget_us, std::memory_order_relaxed);
+    changes.fetch_add(1, std::memory_order_relaxed);
+}
+
+const ranger_profile * adaptive_profile(const ranger_profile *selected, ranger_profile *scratch) {
+    if (!adaptive(selected)) {
+        return selected;
+    }
+    if (selected->name != profile_name) {
+        reset(selected);
+    }
+    *scratch = *selected;
+    scratch->timing_budget_us = budget_us;
+    if (long_vcsel) {
+        scratch->pre_range_vcsel_pclks = LONG_PRE_RANGE_VCSEL_PCLKS;
+        scratch->final_range_vcsel_pclks = LONG_FINAL_RANGE_VCSEL_PCLKS;
+    }
+    return scratch;
+}
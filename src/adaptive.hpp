@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+#include "vl53l0x_api.h"
+#include "profiles.hpp"
+
+// Closed-loop timing budget for profiles with a max_timing_budget_us. Sigma
+// falls roughly with the square root of the budget, so after each window of
+// measurements the budget is rescaled by (sigma / target)^2, at most
+// doubling or halving, within [timing_budget_us, max_timing_budget_us]. A
+// bright target ends up at the shortest budget and highest rate; a dark one
+// gets as long as it needs. Nothing changes while sigma is within the
+// hysteresis band of the target, or for a while after the last change, so
+// the sensor isn't stopped and reconfigured over noise. Override the
+// settings in const.hpp.
+
+// Sigma to aim for, 16.16 mm.
+#ifndef ADAPTIVE_TARGET_SIGMA_MM
+#define ADAPTIVE_TARGET_SIGMA_MM ((FixPoint1616_t)(6 * 65536))
+#endif
+
+// How far, in percent, sigma may stray from the target before the budget
+// is changed.
+#ifndef ADAPTIVE_HYSTERESIS_PCT
+#define ADAPTIVE_HYSTERESIS_PCT 25
+#endif
+
+// Measurements averaged for each decision.
+#ifndef ADAPTIVE_WINDOW_SAMPLES
+#define ADAPTIVE_WINDOW_SAMPLES 16
+#endif
+
+// Least time between changes.
+#ifndef ADAPTIVE_HOLD_MS
+#define ADAPTIVE_HOLD_MS 2000
+#endif
+
+// 1 also moves to the long-range VCSEL periods when even the longest budget
+// leaves sigma over target, and back once the shortest one is plenty.
+// Longer pulses get more signal back from dark or distant targets.
+#ifndef ADAPTIVE_VCSEL
+#define ADAPTIVE_VCSEL 0
+#endif
+
+// Registers the /metrics collector. Call after metrics_init.
+void adaptive_init(void);
+
+// Feeds one measurement's sigma to the controller. Measurements without a
+// target to speak of are ignored. Only the sensor task may call this.
+void adaptive_observe(const VL53L0X_RangingMeasurementData_t *measurement, FixPoint1616_t sigma_mm);
+
+// The settings the sensor should run for the selected profile: the profile
+// itself, or a copy in *scratch with the controller's budget and VCSEL
+// periods. Only the sensor task may call this.
+const ranger_profile * adaptive_profile(const ranger_profile *selected, ranger_profile *scratch);
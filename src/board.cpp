@@ -0,0 +1,60 @@
+#include "board.hpp"
+#include "wifi.hpp"
+
+#include <M5Unified.h>
+#include <atomic>
+#include <math.h>
+#include <esp_timer.h>
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static std::atomic<float> temperature_c(NAN);
+static std::atomic<uint8_t> wifi_connected(0);
+static std::atomic<int> wifi_rssi(-1);
+static std::atomic<uint32_t> wifi_disconnects(0);
+static std::atomic<uint32_t> heap_free_bytes(0);
+static std::atomic<uint32_t> heap_allocated_bytes(0);
+static std::atomic<int64_t> sampled_us(0);
+
+static void sample(void) {
+    float temp;
+    temperature_c.store(M5.Imu.getTemp(&temp) ? temp : NAN, std::memory_order_relaxed);
+
+    wifi_stats ws = wifi_get_stats();
+    wifi_connected.store(ws.connected, std::memory_order_relaxed);
+    wifi_rssi.store(ws.rssi, std::memory_order_relaxed);
+    wifi_disconnects.store(ws.disconnects, std::memory_order_relaxed);
+
+    multi_heap_info_t heap_info;
+    heap_caps_get_info(&heap_info, MALLOC_CAP_8BIT|MALLOC_CAP_32BIT);
+    heap_free_bytes.store(heap_info.total_free_bytes, std::memory_order_relaxed);
+    heap_allocated_bytes.store(heap_info.total_allocated_bytes, std::memory_order_relaxed);
+
+    sampled_us.store(esp_timer_get_time(), std::memory_order_relaxed);
+}
+
+static void board_task(void *arg) {
+    TickType_t last_wake = xTaskGetTickCount();
+    while (1) {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(BOARD_SAMPLE_INTERVAL_MS));
+        sample();
+    }
+}
+
+void board_start(void) {
+    sample();
+    xTaskCreate(board_task, "board", 4096, NULL, 1, NULL);
+}
+
+board_stats board_get_stats(void) {
+    board_stats s;
+    s.temperature_c = temperature_c.load(std::memory_order_relaxed);
+    s.wifi_connected = wifi_connected.load(std::memory_order_relaxed);
+    s.wifi_rssi = wifi_rssi.load(std::memory_order_relaxed);
+    s.wifi_disconnects = wifi_disconnects.load(std::memory_order_relaxed);
+    s.heap_free_bytes = heap_free_bytes.load(std::memory_order_relaxed);
+    s.heap_allocated_bytes = heap_allocated_bytes.load(std::memory_order_relaxed);
+    s.sampled_us = sampled_us.load(std::memory_order_relaxed);
+    return s;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+
+// How often board_start's task re-reads everything in board_stats.
+#ifndef BOARD_SAMPLE_INTERVAL_MS
+#define BOARD_SAMPLE_INTERVAL_MS 2000
+#endif
+
+// Slow-moving board readings. They all need the IMU bus, the wifi driver or
+// the heap lock, so one task reads them on a schedule and everyone else gets
+// the cached copy.
+typedef struct {
+    float temperature_c;           // IMU die temperature; NAN if it didn't answer
+    uint8_t wifi_connected;
+    int wifi_rssi;                 // -1 if not connected
+    uint32_t wifi_disconnects;
+    uint32_t heap_free_bytes;
+    uint32_t heap_allocated_bytes;
+    int64_t sampled_us;            // esp_timer_get_time() of the last reading
+} board_stats;
+
+// Takes the first reading before returning, then keeps them fresh from a
+// background task. Call after M5.begin() and wifi_init_sta().
+void board_start(void);
+
+// The latest readings. Never blocks or touches hardware. Fields are updated
+// one at a time, so a read can straddle two samples.
+board_stats board_get_stats(void);
@@ -0,0 +1,120 @@
+#include "burst.hpp"
+#include "histogram.hpp"
+#include "metrics.hpp"
+#include "vl53l0x_api_core.h"
+
+#include <atomic>
+
+// Sensor task only. The accepted measurements so far, with their weights.
+static uint8_t target;   // burst length being collected
+static uint8_t received;
+static uint8_t used;
+static uint16_t ranges[BURST_MAX_COUNT];
+static uint32_t weights[BURST_MAX_COUNT]; // signal rate in 8.8, at least 1
+static uint64_t signal_sum, ambient_sum, sigma_sum;
+static uint32_t spad_sum;
+
+static histogram spread_mm = { BURST_SPREAD_MM_BUCKETS, {}, {} };
+static std::atomic<uint32_t> reported(0);
+static std::atomic<uint32_t> burst_size(1);
+
+static void collect_burst(metrics_writer *w) {
+    metrics_write_family(w, "ranger_reported_samples", "Total number of samples reported, each combining a burst of measurements.", "counter");
+    metrics_write_sample(w, "ranger_reported_samples", NULL, reported.load(std::memory_order_relaxed));
+    metrics_write_family(w, "ranger_burst_size", "Measurements combined into each reported sample.", "gauge");
+    metrics_write_sample(w, "ranger_burst_size", NULL, burst_size.load(std::memory_order_relaxed));
+    histogram_write(w, "ranger_burst_spread_mm", "Signal-weighted standard deviation of the ranges within each burst.", &spread_mm, 1.0 / 65536);
+}
+
+void burst_init(void) {
+    metrics_add_collector(collect_burst);
+}
+
+void burst_reset(void) {
+    received = used = 0;
+    signal_sum = ambient_sum = sigma_sum = 0;
+    spad_sum = 0;
+}
+
+// Fills in the combined sample from the accepted measurements.
+static void combine(burst_result *out) {
+    uint64_t weight_sum = 0, weighted_sum = 0, variance_sum = 0;
+
+    for (uint8_t i = 0; i < used; i++) {
+        weight_sum += weights[i];
+        weighted_sum += (uint64_t)weights[i] * ranges[i];
+    }
+    // Everything in 16.16 mm. With 16-bit weights, at most BURST_MAX_COUNT of
+    // them and ranges quality_check let through, it all fits in 64 bits.
+    int64_t mean = (int64_t)((weighted_sum << 16) / weight_sum);
+    for (uint8_t i = 0; i < used; i++) {
+        int64_t deviation = ((int64_t)ranges[i] << 16) - mean;
+        variance_sum += weights[i] * (uint64_t)((deviation * deviation) >> 16);
+    }
+    uint64_t variance = variance_sum / weight_sum;
+
+    out->measurement.RangeMilliMeter = (uint16_t)((mean + 0x8000) >> 16);
+    out->measurement.SignalRateRtnMegaCps = (FixPoint1616_t)(signal_sum / used);
+    out->measurement.AmbientRateRtnMegaCps = (FixPoint1616_t)(ambient_sum / used);
+    out->measurement.EffectiveSpadRtnCount = (uint16_t)(spad_sum / used);
+    out->measurement.RangeStatus = 0;
+    // The square root of a 16.16 value is 8.8; saturates at a 255 mm spread.
+    out->spread_mm = VL53L0X_isqrt(variance > UINT32_MAX ? UINT32_MAX : (uint32_t)variance) << 8;
+    out->sigma_mm = (FixPoint1616_t)(((sigma_sum / used) << 8) / VL53L0X_isqrt((uint32_t)used << 16));
+    out->used = used;
+    out->quality = QUALITY_OK;
+}
+
+bool burst_add(const VL53L0X_RangingMeasurementData_t *measurement, FixPoint1616_t sigma_mm, quality_reason quality,
+        uint8_t count, burst_result *out) {
+    if (count < 1) {
+        count = 1;
+    } else if (count > BURST_MAX_COUNT) {
+        count = BURST_MAX_COUNT;
+    }
+    if (count != target) {
+        // New profile; what's been collected was measured differently.
+        target = count;
+        burst_size.store(count, std::memory_order_relaxed);
+        burst_reset();
+    }
+    if (count == 1) {
+        out->measurement = *measurement;
+        out->sigma_mm = sigma_mm;
+        out->spread_mm = 0;
+        out->used = quality == QUALITY_OK;
+        out->quality = quality;
+        reported.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    if (quality == QUALITY_OK) {
+        uint32_t weight = measurement->SignalRateRtnMegaCps >> 8;
+        ranges[used] = measurement->RangeMilliMeter;
+        weights[used] = weight < 1 ? 1 : weight > UINT16_MAX ? UINT16_MAX : weight;
+        signal_sum += measurement->SignalRateRtnMegaCps;
+        ambient_sum += measurement->AmbientRateRtnMegaCps;
+        sigma_sum += sigma_mm;
+        spad_sum += measurement->EffectiveSpadRtnCount;
+        used++;
+    }
+    if (++received < count) {
+        return false;
+    }
+
+    out->measurement = *measurement;
+    if (used) {
+        combine(out);
+        if (used > 1) {
+            histogram_observe(&spread_mm, out->spread_mm);
+        }
+    } else {
+        out->sigma_mm = sigma_mm;
+        out->spread_mm = 0;
+        out->used = 0;
+        out->quality = quality;
+    }
+    reported.fetch_add(1, std::memory_order_relaxed);
+    burst_reset();
+    return true;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include "vl53l0x_api.h"
+#include "quality.hpp"
+
+// Combines runs of fast measurements into one reported sample, for profiles
+// whose burst_count is above 1: several short timing budgets average out
+// about as well as one long one, but every measurement still goes through
+// quality_check on its own so an outlier costs one vote rather than the
+// whole sample.
+
+// Most measurements a burst can combine.
+#define BURST_MAX_COUNT 32
+
+// Bucket layout for ranger_burst_spread_mm, 16.16 mm. Override in const.hpp.
+#ifndef BURST_SPREAD_MM_BUCKETS
+#define BURST_SPREAD_MM_BUCKETS {65536 / 2, 65536 / 2, 20} // 0.5..10 mm
+#endif
+
+typedef struct {
+    // The accepted measurements combined: range weighted by signal rate,
+    // the rates and SPAD count averaged. Otherwise the last measurement.
+    VL53L0X_RangingMeasurementData_t measurement;
+    FixPoint1616_t sigma_mm;  // the measurements' mean sigma over sqrt(used)
+    FixPoint1616_t spread_mm; // signal-weighted standard deviation of their ranges
+    uint8_t used;             // accepted measurements that went in
+    quality_reason quality;   // QUALITY_OK if any were accepted, else why the last wasn't
+} burst_result;
+
+// Registers the /metrics collector. Call after metrics_init.
+void burst_init(void);
+
+// Adds one measurement, already through quality_check, to a burst of count.
+// Returns true with the combined sample in *out once the burst is complete;
+// a count of 1 passes every measurement straight through. Only the sensor
+// task may call this.
+bool burst_add(const VL53L0X_RangingMeasurementData_t *measurement, FixPoint1616_t sigma_mm, quality_reason quality,
+    uint8_t count, burst_result *out);
+
+// Abandons the burst in progress, e.g. after the sensor was restarted.
+void burst_reset(void);
@@ -0,0 +1,78 @@
+#include "calibration.hpp"
+#include "nvs_blob.hpp"
+
+#include <atomic>
+#include <esp_log.h>
+
+static const char *TAG = "calibration";
+
+#define CALIBRATION_NVS_KEY       "calibration"
+#define NVM_INFO_NVS_KEY          "nvm_info"
+// Bump when ranger_calibration or VL53L0X_DeviceNvmInfo_t change layout;
+// older blobs are then ignored.
+#define CALIBRATION_VERSION       1
+
+// A pending calibration_request: bit 31 set, then the offset distance in
+// bits 16-30 and the crosstalk distance in bits 0-15.
+#define CALIBRATION_REQUESTED 0x80000000u
+
+static std::atomic<uint32_t> pending(0);
+
+template <typename T>
+static void save(const char *key, const T *value) {
+    esp_err_t err = save_blob(key, CALIBRATION_VERSION, value);
+    if (err != ESP_OK) {
+        // What's on the device is still right; the next boot just redoes it.
+        ESP_LOGW(TAG, "couldn't save %s: %s", key, esp_err_to_name(err));
+    }
+}
+
+bool calibration_load(uint32_t part_uid_upper, uint32_t part_uid_lower, ranger_calibration *out) {
+    ranger_calibration calibration;
+
+    if (!load_blob(CALIBRATION_NVS_KEY, CALIBRATION_VERSION, &calibration)) {
+        return false;
+    }
+    if (calibration.part_uid_upper != part_uid_upper || calibration.part_uid_lower != part_uid_lower) {
+        ESP_LOGI(TAG, "saved calibration is for part %08lx%08lx, not this one",
+            (unsigned long)calibration.part_uid_upper, (unsigned long)calibration.part_uid_lower);
+        return false;
+    }
+    *out = calibration;
+    return true;
+}
+
+void calibration_save(const ranger_calibration *calibration) {
+    save(CALIBRATION_NVS_KEY, calibration);
+}
+
+bool calibration_load_nvm_info(uint32_t part_uid_upper, uint32_t part_uid_lower, VL53L0X_DeviceNvmInfo_t *out) {
+    VL53L0X_DeviceNvmInfo_t nvm_info;
+
+    if (!load_blob(NVM_INFO_NVS_KEY, CALIBRATION_VERSION, &nvm_info)) {
+        return false;
+    }
+    if (nvm_info.PartUIDUpper != part_uid_upper || nvm_info.PartUIDLower != part_uid_lower) {
+        return false;
+    }
+    *out = nvm_info;
+    return true;
+}
+
+void calibration_save_nvm_info(const VL53L0X_DeviceNvmInfo_t *nvm_info) {
+    save(NVM_INFO_NVS_KEY, nvm_info);
+}
+
+void calibration_request(uint16_t offset_target_mm, uint16_t xtalk_target_mm) {
+    pending.store(CALIBRATION_REQUESTED | (uint32_t)(offset_target_mm & 0x7FFF) << 16 | xtalk_target_mm);
+}
+
+bool calibration_take_request(uint16_t *offset_target_mm, uint16_t *xtalk_target_mm) {
+    uint32_t request = pending.exchange(0);
+    if (!(request & CALIBRATION_REQUESTED)) {
+        return false;
+    }
+    *offset_target_mm = (request >> 16) & 0x7FFF;
+    *xtalk_target_mm = request & 0xFFFF;
+    return true;
+}
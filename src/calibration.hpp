@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+#include "vl53l0x_api.h"
+#include "vl53l0x_api_core.h"
+
+// Per-part calibration results kept across boots. They're only valid for
+// the part they were measured on, hence the UID.
+typedef struct {
+    uint32_t part_uid_upper;
+    uint32_t part_uid_lower;
+    uint8_t vhv_settings;
+    uint8_t phase_cal;
+    uint8_t has_offset;
+    uint8_t has_xtalk;
+    float temperature_c;        // when the reference calibration ran; NAN if unknown
+    int32_t offset_um;          // VL53L0X_PerformOffsetCalibration
+    FixPoint1616_t xtalk_mcps;  // VL53L0X_PerformXTalkCalibration
+} ranger_calibration;
+
+// Loads the saved calibration if it belongs to the given part. NVS must be
+// initialized.
+bool calibration_load(uint32_t part_uid_upper, uint32_t part_uid_lower, ranger_calibration *out);
+
+void calibration_save(const ranger_calibration *calibration);
+
+// The factory data the API otherwise reads out of the sensor's NVM word by
+// word on every boot. Same rules as calibration_load.
+bool calibration_load_nvm_info(uint32_t part_uid_upper, uint32_t part_uid_lower, VL53L0X_DeviceNvmInfo_t *out);
+
+void calibration_save_nvm_info(const VL53L0X_DeviceNvmInfo_t *nvm_info);
+
+// Asks the sensor task to recalibrate. Non-zero distances also run offset
+// and crosstalk calibration against a target that far away. Safe from any
+// task.
+void calibration_request(uint16_t offset_target_mm, uint16_t xtalk_target_mm);
+
+// Takes a pending calibration_request, if there is one.
+bool calibration_take_request(uint16_t *offset_target_mm, uint16_t *xtalk_target_mm);
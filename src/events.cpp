@@ -0,0 +1,224 @@
+#include "events.hpp"
+#include "nvs_blob.hpp"
+
+#include <atomic>
+#include <string.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include "freertos/FreeRTOS.h"
+
+static const char *TAG = "events";
+
+#define EVENTS_NVS_KEY       "events"
+// Bump when saved_config changes layout; older blobs are then ignored.
+#define EVENTS_VERSION       1
+
+static const char *const kind_names[] = { "below", "above", "returned" };
+static_assert(sizeof(kind_names) / sizeof(kind_names[0]) == EVENT_KIND_COUNT, "kind_names out of step with event_kind");
+static_assert((EVENTS_RING_SIZE & (EVENTS_RING_SIZE - 1)) == 0, "EVENTS_RING_SIZE must be a power of two");
+
+typedef struct {
+    uint8_t enabled;
+    uint8_t reserved;
+    uint16_t low_mm;
+    uint16_t high_mm;
+    uint16_t reserved2;
+    uint32_t period_ms;
+} saved_config;
+
+// Where the target was last seen, relative to the window.
+typedef enum {
+    POSITION_UNKNOWN,
+    POSITION_INSIDE,
+    POSITION_BELOW,
+    POSITION_ABOVE,
+} position;
+
+// Written by events_configure from any task, read by the sensor task; the
+// flag tells it to restart ranging.
+static events_config config = { false, 100, 1000, 100 };
+static portMUX_TYPE config_lock = portMUX_INITIALIZER_UNLOCKED;
+static std::atomic<bool> config_changed(false);
+
+// Sensor task only.
+static events_config active;
+static position where;
+
+// Written by the sensor task, read by the HTTP handlers.
+static range_event ring[EVENTS_RING_SIZE];
+static uint32_t head; // seq of the newest event
+static portMUX_TYPE ring_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static std::atomic<bool> mode(false);
+static std::atomic<uint32_t> counts[EVENT_KIND_COUNT];
+static std::atomic<int64_t> last_event_us(0);
+
+const char * event_kind_name(event_kind kind) {
+    return kind < EVENT_KIND_COUNT ? kind_names[kind] : "unknown";
+}
+
+static bool config_valid(const events_config *c) {
+    return c->low_mm < c->high_mm && c->high_mm <= EVENTS_MAX_THRESHOLD_MM &&
+        c->period_ms >= 1 && c->period_ms <= EVENTS_MAX_PERIOD_MS;
+}
+
+static void collect_events(metrics_writer *w) {
+    char labels[32];
+
+    metrics_write_family(w, "ranger_event_mode", "1 while the sensor only interrupts outside the event window.", "gauge");
+    metrics_write_sample(w, "ranger_event_mode", NULL, mode.load(std::memory_order_relaxed));
+    metrics_write_family(w, "ranger_events", "Total number of times the range left or came back into the event window.", "counter");
+    for (int i = 0; i < EVENT_KIND_COUNT; i++) {
+        snprintf(labels, sizeof(labels), "kind=\"%s\"", kind_names[i]);
+        metrics_write_sample(w, "ranger_events", labels, counts[i].load(std::memory_order_relaxed));
+    }
+    metrics_write_family(w, "ranger_last_event_uptime_seconds", "Time since boot of the newest event; 0 if there's been none.", "gauge");
+    metrics_write_sample(w, "ranger_last_event_uptime_seconds", NULL, last_event_us.load(std::memory_order_relaxed) / 1e6);
+}
+
+void events_init(void) {
+    saved_config saved;
+
+    metrics_add_collector(collect_events);
+    if (!load_blob(EVENTS_NVS_KEY, EVENTS_VERSION, &saved)) {
+        return;
+    }
+    events_config c = { saved.enabled != 0, saved.low_mm, saved.high_mm, saved.period_ms };
+    if (!config_valid(&c)) {
+        ESP_LOGW(TAG, "ignoring invalid saved event window");
+        return;
+    }
+    config = c;
+}
+
+void events_get_config(events_config *out) {
+    taskENTER_CRITICAL(&config_lock);
+    *out = config;
+    taskEXIT_CRITICAL(&config_lock);
+}
+
+bool events_configure(const events_config *c) {
+    saved_config saved = { c->enabled, 0, c->low_mm, c->high_mm, 0, c->period_ms };
+    esp_err_t err;
+
+    if (!config_valid(c)) {
+        return false;
+    }
+    taskENTER_CRITICAL(&config_lock);
+    config = *c;
+    taskEXIT_CRITICAL(&config_lock);
+    config_changed.store(true, std::memory_order_release);
+
+    err = save_blob(EVENTS_NVS_KEY, EVENTS_VERSION, &saved);
+    if (err != ESP_OK) {
+        // Still switch; it just won't survive a reboot.
+        ESP_LOGW(TAG, "couldn't save event window: %s", esp_err_to_name(err));
+    }
+    return true;
+}
+
+bool events_changed(void) {
+    return config_changed.load(std::memory_order_acquire);
+}
+
+bool events_begin(events_config *out) {
+    config_changed.store(false, std::memory_order_relaxed);
+    events_get_config(out);
+    active = *out;
+    where = POSITION_UNKNOWN;
+    mode.store(active.enabled, std::memory_order_relaxed);
+    return active.enabled;
+}
+
+uint32_t events_wait_ms(uint32_t timing_budget_us) {
+    if (where == POSITION_INSIDE) {
+        return EVENTS_HEARTBEAT_MS;
+    }
+    // Outside, every sample interrupts; two periods without one means the
+    // target is back in the window. Until the first read, find out quickly.
+    return 2 * (timing_budget_us / 1000 + active.period_ms);
+}
+
+static void record(event_kind kind, const VL53L0X_RangingMeasurementData_t *measurement) {
+    int64_t now_us = esp_timer_get_time();
+
+    taskENTER_CRITICAL(&ring_lock);
+    range_event *event = &ring[++head & (EVENTS_RING_SIZE - 1)];
+    event->timestamp_us = now_us;
+    event->seq = head;
+    event->range_mm = measurement->RangeMilliMeter;
+    event->kind = kind;
+    event->range_status = measurement->RangeStatus;
+    taskEXIT_CRITICAL(&ring_lock);
+
+    counts[kind].fetch_add(1, std::memory_order_relaxed);
+    last_event_us.store(now_us, std::memory_order_relaxed);
+    ESP_LOGI(TAG, "%s at %u mm", kind_names[kind], measurement->RangeMilliMeter);
+}
+
+void events_observe(const VL53L0X_RangingMeasurementData_t *measurement, bool crossed) {
+    uint16_t range_mm = measurement->RangeMilliMeter;
+
+    if (crossed && range_mm < active.low_mm) {
+        if (where != POSITION_BELOW) {
+            record(EVENT_BELOW, measurement);
+            where = POSITION_BELOW;
+        }
+    } else if (crossed && range_mm > active.high_mm) {
+        // No target reads as a range past the end, so this covers it leaving.
+        if (where != POSITION_ABOVE) {
+            record(EVENT_ABOVE, measurement);
+            where = POSITION_ABOVE;
+        }
+    } else if (measurement->RangeStatus == 0 && range_mm >= active.low_mm && range_mm <= active.high_mm) {
+        if (where == POSITION_BELOW || where == POSITION_ABOVE) {
+            record(EVENT_RETURNED, measurement);
+        }
+        where = POSITION_INSIDE;
+    }
+}
+
+bool events_next(uint32_t *cursor, range_event *out) {
+    uint32_t seq = *cursor;
+    bool found = false;
+
+    taskENTER_CRITICAL(&ring_lock);
+    if (seq > head) {
+        // Cursor from some other boot; start over.
+        seq = 0;
+    }
+    if (head - seq > EVENTS_RING_SIZE) {
+        seq = head - EVENTS_RING_SIZE;
+    }
+    if (seq < head) {
+        *out = ring[(seq + 1) & (EVENTS_RING_SIZE - 1)];
+        found = true;
+    }
+    taskEXIT_CRITICAL(&ring_lock);
+    if (found) {
+        *cursor = out->seq;
+    }
+    return found;
+}
+
+static void write_json(metrics_writer *w, void *arg) {
+    uint32_t cursor = *(const uint32_t *)arg;
+    events_config c;
+    range_event event;
+    bool first = true;
+
+    events_get_config(&c);
+    metrics_printf(w, "{\"enabled\":%s,\"low_mm\":%u,\"high_mm\":%u,\"period_ms\":%lu,\"now_us\":%lld,\"events\":[",
+        c.enabled ? "true" : "false", c.low_mm, c.high_mm, (unsigned long)c.period_ms, (long long)esp_timer_get_time());
+    while (events_next(&cursor, &event)) {
+        metrics_printf(w, "%s{\"seq\":%lu,\"timestamp_us\":%lld,\"kind\":\"%s\",\"range_mm\":%u,\"range_status\":%u}",
+            first ? "" : ",", (unsigned long)event.seq, (long long)event.timestamp_us,
+            event_kind_name((event_kind)event.kind), event.range_mm, event.range_status);
+        first = false;
+    }
+    metrics_printf(w, "],\"next_since\":%lu}", (unsigned long)cursor);
+}
+
+bool events_write_json(uint32_t since, metrics_sink sink, void *ctx) {
+    return metrics_write_with(sink, ctx, write_json, &since);
+}
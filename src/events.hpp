@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdint.h>
+#include "vl53l0x_api.h"
+#include "metrics.hpp"
+
+// Threshold-window event mode. Instead of interrupting for every sample, the
+// sensor ranges on its own timer and only pulls GPIO1 when a range falls
+// outside [low_mm, high_mm], so the sensor task sleeps while the target stays
+// put. Leaving the window, by either edge, and coming back are recorded as
+// timestamped events for /events and /metrics.
+//
+// The device has no interrupt for coming back in, so that is inferred: while
+// outside, every sample interrupts, and once they stop for a couple of
+// periods the latest range is read to confirm it. While inside, the range is
+// read every EVENTS_HEARTBEAT_MS anyway so the display and history don't go
+// stale.
+
+// Number of events retained; must be a power of two.
+#define EVENTS_RING_SIZE 32
+
+// Longest the sensor task sleeps inside the window without reading a range.
+// Override in const.hpp.
+#ifndef EVENTS_HEARTBEAT_MS
+#define EVENTS_HEARTBEAT_MS 5000
+#endif
+
+// Longest period /events accepts.
+#define EVENTS_MAX_PERIOD_MS 10000
+
+// Farthest threshold the device can hold: 12 bits of 2 mm.
+#define EVENTS_MAX_THRESHOLD_MM 8190
+
+typedef enum {
+    EVENT_BELOW,    // the range dropped under low_mm
+    EVENT_ABOVE,    // the range rose over high_mm, or the target went away
+    EVENT_RETURNED, // the range is back within the window
+    EVENT_KIND_COUNT,
+} event_kind;
+
+typedef struct {
+    bool enabled;
+    uint16_t low_mm;
+    uint16_t high_mm;
+    uint32_t period_ms; // between the sensor's measurements; 1..EVENTS_MAX_PERIOD_MS
+} events_config;
+
+typedef struct {
+    int64_t timestamp_us; // esp_timer_get_time() when the range was read
+    uint32_t seq;         // starts at 1; 0 means "no event"
+    uint16_t range_mm;    // the range which caused it
+    uint8_t kind;         // event_kind
+    uint8_t range_status; // RangeStatus of that range
+} range_event;
+
+const char * event_kind_name(event_kind kind);
+
+// Restores the saved configuration and registers the /metrics collector.
+// NVS and metrics must be initialized.
+void events_init(void);
+
+void events_get_config(events_config *out);
+
+// Switches mode or window and persists the choice. Returns false, changing
+// nothing, if the settings are out of range. Safe from any task; the sensor
+// task restarts ranging after its next sample.
+bool events_configure(const events_config *config);
+
+// Whether the configuration has changed since the last events_begin. Only
+// the sensor task may call this.
+bool events_changed(void);
+
+// Takes the current configuration to start ranging with and forgets where
+// the target was. Returns out->enabled. Only the sensor task may call this.
+bool events_begin(events_config *out);
+
+// How long the sensor task should wait for the window to be crossed before
+// reading the range anyway. Only the sensor task may call this.
+uint32_t events_wait_ms(uint32_t timing_budget_us);
+
+// Tracks the target from one range read in event mode; crossed is whether it
+// interrupted. Only the sensor task may call this.
+void events_observe(const VL53L0X_RangingMeasurementData_t *measurement, bool crossed);
+
+// Copies the oldest retained event newer than *cursor and advances *cursor to
+// it. Start with *cursor = 0. Returns false when the reader is caught up;
+// events which were overwritten show up as a jump in seq.
+bool events_next(uint32_t *cursor, range_event *out);
+
+// Writes the configuration and the events after since as JSON, for /events.
+bool events_write_json(uint32_t since, metrics_sink sink, void *ctx);
@@ -0,0 +1,211 @@
+#include "filter.hpp"
+#include "histogram.hpp"
+#include "metrics.hpp"
+#include "range_metrics.hpp"
+#include "nvs_blob.hpp"
+
+#include <atomic>
+#include <string.h>
+#include <esp_log.h>
+#include "freertos/FreeRTOS.h"
+
+static const char *TAG = "filter";
+
+#define FILTER_NVS_KEY       "filter"
+// Bump when saved_config changes layout; older blobs are then ignored.
+#define FILTER_VERSION       1
+
+// Kalman process noise beyond this is no filtering at all, and keeping it
+// bounded keeps the variances well inside 64 bits.
+#define FILTER_MAX_PROCESS_NOISE_MM 1000
+// Sigma is capped well before this in the API (cSigmaEstMax), so it only
+// guards the arithmetic.
+#define FILTER_MAX_SIGMA (1023u << 16)
+
+static const char *const kind_names[] = { "none", "median", "ema", "kalman" };
+static_assert(sizeof(kind_names) / sizeof(kind_names[0]) == FILTER_KIND_COUNT, "kind_names out of step with filter_kind");
+
+typedef struct {
+    uint8_t kind;
+    uint8_t window;
+    uint16_t reserved;
+    FixPoint1616_t alpha;
+    FixPoint1616_t process_noise_mm;
+} saved_config;
+
+// Written by filter_configure from any task, read by the sensor task; the
+// flag tells it to start over.
+static filter_config config = {
+    FILTER_DEFAULT_KIND, 5, (FixPoint1616_t)(0.25 * 65536), (FixPoint1616_t)(2 * 65536),
+};
+static portMUX_TYPE config_lock = portMUX_INITIALIZER_UNLOCKED;
+static std::atomic<bool> config_changed(true);
+
+// Sensor task only.
+static filter_config active;
+static bool primed;
+static int64_t estimate;  // 16.16 mm
+static int64_t variance;  // Kalman only; 16.16 mm^2
+static uint16_t window[FILTER_MAX_WINDOW];
+static uint8_t window_count, window_next;
+
+static histogram filtered_range_mm = { RANGE_MM_BUCKETS, {}, {} };
+static std::atomic<uint32_t> latest_raw_mm(0);
+static std::atomic<uint32_t> latest_filtered_mm(0);
+
+const char * filter_kind_name(filter_kind kind) {
+    return kind < FILTER_KIND_COUNT ? kind_names[kind] : "unknown";
+}
+
+bool filter_find_kind(const char *name, filter_kind *out) {
+    for (int i = 0; i < FILTER_KIND_COUNT; i++) {
+        if (strcmp(kind_names[i], name) == 0) {
+            *out = (filter_kind)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool config_valid(const filter_config *c) {
+    return c->kind < FILTER_KIND_COUNT &&
+        c->window >= 1 && c->window <= FILTER_MAX_WINDOW && (c->window & 1) &&
+        c->alpha > 0 && c->alpha <= 65536 &&
+        c->process_noise_mm > 0 && c->process_noise_mm <= ((FixPoint1616_t)FILTER_MAX_PROCESS_NOISE_MM << 16);
+}
+
+static void collect_filter(metrics_writer *w) {
+    histogram_write(w, "ranger_filtered_range_mm", "Filtered distance of every accepted sample.", &filtered_range_mm, 1.0);
+    metrics_write_family(w, "ranger_latest_range_mm", "Distance of the newest sample, before and after filtering.", "gauge");
+    metrics_write_sample(w, "ranger_latest_range_mm", "stage=\"raw\"", latest_raw_mm.load(std::memory_order_relaxed));
+    metrics_write_sample(w, "ranger_latest_range_mm", "stage=\"filtered\"", latest_filtered_mm.load(std::memory_order_relaxed));
+}
+
+void filter_init(void) {
+    saved_config saved;
+
+    metrics_add_collector(collect_filter);
+    if (!load_blob(FILTER_NVS_KEY, FILTER_VERSION, &saved)) {
+        return;
+    }
+    filter_config c = { (filter_kind)saved.kind, saved.window, saved.alpha, saved.process_noise_mm };
+    if (!config_valid(&c)) {
+        ESP_LOGW(TAG, "ignoring invalid saved filter");
+        return;
+    }
+    config = c;
+}
+
+void filter_get_config(filter_config *out) {
+    taskENTER_CRITICAL(&config_lock);
+    *out = config;
+    taskEXIT_CRITICAL(&config_lock);
+}
+
+bool filter_configure(const filter_config *c) {
+    saved_config saved = { (uint8_t)c->kind, c->window, 0, c->alpha, c->process_noise_mm };
+    esp_err_t err;
+
+    if (!config_valid(c)) {
+        return false;
+    }
+    taskENTER_CRITICAL(&config_lock);
+    config = *c;
+    taskEXIT_CRITICAL(&config_lock);
+    config_changed.store(true, std::memory_order_release);
+
+    err = save_blob(FILTER_NVS_KEY, FILTER_VERSION, &saved);
+    if (err != ESP_OK) {
+        // Still switch; it just won't survive a reboot.
+        ESP_LOGW(TAG, "couldn't save filter: %s", esp_err_to_name(err));
+    }
+    return true;
+}
+
+static int64_t median(void) {
+    uint16_t sorted[FILTER_MAX_WINDOW];
+
+    // Insertion sort; the window is tiny.
+    for (uint8_t i = 0; i < window_count; i++) {
+        uint16_t v = window[i];
+        uint8_t j = i;
+        while (j > 0 && sorted[j - 1] > v) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = v;
+    }
+    return (int64_t)sorted[window_count / 2] << 16;
+}
+
+static void kalman(int64_t z, FixPoint1616_t sigma_mm) {
+    int64_t sigma = sigma_mm < FILTER_MAX_SIGMA ? sigma_mm : FILTER_MAX_SIGMA;
+    int64_t q = active.process_noise_mm;
+    // The sample's own sigma is its measurement noise; never let it reach
+    // zero or a single sample would pin the estimate.
+    int64_t r = (sigma * sigma) >> 16;
+    if (r < 1) {
+        r = 1;
+    }
+
+    if (!primed) {
+        estimate = z;
+        variance = r;
+        return;
+    }
+    variance += (q * q) >> 16;
+    int64_t gain = (variance << 16) / (variance + r); // 0..1 in 16.16
+    estimate += ((z - estimate) * gain) >> 16;
+    variance = (variance * (65536 - gain)) >> 16;
+}
+
+uint16_t filter_update(const VL53L0X_RangingMeasurementData_t *measurement, FixPoint1616_t sigma_mm, bool accepted) {
+    uint16_t raw = measurement->RangeMilliMeter;
+
+    if (config_changed.exchange(false, std::memory_order_acquire)) {
+        filter_get_config(&active);
+        primed = false;
+        window_count = window_next = 0;
+    }
+    latest_raw_mm.store(raw, std::memory_order_relaxed);
+    if (!accepted || active.kind == FILTER_NONE) {
+        // Rejected samples may carry a placeholder distance, so they don't
+        // touch the state and are reported as is.
+        if (accepted) {
+            histogram_observe(&filtered_range_mm, raw);
+        }
+        latest_filtered_mm.store(raw, std::memory_order_relaxed);
+        return raw;
+    }
+
+    int64_t z = (int64_t)raw << 16;
+    switch (active.kind) {
+    case FILTER_MEDIAN:
+        window[window_next] = raw;
+        window_next = (window_next + 1) % active.window;
+        if (window_count < active.window) {
+            window_count++;
+        }
+        estimate = median();
+        break;
+    case FILTER_EMA:
+        if (primed) {
+            estimate += ((z - estimate) * active.alpha) >> 16;
+        } else {
+            estimate = z;
+        }
+        break;
+    case FILTER_KALMAN:
+        kalman(z, sigma_mm);
+        break;
+    default:
+        break;
+    }
+    primed = true;
+
+    int64_t rounded = (estimate + 0x8000) >> 16;
+    uint16_t filtered = rounded < 0 ? 0 : rounded > UINT16_MAX ? UINT16_MAX : (uint16_t)rounded;
+    histogram_observe(&filtered_range_mm, filtered);
+    latest_filtered_mm.store(filtered, std::memory_order_relaxed);
+    return filtered;
+}
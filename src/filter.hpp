@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include "vl53l0x_api.h"
+
+// Smooths the range of consecutive samples so the display and /metrics can
+// use fast, noisy timing budgets. Everything on the sample path is integer
+// math in the API's 16.16 fixed point. Only samples quality_check accepted
+// feed a filter; the rest pass through with their raw range and leave the
+// filter's state alone.
+
+// Most samples the median can span.
+#define FILTER_MAX_WINDOW 15
+
+// Filter used until one is chosen at /filter. Override in const.hpp.
+#ifndef FILTER_DEFAULT_KIND
+#define FILTER_DEFAULT_KIND FILTER_NONE
+#endif
+
+typedef enum {
+    FILTER_NONE,
+    FILTER_MEDIAN, // median of the last window valid samples
+    FILTER_EMA,    // exponential moving average
+    FILTER_KALMAN, // 1-D Kalman filter with each sample's sigma as its noise
+    FILTER_KIND_COUNT,
+} filter_kind;
+
+typedef struct {
+    filter_kind kind;
+    uint8_t window;                       // median only; odd, 1..FILTER_MAX_WINDOW
+    FixPoint1616_t alpha;                 // EMA only; weight of the newest sample, (0, 1]
+    FixPoint1616_t process_noise_mm;      // Kalman only; how far the target may move between samples
+} filter_config;
+
+const char * filter_kind_name(filter_kind kind);
+
+// False if there's no filter by that name.
+bool filter_find_kind(const char *name, filter_kind *out);
+
+// Restores the saved configuration and registers the /metrics collector.
+// NVS and metrics must be initialized.
+void filter_init(void);
+
+void filter_get_config(filter_config *out);
+
+// Switches filter and persists the choice. Returns false, changing nothing,
+// if the settings are out of range. Safe from any task; the sensor task
+// starts the new filter afresh with its next sample.
+bool filter_configure(const filter_config *config);
+
+// Runs one measurement through the filter and returns the filtered range in
+// mm. Only the sensor task may call this.
+uint16_t filter_update(const VL53L0X_RangingMeasurementData_t *measurement, FixPoint1616_t sigma_mm, bool accepted);
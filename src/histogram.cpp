@@ -0,0 +1,68 @@
+#include "histogram.hpp"
+
+#include <stdio.h>
+
+static uint8_t bucket_count(const histogram_layout *layout) {
+    return layout->count > HISTOGRAM_MAX_BUCKETS ? HISTOGRAM_MAX_BUCKETS : layout->count;
+}
+
+static uint32_t bucket_index(const histogram_layout *layout, uint32_t value) {
+    uint32_t index;
+
+    if (value <= layout->first) {
+        return 0;
+    }
+    if (layout->width) {
+        index = (value - layout->first - 1) / layout->width + 1;
+    } else {
+        // Bucket i holds (first << (i - 1), first << i], which is the bit
+        // length of (value - 1) / first.
+        index = 32 - __builtin_clz((value - 1) / layout->first);
+    }
+    return index < bucket_count(layout) ? index : bucket_count(layout);
+}
+
+uint8_t histogram_bucket_count(const histogram *h) {
+    return bucket_count(&h->layout);
+}
+
+double histogram_bound(const histogram *h, uint32_t index) {
+    if (h->layout.width) {
+        return (double)h->layout.first + (double)h->layout.width * index;
+    }
+    return (double)h->layout.first * (double)(1ULL << index);
+}
+
+void histogram_observe(histogram *h, uint32_t value) {
+    h->buckets[bucket_index(&h->layout, value)].fetch_add(1, std::memory_order_relaxed);
+    h->sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+void histogram_write(metrics_writer *w, const char *name, const char *help, const histogram *h, double scale) {
+    metrics_write_family(w, name, help, "histogram");
+    histogram_write_series(w, name, NULL, h, scale);
+}
+
+void histogram_write_series(metrics_writer *w, const char *name, const char *labels, const histogram *h, double scale) {
+    char series[64];
+    char bucket_labels[96];
+    uint32_t cumulative = 0;
+    uint8_t count = bucket_count(&h->layout);
+
+    snprintf(series, sizeof(series), "%s_bucket", name);
+    for (uint32_t i = 0; i <= count; i++) {
+        cumulative += h->buckets[i].load(std::memory_order_relaxed);
+        if (i < count) {
+            snprintf(bucket_labels, sizeof(bucket_labels), "%s%sle=\"%.6g\"",
+                labels ? labels : "", labels ? "," : "", histogram_bound(h, i) * scale);
+        } else {
+            snprintf(bucket_labels, sizeof(bucket_labels), "%s%sle=\"+Inf\"",
+                labels ? labels : "", labels ? "," : "");
+        }
+        metrics_write_sample(w, series, bucket_labels, cumulative);
+    }
+    snprintf(series, sizeof(series), "%s_sum", name);
+    metrics_write_sample(w, series, labels, h->sum.load(std::memory_order_relaxed) * scale);
+    snprintf(series, sizeof(series), "%s_count", name);
+    metrics_write_sample(w, series, labels, cumulative);
+}
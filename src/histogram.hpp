@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include "metrics.hpp"
+
+// Most bounded buckets any histogram can have; +Inf comes on top.
+#ifndef HISTOGRAM_MAX_BUCKETS
+#define HISTOGRAM_MAX_BUCKETS 48
+#endif
+
+// Bucket upper bounds, in the raw units passed to histogram_observe. Bounds
+// are either evenly spaced or doubling so that finding the bucket is
+// arithmetic rather than a search.
+typedef struct {
+    uint32_t first; // upper bound of the first bucket; must be > 0
+    uint32_t width; // step between bounds, or 0 to double each time
+    uint8_t count;  // bounded buckets, at most HISTOGRAM_MAX_BUCKETS
+} histogram_layout;
+
+// Prometheus histogram that can be observed from one task and rendered from
+// another without locking. Zero-initialize everything but the layout, e.g.
+// `static histogram h = { {50, 50, 40}, {}, {} };`.
+typedef struct {
+    histogram_layout layout;
+    std::atomic<uint32_t> buckets[HISTOGRAM_MAX_BUCKETS + 1]; // not cumulative; the last is +Inf
+    std::atomic<uint64_t> sum;
+} histogram;
+
+void histogram_observe(histogram *h, uint32_t value);
+
+// Bounded buckets in use; buckets[histogram_bucket_count(h)] is +Inf.
+uint8_t histogram_bucket_count(const histogram *h);
+
+// Upper bound of bounded bucket index, in raw units.
+double histogram_bound(const histogram *h, uint32_t index);
+
+// Writes the whole family. scale converts raw units to the exported ones.
+void histogram_write(metrics_writer *w, const char *name, const char *help, const histogram *h, double scale);
+
+// Writes one labelled histogram of a family already started with
+// metrics_write_family(..., "histogram"). labels as for metrics_write_sample.
+void histogram_write_series(metrics_writer *w, const char *name, const char *labels, const histogram *h, double scale);
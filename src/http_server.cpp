@@ -21,10 +21,19 @@
 #include <M5Unified.h>
 
 #include <esp_wifi.h>
+#include <esp_timer.h>
 #include <esp_system.h>
 
 #include "http_server.hpp"
 #include "metrics.hpp"
+#include "i2c_trace.hpp"
+#include "profiles.hpp"
+#include "calibration.hpp"
+#include "filter.hpp"
+#include "events.hpp"
+#include "pipeline.hpp"
+#include "stream.hpp"
+#include "series.hpp"
 
 
 static esp_err_t hello_get_handler(httpd_req_t *req)
@@ -42,12 +51,36 @@ static const httpd_uri_t hello = {
 };
 
 
+// metrics_sink that sends each piece as a chunk of the response.
+static bool chunk_sink(void *ctx, const char *data, size_t len) {
+    return httpd_resp_send_chunk((httpd_req_t *)ctx, data, len) == ESP_OK;
+}
+
+#ifdef METRICS_STREAMING
 static esp_err_t metrics_handler(httpd_req_t *req) {
-    const char* resp_body = metrics_response();
-    httpd_resp_send(req, resp_body, HTTPD_RESP_USE_STRLEN);
-    free((void*)resp_body);
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    if (!metrics_stream(chunk_sink, req)) {
+        return ESP_FAIL;
+    }
+    httpd_resp_send_chunk(req, NULL, 0);
     return ESP_OK;
 }
+#else
+static esp_err_t metrics_handler(httpd_req_t *req) {
+    size_t len;
+    const char *body = metrics_acquire(&len);
+    if (!body) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", "1");
+        httpd_resp_sendstr(req, "metrics not rendered yet\n");
+        return ESP_OK;
+    }
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    esp_err_t err = httpd_resp_send(req, body, len);
+    metrics_release(body);
+    return err;
+}
+#endif
 
 static const httpd_uri_t metrics_uri = {
     .uri       = "/metrics",
@@ -56,11 +89,469 @@ static const httpd_uri_t metrics_uri = {
     .user_ctx  = NULL,
 };
 
+// GET /debug/i2c dumps the bus trace ring as an i2c_trace_header followed by
+// i2c_trace_records, or as CSV with ?format=csv. ?enable=1|0 switches tracing
+// and ?clear=1 drops what's been recorded, both before the dump.
+static esp_err_t debug_i2c_handler(httpd_req_t *req) {
+    char query[64];
+    char value[8];
+    bool csv = false;
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        if (httpd_query_key_value(query, "enable", value, sizeof(value)) == ESP_OK) {
+            i2c_trace_enable(atoi(value) != 0);
+        }
+        if (httpd_query_key_value(query, "clear", value, sizeof(value)) == ESP_OK && atoi(value)) {
+            i2c_trace_clear();
+        }
+        if (httpd_query_key_value(query, "format", value, sizeof(value)) == ESP_OK) {
+            csv = strcmp(value, "csv") == 0;
+        }
+    }
+
+    // Stream in small batches rather than copying the whole ring to the heap.
+    i2c_trace_record records[32];
+    char line[96];
+    uint32_t cursor = 0;
+    size_t n = 0, total = 0;
+
+    if (csv) {
+        httpd_resp_set_type(req, "text/csv");
+        httpd_resp_sendstr_chunk(req, "seq,timestamp_us,duration_us,dir,page,reg,len,batched,ok\n");
+    } else {
+        i2c_trace_header header = {
+            .magic = {'I', '2', 'C', 'T'},
+            .version = 1,
+            .record_size = sizeof(i2c_trace_record),
+            .enabled = i2c_trace_enabled(),
+            .reserved = 0,
+            .now_us = (uint32_t)esp_timer_get_time(),
+        };
+        httpd_resp_set_type(req, "application/octet-stream");
+        httpd_resp_send_chunk(req, (const char *)&header, sizeof(header));
+    }
+    do {
+        n = 0;
+        // Stop after one ring's worth so a busy bus can't keep us here forever.
+        while (n < sizeof(records) / sizeof(records[0]) && total < I2C_TRACE_RING_SIZE &&
+                i2c_trace_next(&cursor, &records[n])) {
+            n++;
+            total++;
+        }
+        if (!csv) {
+            if (n && httpd_resp_send_chunk(req, (const char *)records, n * sizeof(records[0])) != ESP_OK) {
+                return ESP_FAIL;
+            }
+            continue;
+        }
+        for (size_t i = 0; i < n; i++) {
+            const i2c_trace_record *r = &records[i];
+            snprintf(line, sizeof(line), "%lu,%lu,%u,%s,%u,0x%02X,%u,%d,%d\n",
+                (unsigned long)r->seq, (unsigned long)r->timestamp_us, r->duration_us,
+                (r->flags & I2C_TRACE_READ) ? "r" : "w", r->page, r->reg, r->len,
+                (r->flags & I2C_TRACE_BATCHED) != 0, (r->flags & I2C_TRACE_FAILED) == 0);
+            if (httpd_resp_sendstr_chunk(req, line) != ESP_OK) {
+                return ESP_FAIL;
+            }
+        }
+    } while (n);
+    httpd_resp_send_chunk(req, NULL, 0);
+    return ESP_OK;
+}
+
+static const httpd_uri_t debug_i2c_uri = {
+    .uri       = "/debug/i2c",
+    .method    = HTTP_GET,
+    .handler   = debug_i2c_handler,
+    .user_ctx  = NULL,
+};
+
+// GET /profile reports the selected ranging profile and the ones available.
+static esp_err_t profile_get_handler(httpd_req_t *req) {
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr_chunk(req, "{\"profile\":\"");
+    httpd_resp_sendstr_chunk(req, profiles_selected()->name);
+    httpd_resp_sendstr_chunk(req, "\",\"available\":[");
+    for (size_t i = 0; i < ranger_profile_count; i++) {
+        httpd_resp_sendstr_chunk(req, i ? ",\"" : "\"");
+        httpd_resp_sendstr_chunk(req, ranger_profiles[i].name);
+        httpd_resp_sendstr_chunk(req, "\"");
+    }
+    httpd_resp_sendstr_chunk(req, "]}");
+    httpd_resp_send_chunk(req, NULL, 0);
+    return ESP_OK;
+}
+
+static const httpd_uri_t profile_get_uri = {
+    .uri       = "/profile",
+    .method    = HTTP_GET,
+    .handler   = profile_get_handler,
+    .user_ctx  = NULL,
+};
+
+// POST /profile?name=<profile> switches profile. The sensor task applies it
+// after its next sample and the choice survives reboots.
+static esp_err_t profile_post_handler(httpd_req_t *req) {
+    char query[64];
+    char name[32];
+    const ranger_profile *profile = NULL;
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+            httpd_query_key_value(query, "name", name, sizeof(name)) == ESP_OK) {
+        profile = profiles_find(name);
+    }
+    if (!profile) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "unknown profile");
+        return ESP_OK;
+    }
+    profiles_select(profile);
+    return profile_get_handler(req);
+}
+
+static const httpd_uri_t profile_post_uri = {
+    .uri       = "/profile",
+    .method    = HTTP_POST,
+    .handler   = profile_post_handler,
+    .user_ctx  = NULL,
+};
+
+// POST /calibrate redoes the reference calibration. ?offset_mm=N and
+// ?xtalk_mm=N also calibrate offset and crosstalk against a target N mm away
+// (ST suggests a white target at 100 mm for offset and a grey one at 400-600
+// mm behind the cover glass for crosstalk). The sensor task runs it after its
+// next sample and saves the results.
+static esp_err_t calibrate_post_handler(httpd_req_t *req) {
+    char query[64];
+    char value[8];
+    int offset_mm = 0, xtalk_mm = 0;
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        if (httpd_query_key_value(query, "offset_mm", value, sizeof(value)) == ESP_OK) {
+            offset_mm = atoi(value);
+        }
+        if (httpd_query_key_value(query, "xtalk_mm", value, sizeof(value)) == ESP_OK) {
+            xtalk_mm = atoi(value);
+        }
+    }
+    if (offset_mm < 0 || offset_mm > 2000 || xtalk_mm < 0 || xtalk_mm > 2000) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "distance out of range");
+        return ESP_OK;
+    }
+    calibration_request(offset_mm, xtalk_mm);
+    httpd_resp_set_status(req, "202 Accepted");
+    httpd_resp_send(req, NULL, 0);
+    return ESP_OK;
+}
+
+static const httpd_uri_t calibrate_post_uri = {
+    .uri       = "/calibrate",
+    .method    = HTTP_POST,
+    .handler   = calibrate_post_handler,
+    .user_ctx  = NULL,
+};
+
+// GET /filter reports the filter applied to the range and its settings.
+static esp_err_t filter_get_handler(httpd_req_t *req) {
+    filter_config config;
+    char buf[160];
+
+    filter_get_config(&config);
+    snprintf(buf, sizeof(buf), "{\"kind\":\"%s\",\"window\":%u,\"alpha\":%.4f,\"process_noise_mm\":%.3f,\"available\":[",
+        filter_kind_name(config.kind), config.window, config.alpha / 65536.0, config.process_noise_mm / 65536.0);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr_chunk(req, buf);
+    for (int i = 0; i < FILTER_KIND_COUNT; i++) {
+        httpd_resp_sendstr_chunk(req, i ? ",\"" : "\"");
+        httpd_resp_sendstr_chunk(req, filter_kind_name((filter_kind)i));
+        httpd_resp_sendstr_chunk(req, "\"");
+    }
+    httpd_resp_sendstr_chunk(req, "]}");
+    httpd_resp_send_chunk(req, NULL, 0);
+    return ESP_OK;
+}
+
+static const httpd_uri_t filter_get_uri = {
+    .uri       = "/filter",
+    .method    = HTTP_GET,
+    .handler   = filter_get_handler,
+    .user_ctx  = NULL,
+};
+
+// POST /filter?kind=none|median|ema|kalman switches the range filter.
+// ?window=N (odd, median), ?alpha=0..1 (EMA) and ?process_noise_mm=X
+// (Kalman) tune it; anything left out keeps its current value. The sensor
+// task restarts the filter with its next sample and the choice survives
+// reboots.
+static esp_err_t filter_post_handler(httpd_req_t *req) {
+    char query[128];
+    char value[16];
+    filter_config config;
+
+    filter_get_config(&config);
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        if (httpd_query_key_value(query, "kind", value, sizeof(value)) == ESP_OK &&
+                !filter_find_kind(value, &config.kind)) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "kind must be none, median, ema or kalman");
+            return ESP_OK;
+        }
+        if (httpd_query_key_value(query, "window", value, sizeof(value)) == ESP_OK) {
+            int window = atoi(value);
+            config.window = window > 0 && window <= FILTER_MAX_WINDOW ? window : 0;
+        }
+        if (httpd_query_key_value(query, "alpha", value, sizeof(value)) == ESP_OK) {
+            double alpha = strtod(value, NULL);
+            config.alpha = alpha > 0 && alpha <= 1 ? (FixPoint1616_t)(alpha * 65536 + 0.5) : 0;
+        }
+        if (httpd_query_key_value(query, "process_noise_mm", value, sizeof(value)) == ESP_OK) {
+            double noise = strtod(value, NULL);
+            config.process_noise_mm = noise > 0 && noise < 65536 ? (FixPoint1616_t)(noise * 65536 + 0.5) : 0;
+        }
+    }
+    if (!filter_configure(&config)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "window must be odd and at most 15, alpha in (0, 1], process_noise_mm in (0, 1000]");
+        return ESP_OK;
+    }
+    return filter_get_handler(req);
+}
+
+static const httpd_uri_t filter_post_uri = {
+    .uri       = "/filter",
+    .method    = HTTP_POST,
+    .handler   = filter_post_handler,
+    .user_ctx  = NULL,
+};
+
+// GET /events?since=<seq> reports the event window and the times the range
+// left or came back into it after since; next_since is the since for the
+// next call. Timestamps are microseconds since boot, as now_us is.
+static esp_err_t events_get_handler(httpd_req_t *req) {
+    char query[64];
+    char value[16];
+    uint32_t since = 0;
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+            httpd_query_key_value(query, "since", value, sizeof(value)) == ESP_OK) {
+        since = strtoul(value, NULL, 10);
+    }
+    httpd_resp_set_type(req, "application/json");
+    if (!events_write_json(since, chunk_sink, req)) {
+        return ESP_FAIL;
+    }
+    httpd_resp_send_chunk(req, NULL, 0);
+    return ESP_OK;
+}
+
+static const httpd_uri_t events_get_uri = {
+    .uri       = "/events",
+    .method    = HTTP_GET,
+    .handler   = events_get_handler,
+    .user_ctx  = NULL,
+};
+
+// POST /events?enabled=1&low_mm=N&high_mm=N&period_ms=N switches to ranging
+// every period_ms with the sensor only interrupting outside [low_mm,
+// high_mm]; enabled=0 goes back to reporting every sample. Anything left out
+// keeps its current value. The sensor task restarts ranging after its next
+// sample and the choice survives reboots.
+static esp_err_t events_post_handler(httpd_req_t *req) {
+    char query[128];
+    char value[16];
+    events_config config;
+
+    events_get_config(&config);
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        if (httpd_query_key_value(query, "enabled", value, sizeof(value)) == ESP_OK) {
+            config.enabled = strcmp(value, "1") == 0 || strcmp(value, "true") == 0;
+        }
+        if (httpd_query_key_value(query, "low_mm", value, sizeof(value)) == ESP_OK) {
+            long low = strtol(value, NULL, 10);
+            config.low_mm = low >= 0 && low <= EVENTS_MAX_THRESHOLD_MM ? low : UINT16_MAX;
+        }
+        if (httpd_query_key_value(query, "high_mm", value, sizeof(value)) == ESP_OK) {
+            long high = strtol(value, NULL, 10);
+            config.high_mm = high > 0 && high <= EVENTS_MAX_THRESHOLD_MM ? high : 0;
+        }
+        if (httpd_query_key_value(query, "period_ms", value, sizeof(value)) == ESP_OK) {
+            long period = strtol(value, NULL, 10);
+            config.period_ms = period > 0 && period <= EVENTS_MAX_PERIOD_MS ? period : 0;
+        }
+    }
+    if (!events_configure(&config)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "need low_mm < high_mm <= 8190 and period_ms in [1, 10000]");
+        return ESP_OK;
+    }
+    return events_get_handler(req);
+}
+
+static const httpd_uri_t events_post_uri = {
+    .uri       = "/events",
+    .method    = HTTP_POST,
+    .handler   = events_post_handler,
+    .user_ctx  = NULL,
+};
+
+// GET /debug/pipeline reports where each sample's time goes, as the
+// ranger_pipeline_seconds histograms do but in microseconds and with the
+// latest and worst value of each stage.
+static esp_err_t debug_pipeline_handler(httpd_req_t *req) {
+    httpd_resp_set_type(req, "application/json");
+    if (!pipeline_write_json(chunk_sink, req)) {
+        return ESP_FAIL;
+    }
+    httpd_resp_send_chunk(req, NULL, 0);
+    return ESP_OK;
+}
+
+static const httpd_uri_t debug_pipeline_uri = {
+    .uri       = "/debug/pipeline",
+    .method    = HTTP_GET,
+    .handler   = debug_pipeline_handler,
+    .user_ctx  = NULL,
+};
+
+// GET /stream pushes every sample as it's taken. WebSocket clients get binary
+// messages holding arrays of stream_record; anyone else gets server-sent
+// events, one JSON object per sample.
+static esp_err_t stream_handler(httpd_req_t *req) {
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    if (httpd_ws_get_fd_info(req->handle, httpd_req_to_sockfd(req)) == HTTPD_WS_CLIENT_WEBSOCKET) {
+        if (req->method == HTTP_GET) {
+            // The handshake is done; failing here closes the socket.
+            return stream_add_client(req, true) ? ESP_OK : ESP_FAIL;
+        }
+        // Nothing is expected from the client, so drop whatever it sends, but
+        // read all of it or the next frame's header is taken from the middle
+        // of this one.
+        httpd_ws_frame_t frame = {};
+        esp_err_t err = httpd_ws_recv_frame(req, &frame, 0);
+        if (err == ESP_OK && frame.len) {
+            if (frame.len > STREAM_MAX_CLIENT_FRAME) {
+                // Failing closes the socket.
+                return ESP_FAIL;
+            }
+            frame.payload = (uint8_t *)malloc(frame.len);
+            if (!frame.payload) {
+                return ESP_ERR_NO_MEM;
+            }
+            err = httpd_ws_recv_frame(req, &frame, frame.len);
+            free(frame.payload);
+        }
+        return err;
+    }
+#endif
+    static const char sse_headers[] =
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: text/event-stream\r\n"
+        "Cache-Control: no-cache\r\n"
+        "\r\n";
+
+    if (stream_full()) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_sendstr(req, "too many stream clients\n");
+        return ESP_OK;
+    }
+    // The response never ends, so write the head ourselves instead of
+    // letting httpd frame it.
+    if (httpd_send(req, sse_headers, sizeof(sse_headers) - 1) < 0) {
+        return ESP_FAIL;
+    }
+    return stream_add_client(req, false) ? ESP_OK : ESP_FAIL;
+}
+
+static const httpd_uri_t stream_uri = {
+    .uri       = "/stream",
+    .method    = HTTP_GET,
+    .handler   = stream_handler,
+    .user_ctx  = NULL,
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    .is_websocket = true,
+#endif
+};
+
+// GET /api/series?metric=<name>&from=<ms>&to=<ms>&step=<ms> returns
+// min/max/mean points for one metric from the history kept in RAM. Times are
+// ms since boot, or back from now if zero or negative; from defaults to five
+// minutes ago, to to now and step to the finest available.
+static esp_err_t series_handler(httpd_req_t *req) {
+    char query[128];
+    char value[24];
+    series_query q = { SERIES_RANGE_MM, -300000, 0, 0 };
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK ||
+            httpd_query_key_value(query, "metric", value, sizeof(value)) != ESP_OK ||
+            !series_find_metric(value, &q.metric)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "metric must be range_mm, signal_rate_mcps, ambient_rate_mcps or sigma_mm");
+        return ESP_OK;
+    }
+    if (httpd_query_key_value(query, "from", value, sizeof(value)) == ESP_OK) {
+        q.from_ms = strtoll(value, NULL, 10);
+    }
+    if (httpd_query_key_value(query, "to", value, sizeof(value)) == ESP_OK) {
+        q.to_ms = strtoll(value, NULL, 10);
+    }
+    if (httpd_query_key_value(query, "step", value, sizeof(value)) == ESP_OK) {
+        q.step_ms = strtoll(value, NULL, 10);
+    }
+    httpd_resp_set_type(req, "application/json");
+    if (!series_write_json(&q, chunk_sink, req)) {
+        return ESP_FAIL;
+    }
+    httpd_resp_send_chunk(req, NULL, 0);
+    return ESP_OK;
+}
+
+static const httpd_uri_t series_uri = {
+    .uri       = "/api/series",
+    .method    = HTTP_GET,
+    .handler   = series_handler,
+    .user_ctx  = NULL,
+};
+
+// GET /api/export?since=<seq> dumps the raw samples taken after since in the
+// compact binary format described in sample_codec.h; host/export_decode turns
+// it back into CSV. The header's next_since is the since for the next call.
+static esp_err_t export_handler(httpd_req_t *req) {
+    char query[64];
+    char value[16];
+    uint32_t since = 0;
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+            httpd_query_key_value(query, "since", value, sizeof(value)) == ESP_OK) {
+        since = strtoul(value, NULL, 10);
+    }
+    httpd_resp_set_type(req, "application/octet-stream");
+    if (!series_export(since, chunk_sink, req)) {
+        return ESP_FAIL;
+    }
+    httpd_resp_send_chunk(req, NULL, 0);
+    return ESP_OK;
+}
+
+static const httpd_uri_t export_uri = {
+    .uri       = "/api/export",
+    .method    = HTTP_GET,
+    .handler   = export_handler,
+    .user_ctx  = NULL,
+};
+
+static void session_closed(httpd_handle_t server, int sockfd)
+{
+    stream_remove_client(sockfd);
+    close(sockfd);
+}
+
 httpd_handle_t start_webserver(void)
 {
     httpd_handle_t server = NULL;
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.lru_purge_enable = true;
+    config.close_fn = session_closed;
+    // One per httpd_register_uri_handler below, with room to spare.
+    config.max_uri_handlers = 16;
+#ifdef METRICS_STREAMING
+    // /metrics formats its chunks on the httpd task's stack.
+    config.stack_size += METRICS_CHUNK_SIZE + 1024;
+#endif
 
     // Start the httpd server
     M5.Log.printf("Starting server on port: '%d'\n", config.server_port);
@@ -69,6 +560,18 @@ httpd_handle_t start_webserver(void)
         M5.Log.println("Registering URI handlers");
         httpd_register_uri_handler(server, &hello);
         httpd_register_uri_handler(server, &metrics_uri);
+        httpd_register_uri_handler(server, &debug_i2c_uri);
+        httpd_register_uri_handler(server, &debug_pipeline_uri);
+        httpd_register_uri_handler(server, &profile_get_uri);
+        httpd_register_uri_handler(server, &profile_post_uri);
+        httpd_register_uri_handler(server, &calibrate_post_uri);
+        httpd_register_uri_handler(server, &filter_get_uri);
+        httpd_register_uri_handler(server, &filter_post_uri);
+        httpd_register_uri_handler(server, &events_get_uri);
+        httpd_register_uri_handler(server, &events_post_uri);
+        httpd_register_uri_handler(server, &stream_uri);
+        httpd_register_uri_handler(server, &series_uri);
+        httpd_register_uri_handler(server, &export_uri);
         return server;
     }
 
@@ -0,0 +1,100 @@
+#include "i2c_trace.hpp"
+
+#include <atomic>
+#include <esp_timer.h>
+#include "freertos/FreeRTOS.h"
+
+// Anyone holding the sensor may write, so appends go under a spinlock. Each
+// critical section is a single record copy, short enough that readers take
+// the same lock per record rather than needing a seqlock like samples.cpp.
+static i2c_trace_record ring[I2C_TRACE_RING_SIZE];
+static uint32_t head_seq = 0;    // last seq written
+static uint32_t cleared_seq = 0; // records up to here were cleared
+static portMUX_TYPE ring_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static std::atomic<bool> enabled(false);
+static uint8_t current_page = 0;
+
+static_assert((I2C_TRACE_RING_SIZE & (I2C_TRACE_RING_SIZE - 1)) == 0, "I2C_TRACE_RING_SIZE must be a power of two");
+static_assert(sizeof(i2c_trace_record) == 16, "i2c_trace_record is part of the /debug/i2c format");
+
+void i2c_trace_enable(bool enable) {
+    enabled.store(enable, std::memory_order_relaxed);
+}
+
+bool i2c_trace_enabled(void) {
+    return enabled.load(std::memory_order_relaxed);
+}
+
+void i2c_trace_clear(void) {
+    taskENTER_CRITICAL(&ring_lock);
+    cleared_seq = head_seq;
+    taskEXIT_CRITICAL(&ring_lock);
+}
+
+int64_t i2c_trace_start(void) {
+    if (!enabled.load(std::memory_order_relaxed)) {
+        return -1;
+    }
+    return esp_timer_get_time();
+}
+
+static void append(int64_t start_us, uint8_t reg, int32_t len, uint8_t flags, bool ok) {
+    int64_t duration = esp_timer_get_time() - start_us;
+    i2c_trace_record record = {
+        .seq = 0,
+        .timestamp_us = (uint32_t)start_us,
+        .duration_us = (uint16_t)(duration > UINT16_MAX ? UINT16_MAX : duration),
+        .page = current_page,
+        .reg = reg,
+        .len = (uint8_t)(len > UINT8_MAX ? UINT8_MAX : len),
+        .flags = (uint8_t)(flags | (ok ? 0 : I2C_TRACE_FAILED)),
+        .reserved = {0, 0},
+    };
+
+    taskENTER_CRITICAL(&ring_lock);
+    record.seq = ++head_seq;
+    ring[record.seq & (I2C_TRACE_RING_SIZE - 1)] = record;
+    taskEXIT_CRITICAL(&ring_lock);
+}
+
+void i2c_trace_read(int64_t start_us, uint8_t reg, int32_t len, bool ok) {
+    if (start_us < 0) {
+        return;
+    }
+    append(start_us, reg, len, I2C_TRACE_READ, ok);
+}
+
+void i2c_trace_write(int64_t start_us, uint8_t reg, const uint8_t *data, int32_t len, uint8_t flags, bool ok) {
+    // Record under the page the write was issued on, then follow the switch.
+    if (start_us >= 0) {
+        append(start_us, reg, len, flags, ok);
+    }
+    if (ok && len > 0 && (int32_t)0xFF - reg < len) {
+        current_page = data[0xFF - reg];
+    }
+}
+
+bool i2c_trace_next(uint32_t *cursor, i2c_trace_record *out) {
+    bool found = false;
+
+    taskENTER_CRITICAL(&ring_lock);
+    uint32_t seq = *cursor;
+    if (seq > head_seq) {
+        // Cursor from some other boot; start over.
+        seq = 0;
+    }
+    if (seq <= cleared_seq) {
+        seq = cleared_seq + 1;
+    }
+    if (head_seq >= I2C_TRACE_RING_SIZE && seq <= head_seq - I2C_TRACE_RING_SIZE) {
+        seq = head_seq - I2C_TRACE_RING_SIZE + 1;
+    }
+    if (seq <= head_seq) {
+        *out = ring[seq & (I2C_TRACE_RING_SIZE - 1)];
+        *cursor = seq + 1;
+        found = true;
+    }
+    taskEXIT_CRITICAL(&ring_lock);
+    return found;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+
+// Number of bus transactions retained; must be a power of two. At ~22
+// transactions per sample that's ~1.5s of back-to-back ranging.
+#ifndef I2C_TRACE_RING_SIZE
+#define I2C_TRACE_RING_SIZE 1024
+#endif
+
+#define I2C_TRACE_READ    0x01 // otherwise a write
+#define I2C_TRACE_BATCHED 0x02 // one record of a VL53L0X_write_batch session
+#define I2C_TRACE_FAILED  0x80 // the bus reported an error
+
+// One bus transaction. Kept small and fixed-size: the /debug/i2c dump is an
+// array of these, little-endian, after an i2c_trace_header.
+typedef struct {
+    uint32_t seq;          // starts at 1, one per record
+    uint32_t timestamp_us; // low 32 bits of esp_timer_get_time() at the start
+    uint16_t duration_us;  // saturates at 65535
+    uint8_t page;          // last value written to register 0xFF
+    uint8_t reg;
+    uint8_t len;
+    uint8_t flags;         // I2C_TRACE_*
+    uint8_t reserved[2];
+} i2c_trace_record;
+
+// The record count is whatever fits in the rest of the body. Records which
+// were overwritten mid-dump show up as a jump in seq.
+typedef struct {
+    char magic[4];         // "I2CT"
+    uint8_t version;       // 1
+    uint8_t record_size;   // sizeof(i2c_trace_record)
+    uint8_t enabled;
+    uint8_t reserved;
+    uint32_t now_us;       // timestamp_us clock at dump time, to age the records
+} i2c_trace_header;
+
+void i2c_trace_enable(bool enable);
+
+bool i2c_trace_enabled(void);
+
+// Forgets everything recorded so far.
+void i2c_trace_clear(void);
+
+// Timestamp to hand back to i2c_trace_read/i2c_trace_write, or -1 if tracing
+// is off. This is the only cost paid while disabled.
+int64_t i2c_trace_start(void);
+
+void i2c_trace_read(int64_t start_us, uint8_t reg, int32_t len, bool ok);
+
+// Called for every write, traced or not, so the page is right the moment
+// tracing is switched on.
+void i2c_trace_write(int64_t start_us, uint8_t reg, const uint8_t *data, int32_t len, uint8_t flags, bool ok);
+
+// Copies the oldest retained record at or after *cursor and advances *cursor
+// past it. Start with *cursor = 0. Returns false when caught up. Records which
+// were overwritten are skipped.
+bool i2c_trace_next(uint32_t *cursor, i2c_trace_record *out);
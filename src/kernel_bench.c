@@ -0,0 +1,157 @@
+#include "kernel_bench.h"
+#include "vl53l0x_api_core.h"
+#include "vl53l0x_platform.h"
+
+#ifdef ESP_PLATFORM
+#include <esp_cpu.h>
+#include <esp_log.h>
+#endif
+
+// Single-shot measurements at 30ms budget spanning the operating range: near
+// and far, dark and bright targets, sunlight, and no target at all. Captured
+// from host/vl53l0x_sim_run; append rows from kernel_bench_record() on real
+// hardware as they come up.
+const kernel_bench_case kernel_bench_cases[] = {
+    { "150mm white indoor",  0x58,  150, 0x00578A00, 0x00001800, 0x0400 },
+    { "500mm white indoor",  0x58,  496, 0x0007E600, 0x00003400, 0x25F2 },
+    { "1000mm grey indoor",  0x58, 1003, 0x00010200, 0x00005000, 0xB400 },
+    { "1500mm white indoor", 0x58, 1496, 0x0000E000, 0x00003400, 0xB400 },
+    { "800mm white sunlit",  0x58,  796, 0x00030800, 0x00065200, 0x62C9 },
+    { "2000mm white indoor", 0x58, 1997, 0x00008000, 0x00003400, 0xB400 },
+    { "no target",           0x20, 8190, 0x00002000, 0x00003600, 0xB400 },
+};
+const size_t kernel_bench_case_count = sizeof(kernel_bench_cases) / sizeof(kernel_bench_cases[0]);
+
+static const char *kernel_names[KERNEL_BENCH_COUNT] = {
+    "calc_sigma_estimate",
+    "calc_dmax",
+    "isqrt",
+    "quadrature_sum",
+    "calc_timeout_mclks",
+    "get_pal_range_status",
+};
+
+const char *kernel_bench_name(kernel_bench_kernel kernel)
+{
+    if (kernel >= KERNEL_BENCH_COUNT) {
+        return "unknown";
+    }
+    return kernel_names[kernel];
+}
+
+static void case_to_measurement(const kernel_bench_case *c, VL53L0X_RangingMeasurementData_t *m)
+{
+    m->TimeStamp = 0;
+    m->MeasurementTimeUsec = 0;
+    m->RangeMilliMeter = c->range_mm;
+    m->RangeDMaxMilliMeter = 0;
+    m->SignalRateRtnMegaCps = c->signal_rate_mcps;
+    m->AmbientRateRtnMegaCps = c->ambient_rate_mcps;
+    m->EffectiveSpadRtnCount = c->effective_spad_rtn_count;
+    m->ZoneId = 0;
+    m->RangeFractionalPart = 0;
+    // Sigma runs before GetRangingMeasurementData fills this in, so it sees
+    // whatever the previous sample left; assume a steady stream of this case.
+    m->RangeStatus = (c->device_range_status & 0x78) >> 3 == 11 ? 0 : 1;
+}
+
+uint32_t kernel_bench_call(VL53L0X_DEV Dev, kernel_bench_kernel kernel, const kernel_bench_case *c)
+{
+    VL53L0X_RangingMeasurementData_t m;
+    FixPoint1616_t sigma = 0;
+    uint32_t dmax = 0;
+    uint8_t status = 0;
+
+    switch (kernel) {
+    case KERNEL_BENCH_SIGMA_ESTIMATE:
+        case_to_measurement(c, &m);
+        VL53L0X_calc_sigma_estimate(Dev, &m, &sigma);
+        return sigma;
+    case KERNEL_BENCH_DMAX:
+        VL53L0X_calc_dmax(Dev, c->ambient_rate_mcps, &dmax);
+        return dmax;
+    case KERNEL_BENCH_ISQRT:
+        // Same magnitude as the event count sigma takes the root of.
+        return VL53L0X_isqrt((c->signal_rate_mcps >> 8) * c->effective_spad_rtn_count);
+    case KERNEL_BENCH_QUADRATURE_SUM:
+        return VL53L0X_quadrature_sum(c->signal_rate_mcps, c->ambient_rate_mcps);
+    case KERNEL_BENCH_TIMEOUT_MCLKS:
+        return VL53L0X_calc_timeout_mclks(Dev,
+            VL53L0X_GETDEVICESPECIFICPARAMETER(Dev, FinalRangeTimeoutMicroSecs),
+            VL53L0X_GETDEVICESPECIFICPARAMETER(Dev, FinalRangeVcselPulsePeriod));
+    case KERNEL_BENCH_PAL_RANGE_STATUS:
+        case_to_measurement(c, &m);
+        VL53L0X_get_pal_range_status(Dev, c->device_range_status, c->signal_rate_mcps,
+            c->effective_spad_rtn_count, &m, &status);
+        return status;
+    default:
+        return 0;
+    }
+}
+
+VL53L0X_Error kernel_bench_record(VL53L0X_DEV Dev, kernel_bench_case *c)
+{
+    VL53L0X_Error Status = VL53L0X_ERROR_NONE;
+    VL53L0X_RangingMeasurementData_t m;
+    uint8_t device_range_status;
+
+    Status = VL53L0X_PerformSingleRangingMeasurement(Dev, &m);
+    if (Status == VL53L0X_ERROR_NONE) {
+        // The API folds this into RangeStatus; the kernels want it raw.
+        Status = VL53L0X_RdByte(Dev, VL53L0X_REG_RESULT_RANGE_STATUS, &device_range_status);
+    }
+    if (Status != VL53L0X_ERROR_NONE) {
+        return Status;
+    }
+    c->label = "live";
+    c->device_range_status = device_range_status;
+    c->range_mm = m.RangeMilliMeter;
+    c->signal_rate_mcps = m.SignalRateRtnMegaCps;
+    c->ambient_rate_mcps = m.AmbientRateRtnMegaCps;
+    c->effective_spad_rtn_count = m.EffectiveSpadRtnCount;
+    return VL53L0X_ERROR_NONE;
+}
+
+#ifdef ESP_PLATFORM
+static const char *TAG = "bench";
+
+void kernel_bench_log(VL53L0X_DEV Dev, uint32_t iterations)
+{
+    volatile uint32_t sink = 0;
+    kernel_bench_case live;
+    VL53L0X_Error Status;
+
+    Status = kernel_bench_record(Dev, &live);
+    if (Status == VL53L0X_ERROR_NONE) {
+        ESP_LOGI(TAG, "live case: { \"live\", 0x%02X, %4u, 0x%08lX, 0x%08lX, 0x%04X }",
+            live.device_range_status, live.range_mm, (unsigned long)live.signal_rate_mcps,
+            (unsigned long)live.ambient_rate_mcps, live.effective_spad_rtn_count);
+    } else {
+        ESP_LOGW(TAG, "couldn't record a live case: %d", Status);
+    }
+
+    for (int k = 0; k < KERNEL_BENCH_COUNT; k++) {
+        uint32_t worst = 0;
+        uint64_t total = 0;
+        size_t worst_case = 0;
+        size_t cases = kernel_bench_case_count + (Status == VL53L0X_ERROR_NONE);
+
+        for (size_t i = 0; i < cases; i++) {
+            const kernel_bench_case *c = i < kernel_bench_case_count ? &kernel_bench_cases[i] : &live;
+            esp_cpu_cycle_count_t start = esp_cpu_get_cycle_count();
+            for (uint32_t n = 0; n < iterations; n++) {
+                sink = sink + kernel_bench_call(Dev, (kernel_bench_kernel)k, c);
+            }
+            uint32_t per_call = (esp_cpu_get_cycle_count() - start) / iterations;
+            total += per_call;
+            if (per_call > worst) {
+                worst = per_call;
+                worst_case = i;
+            }
+        }
+        ESP_LOGI(TAG, "%-22s %7lu cycles/call, worst %7lu (%s)", kernel_bench_name((kernel_bench_kernel)k),
+            (unsigned long)(total / cases), (unsigned long)worst,
+            worst_case < kernel_bench_case_count ? kernel_bench_cases[worst_case].label : live.label);
+    }
+}
+#endif
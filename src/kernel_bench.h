@@ -0,0 +1,61 @@
+#pragma once
+
+// Shared cases and call shims for benchmarking the fixed-point kernels in
+// vl53l0x_api_core.c which run on every sample. Plain C so the same code runs
+// in the firmware and in the host build (host/kernel_bench_run.c); each side
+// brings its own clock.
+
+#include <stddef.h>
+#include <stdint.h>
+#include "vl53l0x_api.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// One recorded measurement, as the device reported it before the API's
+// post-processing.
+typedef struct {
+    const char *label;
+    uint8_t device_range_status;       // raw RESULT_RANGE_STATUS byte
+    uint16_t range_mm;
+    FixPoint1616_t signal_rate_mcps;
+    FixPoint1616_t ambient_rate_mcps;
+    uint16_t effective_spad_rtn_count; // 8.8 fixed point
+} kernel_bench_case;
+
+typedef enum {
+    KERNEL_BENCH_SIGMA_ESTIMATE,
+    KERNEL_BENCH_DMAX,
+    KERNEL_BENCH_ISQRT,
+    KERNEL_BENCH_QUADRATURE_SUM,
+    KERNEL_BENCH_TIMEOUT_MCLKS,
+    KERNEL_BENCH_PAL_RANGE_STATUS,
+    KERNEL_BENCH_COUNT,
+} kernel_bench_kernel;
+
+extern const kernel_bench_case kernel_bench_cases[];
+extern const size_t kernel_bench_case_count;
+
+const char *kernel_bench_name(kernel_bench_kernel kernel);
+
+// Runs one kernel once against one case. The return value depends on the
+// kernel's output; fold it into something volatile so the call can't be
+// optimised out. The device must be past StaticInit. dmax and range status
+// read parameters back over I2C, so on the device their cost includes the bus.
+uint32_t kernel_bench_call(VL53L0X_DEV Dev, kernel_bench_kernel kernel, const kernel_bench_case *c);
+
+// Takes a single-shot measurement and records it as a case, so numbers can be
+// checked against what the sensor currently sees. The device must not be
+// ranging.
+VL53L0X_Error kernel_bench_record(VL53L0X_DEV Dev, kernel_bench_case *c);
+
+#ifdef ESP_PLATFORM
+// Logs cycles/call for every kernel over the recorded cases plus one live
+// measurement. Blocks for a while; call before ranging starts.
+void kernel_bench_log(VL53L0X_DEV Dev, uint32_t iterations);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
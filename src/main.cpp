@@ -1,10 +1,13 @@
 #include <M5GFX.h>
 #include <M5Unified.h>
 
+#include <stdio.h>
 #include <esp_netif.h>
 #include <esp_http_server.h>
 #include <esp_wifi.h>
 #include <esp_timer.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include <nvs_flash.h>
 #include <esp_log.h>
 // #include <esp_heap_trace.h>
@@ -14,10 +17,27 @@
 #include "wifi.hpp"
 #include "metrics.hpp"
 #include "ranger.hpp"
+#include "samples.hpp"
+#include "profiles.hpp"
+#include "calibration.hpp"
+#include "board.hpp"
+#include "range_metrics.hpp"
+#include "filter.hpp"
+#include "quality.hpp"
+#include "burst.hpp"
+#include "adaptive.hpp"
+#include "events.hpp"
+#include "series.hpp"
+#include "remote_write.hpp"
+#include "pipeline.hpp"
+#include "stream.hpp"
+#include "kernel_bench.h"
 
 #include "vl53l0x_api.h"
 #include "vl53l0x_platform.h"
 #include <malloc.h>
+#include <atomic>
+#include <math.h>
 
 // #define NUM_HEAP_DEBUG_RECORDS 100
 // static heap_trace_record_t trace_record[NUM_HEAP_DEBUG_RECORDS]; // This buffer must be in internal RAM
@@ -34,15 +54,27 @@ static void disconnect_handler(void* arg, esp_event_base_t event_base,
 static void draw_wifi_disconnected();
 
 static void init_lcd();
-static void draw_sensor(VL53L0X_RangingMeasurementData_t *data);
+static void draw_sensor(const range_sample *sample);
 static void draw_error(const char *msg, const char *detail);
-static void sensor_loop(void *arg);
+static float imu_temperature_c(void);
+static void sensor_task(void *arg);
+static void display_task(void *arg);
 
 static int32_t wifi_x, wifi_y, sensor_x, sensor_y;
 
 static VL53L0X_Dev_t *ranger_device;
+// Whether the sensor is ranging in the event window rather than for every
+// sample. Sensor task only.
+static bool event_mode;
 
-const uint16_t max_range_mm = 2000;
+// Last status from the sensor task, for the display task to report.
+static std::atomic<VL53L0X_Error> sensor_status(VL53L0X_ERROR_NONE);
+
+// How often the sensor task checks whether the temperature has drifted far
+// enough to need a new reference calibration.
+#ifndef RANGER_RECAL_CHECK_MS
+#define RANGER_RECAL_CHECK_MS 60000
+#endif
 
 extern "C" void app_main() {
     // ESP_ERROR_CHECK( heap_trace_init_standalone(trace_record, NUM_HEAP_DEBUG_RECORDS) );
@@ -56,9 +88,22 @@ extern "C" void app_main() {
     }
     ESP_ERROR_CHECK(ret);
     metrics_init();
+    range_metrics_init();
+    series_init();
+    filter_init();
+    quality_init();
+    burst_init();
+    adaptive_init();
+    events_init();
+    pipeline_init();
+    profiles_init();
 
     auto cfg = M5.config();
     M5.begin(cfg);
+    board_start();
+    stream_start();
+    remote_write_start();
+    metrics_start();
     M5.Ex_I2C.release();
     M5.Ex_I2C.begin(I2C_NUM_0, 0, 26);
     printf("M5.Ex_I2C.port = %d, SDA %d, SCL %d \n", M5.Ex_I2C.getPort(), M5.Ex_I2C.getSDA(), M5.Ex_I2C.getSCL());
@@ -80,40 +125,181 @@ extern "C" void app_main() {
 
     wifi_init_sta();
 
-    ranger_device = ranger_init();
-  
-    esp_timer_create_args_t sensor_timer_args = {
-        .callback = sensor_loop,
-        .arg = NULL,
-        .dispatch_method = ESP_TIMER_TASK,
-        .name = "sensor",
-        .skip_unhandled_events = true,
-    };
-    esp_timer_handle_t sensor_timer_handle;
-    ESP_ERROR_CHECK(esp_timer_create(&sensor_timer_args, &sensor_timer_handle));
-    ESP_ERROR_CHECK(esp_timer_start_periodic(sensor_timer_handle, 500000));
+    ranger_device = ranger_init(imu_temperature_c());
+
+#ifdef KERNEL_BENCH_ITERATIONS
+    // Define in const.hpp to log cycles/call for the per-sample math kernels at
+    // boot. Keep it modest (~1000): the 32-bit cycle counter wraps in ~17s and
+    // dmax goes over I2C.
+    if (ranger_device) {
+        kernel_bench_log(ranger_device, KERNEL_BENCH_ITERATIONS);
+    }
+#endif
+
+    // The sensor task blocks on the data-ready interrupt, so it gets a priority
+    // above the timer/httpd tasks to pick up samples as soon as they land.
+    xTaskCreate(sensor_task, "sensor", 4096, NULL, 6, NULL);
+    xTaskCreate(display_task, "display", 4096, NULL, 2, NULL);
 }
 
-static void sensor_loop(void *arg) {
-    // ESP_ERROR_CHECK( heap_trace_start(HEAP_TRACE_LEAKS) );
-    VL53L0X_RangingMeasurementData_t measurement;
+// The IMU die is the closest thing to a board temperature on the stick. The
+// board task owns the IMU, so this is its last reading.
+static float imu_temperature_c(void) {
+    return board_get_stats().temperature_c;
+}
+
+// Starts ranging for every sample, or only outside the event window if
+// /events asked for that.
+static VL53L0X_Error start_ranging(void) {
+    events_config events;
+
+    event_mode = events_begin(&events);
+    if (event_mode) {
+        return ranger_start_window(ranger_device, events.low_mm, events.high_mm, events.period_ms);
+    }
+    return ranger_start_continuous(ranger_device, 0);
+}
+
+// Profile switches, event window changes and recalibration are asked for from
+// other tasks but only this one touches the sensor, so they're picked up here
+// between samples, as are the adaptive controller's budget changes.
+static VL53L0X_Error apply_pending_changes(void) {
+    static int64_t next_temperature_check_us = 0;
+    static ranger_profile adapted;
     VL53L0X_Error Status = VL53L0X_ERROR_NONE;
-    Status = ranger_measure(ranger_device, &measurement);
-    // ESP_ERROR_CHECK( heap_trace_stop() );
-    // heap_trace_dump();
+    const ranger_profile *profile = adaptive_profile(profiles_selected(), &adapted);
+    const ranger_profile *current = ranger_applied_profile();
+    bool switch_profile = !current || current->name != profile->name ||
+        current->timing_budget_us != profile->timing_budget_us ||
+        current->pre_range_vcsel_pclks != profile->pre_range_vcsel_pclks ||
+        current->final_range_vcsel_pclks != profile->final_range_vcsel_pclks;
+    uint16_t offset_target_mm = 0, xtalk_target_mm = 0;
+    bool recalibrate = calibration_take_request(&offset_target_mm, &xtalk_target_mm);
+    bool restart = events_changed();
+    float temperature_c = NAN;
+
+    int64_t now_us = esp_timer_get_time();
+    if (recalibrate || now_us >= next_temperature_check_us) {
+        next_temperature_check_us = now_us + RANGER_RECAL_CHECK_MS * 1000LL;
+        temperature_c = imu_temperature_c();
+        recalibrate = recalibrate || ranger_calibration_stale(temperature_c);
+    }
+    if (!switch_profile && !recalibrate && !restart) {
+        return VL53L0X_ERROR_NONE;
+    }
+
+    Status = ranger_stop(ranger_device);
+    if (Status == VL53L0X_ERROR_NONE && recalibrate) {
+        Status = ranger_calibrate(ranger_device, temperature_c, offset_target_mm, xtalk_target_mm);
+    }
+    if (Status == VL53L0X_ERROR_NONE && switch_profile) {
+        Status = ranger_apply_profile(ranger_device, profile);
+    }
     if (Status == VL53L0X_ERROR_NONE) {
-        if (measurement.RangeMilliMeter < max_range_mm) {
-            draw_sensor(&measurement);
-        } else {
-            draw_error("ERROR", "max range");
+        Status = start_ranging();
+    }
+    return Status;
+}
+
+static void sensor_task(void *arg) {
+    VL53L0X_RangingMeasurementData_t measurement;
+    burst_result burst;
+    VL53L0X_Error Status = VL53L0X_ERROR_NONE;
+    bool crossed = false;
+
+    Status = start_ranging();
+    while (1) {
+        // ESP_ERROR_CHECK( heap_trace_start(HEAP_TRACE_LEAKS) );
+        if (Status == VL53L0X_ERROR_NONE && event_mode) {
+            const ranger_profile *profile = ranger_applied_profile();
+            Status = ranger_wait_window(ranger_device, &measurement,
+                events_wait_ms(profile ? profile->timing_budget_us : 0), &crossed);
+        } else if (Status == VL53L0X_ERROR_NONE) {
+            Status = ranger_wait_measurement(ranger_device, &measurement);
+        }
+        // ESP_ERROR_CHECK( heap_trace_stop() );
+        // heap_trace_dump();
+        sensor_status.store(Status, std::memory_order_relaxed);
+        if (Status == VL53L0X_ERROR_NONE) {
+            FixPoint1616_t sigma_mm = PALDevDataGet(ranger_device, SigmaEstimate);
+            quality_reason quality = quality_check(&measurement, sigma_mm);
+            range_metrics_observe(&measurement, sigma_mm, quality == QUALITY_OK);
+            // Event mode reads ranges too seldom to steer the budget or fill
+            // bursts; each one stands on its own.
+            uint8_t burst_count = 1;
+            if (event_mode) {
+                events_observe(&measurement, crossed);
+            } else {
+                adaptive_observe(&measurement, sigma_mm);
+                const ranger_profile *profile = ranger_applied_profile();
+                burst_count = profile ? profile->burst_count : 1;
+            }
+            // Profiles with a burst_count report one combined sample per
+            // burst; the rest of the pipeline only sees those.
+            if (burst_add(&measurement, sigma_mm, quality, burst_count, &burst)) {
+                bool accepted = burst.quality == QUALITY_OK;
+                if (accepted || !QUALITY_DROP_REJECTED) {
+                    uint16_t filtered_range_mm = filter_update(&burst.measurement, burst.sigma_mm, accepted);
+                    samples_publish(&burst, filtered_range_mm);
+                    series_observe(&burst.measurement, burst.sigma_mm, accepted);
+                }
+            }
+            pipeline_sample_done();
+
+            Status = apply_pending_changes();
+            sensor_status.store(Status, std::memory_order_relaxed);
+            if (Status == VL53L0X_ERROR_NONE) {
+                continue;
+            }
         }
-    } else {
-        char buf_s[32];
-        if (VL53L0X_GetPalErrorString(Status, buf_s) == VL53L0X_ERROR_NONE) {
-            draw_error("ERROR", buf_s);
+
+        // Back off and restart ranging; the sensor may have been power cycled,
+        // so don't trust the shadowed registers either.
+        vTaskDelay(pdMS_TO_TICKS(500));
+        burst_reset();
+        VL53L0X_ShadowInvalidate(ranger_device);
+        VL53L0X_StopMeasurement(ranger_device);
+        Status = start_ranging();
+    }
+}
+
+// The LCD only needs to keep up with a human, so it redraws from the newest
+// sample at its own pace and never holds up the sensor task.
+static void display_task(void *arg) {
+    range_sample sample;
+    uint32_t drawn_seq = 0;
+
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(100));
+        VL53L0X_Error Status = sensor_status.load(std::memory_order_relaxed);
+        if (Status != VL53L0X_ERROR_NONE) {
+            char buf_s[VL53L0X_MAX_STRING_LENGTH];
+            if (VL53L0X_GetPalErrorString(Status, buf_s) == VL53L0X_ERROR_NONE) {
+                draw_error("ERROR", buf_s);
+            } else {
+                draw_error("ERROR", "unknown");
+            }
+            drawn_seq = 0;
+            continue;
+        }
+        if (!samples_latest(&sample) || sample.seq == drawn_seq) {
+            continue;
+        }
+        drawn_seq = sample.seq;
+        int64_t start_us = esp_timer_get_time();
+        if (sample.quality == QUALITY_OK) {
+            draw_sensor(&sample);
+        } else if (sample.quality == QUALITY_RANGE_STATUS) {
+            // Any of the device's failures, not just running out of range.
+            char status_s[16];
+            snprintf(status_s, sizeof(status_s), "status %u", sample.range_status);
+            draw_error("ERROR", status_s);
+        } else if (sample.quality == QUALITY_OUT_OF_RANGE) {
+            draw_error("ERROR", "max range");
         } else {
-            draw_error("ERROR", "unknown");
+            draw_error("REJECT", quality_reason_name((quality_reason)sample.quality));
         }
+        pipeline_observe(PIPELINE_DISPLAY, esp_timer_get_time() - start_us);
     }
 }
 
@@ -200,17 +386,17 @@ static void draw_wifi_disconnected() {
     M5.Lcd.endWrite();
 }
 
-static void draw_sensor(VL53L0X_RangingMeasurementData_t *data) {
+static void draw_sensor(const range_sample *sample) {
     sensor_canvas.setCursor(0,0);
     sensor_canvas.fillScreen(BLACK);
     sensor_canvas.setTextColor(ORANGE);
     sensor_canvas.setFont(&FreeMono24pt7b);
     char buf_s[32];
-    sprintf(buf_s, "%0.1f", float(data->RangeMilliMeter) / 10.0);
+    sprintf(buf_s, "%0.1f", float(sample->filtered_range_mm) / 10.0);
     sensor_canvas.drawCenterString(buf_s, (M5.Lcd.width() - 4)/2, 2, &FreeMono24pt7b);
     sensor_canvas.setTextColor(LIGHTGREY);
     // SignalRateRtnMegaCps measures reflectivity it's a fixed 16-bit/16-bit number
-    sprintf(buf_s, "%0.1f%%", float(data->SignalRateRtnMegaCps) / (float(0xFFFFFF) / 100));
+    sprintf(buf_s, "%0.1f%%", float(sample->signal_rate_mcps) / (float(0xFFFFFF) / 100));
     sensor_canvas.drawCenterString(buf_s, (M5.Lcd.width() - 4)/2, 4+sensor_canvas.fontHeight(&FreeMono24pt7b), &FreeMono12pt7b);
     M5.Lcd.startWrite();
     sensor_canvas.pushSprite(sensor_x, sensor_y);
@@ -1,90 +1,293 @@
 #include "metrics.hpp"
 #include "const.hpp"
-#include "wifi.hpp"
+#include "board.hpp"
+#include "samples.hpp"
+#include "pipeline.hpp"
+#include "vl53l0x_i2c_platform.h"
+#include "vl53l0x_platform.h"
 
-#include <M5Unified.h>
+#include <atomic>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <esp_err.h>
-#include "esp_heap_caps.h"
+#include <esp_log.h>
+#include <esp_timer.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
-extern "C" {
-    #include "prom.h"
-}
+// Size of each of the two exposition buffers. A render that doesn't fit is
+// dropped and the previous one keeps being served; watch
+// metrics_page_high_water_bytes when adding metrics.
+#ifndef METRICS_BUFFER_SIZE
+#define METRICS_BUFFER_SIZE 16384
+#endif
 
-void metrics_refresh(void);
+// How often the exposition is re-rendered, i.e. how stale a scrape can be.
+#ifndef METRICS_RENDER_INTERVAL_MS
+#define METRICS_RENDER_INTERVAL_MS 5000
+#endif
 
-prom_metric_sample * device_temp;
-prom_metric_sample * wifi_rssi;
-prom_metric_sample * wifi_connected;
-prom_metric_sample * wifi_disconnects;
+// Room for every module's collector; there are 10 with remote write on.
+#ifndef METRICS_MAX_COLLECTORS
+#define METRICS_MAX_COLLECTORS 16
+#endif
 
-prom_gauge_t * heap_memory_bytes;
-prom_metric_sample * heap_memory_bytes_free;
-prom_metric_sample * heap_memory_bytes_allocated;
+static const char *TAG = "metrics";
 
-prom_collector_registry_t *metrics_registry;
-prom_collector_t *metrics_collector;
+struct metrics_writer {
+  metrics_sink sink;
+  void *ctx;
+  bool ok;        // false once the sink refused something; the rest is dropped
+  size_t total;   // bytes formatted, including any the sink refused
+  size_t len;
+  char buf[METRICS_CHUNK_SIZE];
+};
 
-multi_heap_info_t heap_info;
+static metrics_collector collectors[METRICS_MAX_COLLECTORS];
+static size_t collector_count = 0;
 
-void metrics_init(void) {
+// Written by whoever renders, which is one task at a time in either engine.
+static std::atomic<uint32_t> render_us(0);
+static std::atomic<uint32_t> high_water(0);
+
+#ifndef METRICS_STREAMING
+// Scrapes are served from the last rendered buffer while the render task fills
+// the other. A buffer is never rendered into while a scrape holds it; the
+// render is skipped until the next interval instead.
+typedef struct {
+  std::atomic<uint32_t> readers;
+  size_t len;
+  int64_t sample_us; // timestamp of the newest sample when rendered; 0 if none
+  char body[METRICS_BUFFER_SIZE];
+} exposition_buffer;
+
+static exposition_buffer buffers[2];
+static std::atomic<int> current(-1); // buffer to serve; -1 until the first render
+
+// Render task only.
+static uint32_t render_overflows = 0;
+#endif
+
+static void flush(metrics_writer *w) {
+  if (w->ok && w->len && !w->sink(w->ctx, w->buf, w->len)) {
+    w->ok = false;
+  }
+  w->len = 0;
+}
+
+void metrics_printf(metrics_writer *w, const char *fmt, ...) {
+  va_list args;
+  int n;
+
+  for (int attempt = 0; attempt < 2; attempt++) {
+    va_start(args, fmt);
+    n = vsnprintf(w->buf + w->len, sizeof(w->buf) - w->len, fmt, args);
+    va_end(args);
+    if (n < 0) {
+      return;
+    }
+    if ((size_t)n < sizeof(w->buf) - w->len) {
+      w->len += n;
+      w->total += n;
+      return;
+    }
+    // Didn't fit behind what's already there; send that and try again.
+    flush(w);
+  }
+  // A single line longer than the chunk. Not worth supporting.
+  ESP_LOGW(TAG, "dropped a %d byte line", n);
+  w->ok = false;
+}
+
+void metrics_write_family(metrics_writer *w, const char *name, const char *help, const char *type) {
+  metrics_printf(w, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+void metrics_write_sample(metrics_writer *w, const char *name, const char *labels, double value) {
   // Prometheus can't directly hit mDNS addresses, so the mDNS service-discovery plugin
   // passes it IP addresses for the instance values. We add the hostname label to all metrics
   // to avoid an unnecessarily complicated relabeling in prom.
-  const char * hostname_only_labels[] = {"hostname"};
-  const char * hostname_only_label_values[] = {HOSTNAME};
-  
-  metrics_registry = prom_collector_registry_new("sensors");
-  metrics_collector = prom_collector_new("sensors");
-  ESP_ERROR_CHECK(prom_collector_registry_register_collector(metrics_registry, metrics_collector));
-  
-
-  prom_metric_t * device_temp_metric = prom_gauge_new("temperature_f", "temperature in degrees farenheit", 1, hostname_only_labels);
-  ESP_ERROR_CHECK(prom_collector_add_metric(metrics_collector, device_temp_metric));
-  device_temp = prom_metric_sample_from_labels(device_temp_metric, hostname_only_label_values);
-
-  prom_metric_t * wifi_connected_metric = prom_gauge_new("wifi_connected", "True (1) if wifi is connected; false(0) otherwise.", 1, hostname_only_labels);
-  ESP_ERROR_CHECK(prom_collector_add_metric(metrics_collector, wifi_connected_metric));
-  wifi_connected = prom_metric_sample_from_labels(wifi_connected_metric, hostname_only_label_values);
-
-  prom_metric_t * wifi_rssi_metric = prom_gauge_new("wifi_rssi", "Wifi RSSI if connected; -1 otherwise", 1, hostname_only_labels);
-  ESP_ERROR_CHECK(prom_collector_add_metric(metrics_collector, wifi_rssi_metric));
-  wifi_rssi = prom_metric_sample_from_labels(wifi_rssi_metric, hostname_only_label_values);
-
-  prom_metric_t * wifi_disconnects_metric = prom_counter_new("wifi_disconnects", "Total number of disconnects for this boot.", 1, hostname_only_labels);
-  ESP_ERROR_CHECK(prom_collector_add_metric(metrics_collector, wifi_disconnects_metric));
-  wifi_disconnects = prom_metric_sample_from_labels(wifi_disconnects_metric, hostname_only_label_values);
-
-  const char * heap_memory_bytes_labels[] = {"availability", "hostname"};
-  heap_memory_bytes = prom_gauge_new("heap_memory_bytes", "Describes heap memory allocation", 2, heap_memory_bytes_labels);
-  ESP_ERROR_CHECK(prom_collector_add_metric(metrics_collector, (prom_metric_t *)heap_memory_bytes));
-
-  const char *heap_memory_bytes_free_label_values[] = {"free", HOSTNAME};
-  heap_memory_bytes_free = prom_metric_sample_from_labels(heap_memory_bytes, heap_memory_bytes_free_label_values);
-  
-  const char *heap_memory_bytes_allocated_label_values[] = {"allocated", HOSTNAME};
-  heap_memory_bytes_allocated = prom_metric_sample_from_labels(heap_memory_bytes, heap_memory_bytes_allocated_label_values);
-}
-
-const char * metrics_response(void) {
-    // It's not really clear how to use a custom collector function w/o access
-    // to the private `metrics` struct member or the default collector func. So
-    // I'm just going to refresh the metric samples here before generating the
-    // output.
-    metrics_refresh();
-    return prom_collector_registry_bridge(metrics_registry);
-}
-
-void metrics_refresh(void) {
-  float_t temp;
-  M5.Imu.getTemp(&temp);
-  prom_metric_sample_set(device_temp, double(temp*(9.0/5.0) + 32.0));
-
-  wifi_stats ws = wifi_get_stats();
-  prom_metric_sample_set(wifi_rssi, double(ws.rssi));
-  prom_metric_sample_set(wifi_connected, double(ws.connected));
-  prom_metric_sample_set(wifi_disconnects, double(ws.disconnects));
-
-  heap_caps_get_info(&heap_info, MALLOC_CAP_8BIT|MALLOC_CAP_32BIT);
-  prom_metric_sample_set(heap_memory_bytes_free, double(heap_info.total_free_bytes));
-  prom_metric_sample_set(heap_memory_bytes_allocated, double(heap_info.total_allocated_bytes));
+  metrics_printf(w, "%s{%s%shostname=\"" HOSTNAME "\"} %.15g\n", name, labels ? labels : "", labels ? "," : "", value);
+}
+
+// Shorthand for the common single-sample family.
+static void write_metric(metrics_writer *w, const char *name, const char *help, const char *type, double value) {
+  metrics_write_family(w, name, help, type);
+  metrics_write_sample(w, name, NULL, value);
+}
+
+static void collect_device(metrics_writer *w) {
+  // Cached by the board task so that a scrape never waits on the IMU or wifi.
+  board_stats bs = board_get_stats();
+  if (!isnan(bs.temperature_c)) {
+    write_metric(w, "temperature_f", "temperature in degrees farenheit", "gauge", double(bs.temperature_c*(9.0/5.0) + 32.0));
+  }
+  write_metric(w, "wifi_connected", "True (1) if wifi is connected; false(0) otherwise.", "gauge", double(bs.wifi_connected));
+  write_metric(w, "wifi_rssi", "Wifi RSSI if connected; -1 otherwise", "gauge", double(bs.wifi_rssi));
+  write_metric(w, "wifi_disconnects", "Total number of disconnects for this boot.", "counter", double(bs.wifi_disconnects));
+  write_metric(w, "board_sample_age_seconds", "Time since the temperature, wifi and heap figures were read.", "gauge",
+    double(esp_timer_get_time() - bs.sampled_us) / 1e6);
+
+  write_metric(w, "ranger_i2c_transactions", "Total number of I2C bus transactions issued to the ranging sensor.", "counter",
+    double(VL53L0X_get_transaction_count()));
+  range_sample sample;
+  if (samples_latest(&sample)) {
+    write_metric(w, "ranger_i2c_transactions_per_sample", "I2C bus transactions spent on the most recent range sample.", "gauge",
+      double(sample.i2c_transactions));
+  }
+  write_metric(w, "ranger_i2c_shadow_hits", "Total number of ranging sensor register reads served from the shadow copy instead of the bus.", "counter",
+    double(VL53L0X_GetShadowHitCount()));
+  write_metric(w, "ranger_register_reads", "Total number of ranging sensor register reads, from the bus or the shadow copy.", "counter",
+    double(VL53L0X_GetRegisterReadCount()));
+
+  metrics_write_family(w, "heap_memory_bytes", "Describes heap memory allocation", "gauge");
+  metrics_write_sample(w, "heap_memory_bytes", "availability=\"free\"", double(bs.heap_free_bytes));
+  metrics_write_sample(w, "heap_memory_bytes", "availability=\"allocated\"", double(bs.heap_allocated_bytes));
+
+  // Describes the previous page; this one isn't finished yet.
+  write_metric(w, "metrics_render_seconds", "Time taken to render the last complete page of metrics.", "gauge",
+    double(render_us.load(std::memory_order_relaxed)) / 1e6);
+  write_metric(w, "metrics_page_high_water_bytes", "Largest page of metrics rendered this boot.", "gauge",
+    double(high_water.load(std::memory_order_relaxed)));
+#ifndef METRICS_STREAMING
+  write_metric(w, "metrics_buffer_size_bytes", "Space available for a page of metrics.", "gauge", double(METRICS_BUFFER_SIZE));
+  write_metric(w, "metrics_render_overflows", "Total number of pages dropped for not fitting the buffer.", "counter",
+    double(render_overflows));
+#endif
+}
+
+void metrics_init(void) {
+  metrics_add_collector(collect_device);
+}
+
+void metrics_add_collector(metrics_collector collect) {
+  if (collector_count == METRICS_MAX_COLLECTORS) {
+    // Losing a module's metrics silently is worse than not booting.
+    ESP_LOGE(TAG, "too many collectors; raise METRICS_MAX_COLLECTORS");
+    abort();
+  }
+  collectors[collector_count++] = collect;
+}
+
+static bool write_with(metrics_sink sink, void *ctx, void (*write)(metrics_writer *w, void *arg), void *arg, size_t *total) {
+  metrics_writer w;
+
+  w.sink = sink;
+  w.ctx = ctx;
+  w.ok = true;
+  w.total = 0;
+  w.len = 0;
+  write(&w, arg);
+  flush(&w);
+  *total = w.total;
+  return w.ok;
+}
+
+bool metrics_write_with(metrics_sink sink, void *ctx, void (*write)(metrics_writer *w, void *arg), void *arg) {
+  size_t total;
+  return write_with(sink, ctx, write, arg, &total);
+}
+
+static void write_collectors(metrics_writer *w, void *arg) {
+  for (size_t i = 0; i < collector_count; i++) {
+    collectors[i](w);
+  }
+}
+
+bool metrics_write(metrics_sink sink, void *ctx) {
+  int64_t start_us = esp_timer_get_time();
+  size_t total;
+  bool ok = write_with(sink, ctx, write_collectors, NULL, &total);
+
+  if (total > high_water.load(std::memory_order_relaxed)) {
+    high_water.store(total, std::memory_order_relaxed);
+  }
+  if (ok) {
+    render_us.store(esp_timer_get_time() - start_us, std::memory_order_relaxed);
+  }
+  return ok;
+}
+
+#ifndef METRICS_STREAMING
+static bool buffer_sink(void *ctx, const char *data, size_t len) {
+  exposition_buffer *buffer = (exposition_buffer *)ctx;
+  if (len > sizeof(buffer->body) - buffer->len) {
+    return false;
+  }
+  memcpy(buffer->body + buffer->len, data, len);
+  buffer->len += len;
+  return true;
+}
+
+static void metrics_render(void) {
+  int target = current.load() == 0 ? 1 : 0;
+  exposition_buffer *buffer = &buffers[target];
+
+  if (buffer->readers.load() != 0) {
+    // Still being sent to a slow client.
+    return;
+  }
+
+  range_sample sample;
+  buffer->len = 0;
+  buffer->sample_us = samples_latest(&sample) ? sample.timestamp_us : 0;
+  if (metrics_write(buffer_sink, buffer)) {
+    current.store(target);
+  } else {
+    render_overflows++;
+    ESP_LOGW(TAG, "metrics need %u bytes, only have %u",
+      (unsigned)high_water.load(std::memory_order_relaxed), (unsigned)sizeof(buffer->body));
+  }
+}
+
+static void metrics_render_task(void *arg) {
+  TickType_t last_wake = xTaskGetTickCount();
+  while (1) {
+    metrics_render();
+    vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(METRICS_RENDER_INTERVAL_MS));
+  }
+}
+
+void metrics_start(void) {
+  xTaskCreate(metrics_render_task, "metrics", 4096, NULL, 1, NULL);
+}
+
+const char * metrics_acquire(size_t *len) {
+  while (1) {
+    int index = current.load();
+    if (index < 0) {
+      return NULL;
+    }
+    buffers[index].readers.fetch_add(1);
+    // If the render task moved on before it could see us, it may already be
+    // writing this buffer.
+    if (current.load() == index) {
+      if (buffers[index].sample_us) {
+        pipeline_observe(PIPELINE_SAMPLE_AGE, esp_timer_get_time() - buffers[index].sample_us);
+      }
+      *len = buffers[index].len;
+      return buffers[index].body;
+    }
+    buffers[index].readers.fetch_sub(1);
+  }
+}
+
+void metrics_release(const char *body) {
+  buffers[body == buffers[1].body ? 1 : 0].readers.fetch_sub(1);
+}
+#else
+void metrics_start(void) {
+  // Nothing to do; every scrape renders its own page.
+}
+
+bool metrics_stream(metrics_sink sink, void *ctx) {
+  range_sample sample;
+  if (samples_latest(&sample)) {
+    pipeline_observe(PIPELINE_SAMPLE_AGE, esp_timer_get_time() - sample.timestamp_us);
+  }
+  return metrics_write(sink, ctx);
 }
+#endif
@@ -1,7 +1,63 @@
-extern "C" {
-    #include "prom.h"
-}
+#pragma once
+
+#include <stddef.h>
+#include "const.hpp"
+
+// Every scrape renders straight to the socket, so memory use stays flat
+// however many series there are, at the cost of doing the work per scrape.
+// Define METRICS_PRERENDERED in const.hpp to serve scrapes from a page
+// rendered in the background instead; the page is over 16 KB with the
+// pipeline histograms, so raise METRICS_BUFFER_SIZE to match.
+#ifndef METRICS_PRERENDERED
+#define METRICS_STREAMING
+#endif
+
+// Largest piece handed to a metrics_sink, and so the longest line a collector
+// may write. metrics_write keeps one of these on the caller's stack.
+#ifndef METRICS_CHUNK_SIZE
+#define METRICS_CHUNK_SIZE 512
+#endif
+
+typedef struct metrics_writer metrics_writer;
+
+// Receives the exposition a piece at a time. Returning false abandons the rest.
+typedef bool (*metrics_sink)(void *ctx, const char *data, size_t len);
+
+// Writes some metric families. Runs from whichever task renders the page, so
+// it should report cached state rather than wait on hardware.
+typedef void (*metrics_collector)(metrics_writer *w);
 
 void metrics_init(void);
 
-const char * metrics_response(void);
\ No newline at end of file
+// Adds to what /metrics reports. Call before metrics_start.
+void metrics_add_collector(metrics_collector collect);
+
+// type is the Prometheus type: "gauge", "counter" or "histogram".
+void metrics_write_family(metrics_writer *w, const char *name, const char *help, const char *type);
+
+// labels are any besides hostname, already formatted (`a="1",b="2"`), or NULL.
+void metrics_write_sample(metrics_writer *w, const char *name, const char *labels, double value);
+
+// Renders the whole exposition through sink without ever holding more than
+// METRICS_CHUNK_SIZE of it. Returns false if the sink gave up.
+bool metrics_write(metrics_sink sink, void *ctx);
+
+// The same chunking for other text formats: runs write(w, arg) with a writer
+// over sink, which it fills with metrics_printf.
+bool metrics_write_with(metrics_sink sink, void *ctx, void (*write)(metrics_writer *w, void *arg), void *arg);
+
+void metrics_printf(metrics_writer *w, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+// Starts the task that keeps the exposition rendered. Call after board_start.
+void metrics_start(void);
+
+#ifdef METRICS_STREAMING
+// Serves a scrape: metrics_write plus the bookkeeping for having done so.
+bool metrics_stream(metrics_sink sink, void *ctx);
+#else
+// Borrows the latest rendered exposition, or returns NULL if there hasn't been
+// one yet. It isn't NUL terminated. The bytes stay put until metrics_release.
+const char * metrics_acquire(size_t *len);
+
+void metrics_release(const char *body);
+#endif
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include <esp_err.h>
+#include <nvs.h>
+
+// Settings which outlive a reboot are kept as blobs in one NVS namespace,
+// each behind a version word so a layout change can't be misread. Bump a
+// module's version when its T changes layout; older blobs are then ignored.
+#define RANGER_NVS_NAMESPACE "ranger"
+
+template <typename T>
+struct versioned_blob {
+    uint32_t version;
+    T value;
+};
+
+// Returns false, leaving *out alone, if nothing of this version and size is
+// saved under key.
+template <typename T>
+bool load_blob(const char *key, uint32_t version, T *out) {
+    nvs_handle_t handle;
+    versioned_blob<T> blob;
+    size_t len = sizeof(blob);
+    esp_err_t err;
+
+    if (nvs_open(RANGER_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        // Nothing saved yet.
+        return false;
+    }
+    err = nvs_get_blob(handle, key, &blob, &len);
+    nvs_close(handle);
+    if (err != ESP_OK || len != sizeof(blob) || blob.version != version) {
+        return false;
+    }
+    *out = blob.value;
+    return true;
+}
+
+// Writes and commits *value under key. The caller decides how much a
+// failure matters.
+template <typename T>
+esp_err_t save_blob(const char *key, uint32_t version, const T *value) {
+    nvs_handle_t handle;
+    versioned_blob<T> blob = { version, *value };
+    esp_err_t err;
+
+    err = nvs_open(RANGER_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(handle, key, &blob, sizeof(blob));
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    return err;
+}
@@ -0,0 +1,114 @@
+#include "pipeline.hpp"
+#include "histogram.hpp"
+#include "vl53l0x_i2c_platform.h"
+#include "vl53l0x_platform.h"
+
+#include <atomic>
+#include <stdio.h>
+
+// Indexed by pipeline_stage.
+static const char * const stage_names[] = {
+    "data_ready_wait",
+    "decode",
+    "bus",
+    "display",
+    "sample_age",
+};
+static_assert(sizeof(stage_names) / sizeof(stage_names[0]) == PIPELINE_STAGE_COUNT, "stage_names out of step with pipeline_stage");
+
+typedef struct {
+    histogram us;
+    std::atomic<uint32_t> last_us;
+    std::atomic<uint32_t> max_us;
+} stage_stats;
+
+static stage_stats stages[PIPELINE_STAGE_COUNT] = {
+    { { PIPELINE_US_BUCKETS, {}, {} }, {}, {} },
+    { { PIPELINE_US_BUCKETS, {}, {} }, {}, {} },
+    { { PIPELINE_US_BUCKETS, {}, {} }, {}, {} },
+    { { PIPELINE_US_BUCKETS, {}, {} }, {}, {} },
+    { { PIPELINE_US_BUCKETS, {}, {} }, {}, {} },
+};
+static histogram poll_iterations = { PIPELINE_POLL_BUCKETS, {}, {} };
+static std::atomic<uint32_t> last_poll_iterations(0);
+
+// Sensor task only.
+static uint64_t last_bus_time_us = 0;
+static uint32_t last_polling_delays = 0;
+
+void pipeline_observe(pipeline_stage stage, int64_t us) {
+    stage_stats *s = &stages[stage];
+    uint32_t value = us < 0 ? 0 : us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+
+    histogram_observe(&s->us, value);
+    s->last_us.store(value, std::memory_order_relaxed);
+    // Stages with more than one writer can lose a race here; it's only ever
+    // off by one observation.
+    if (value > s->max_us.load(std::memory_order_relaxed)) {
+        s->max_us.store(value, std::memory_order_relaxed);
+    }
+}
+
+void pipeline_sample_done(void) {
+    uint64_t bus_time_us = VL53L0X_get_bus_time_us();
+    uint32_t polling_delays = VL53L0X_GetPollingDelayCount();
+
+    pipeline_observe(PIPELINE_BUS, bus_time_us - last_bus_time_us);
+    // Each pass round a polling loop but the last sleeps once.
+    histogram_observe(&poll_iterations, polling_delays - last_polling_delays + 1);
+    last_poll_iterations.store(polling_delays - last_polling_delays + 1, std::memory_order_relaxed);
+    last_bus_time_us = bus_time_us;
+    last_polling_delays = polling_delays;
+}
+
+static void collect_pipeline(metrics_writer *w) {
+    char labels[32];
+
+    metrics_write_family(w, "ranger_pipeline_seconds", "Time spent in each stage of getting a sample from the sensor to a scrape.", "histogram");
+    for (int i = 0; i < PIPELINE_STAGE_COUNT; i++) {
+        snprintf(labels, sizeof(labels), "stage=\"%s\"", stage_names[i]);
+        histogram_write_series(w, "ranger_pipeline_seconds", labels, &stages[i].us, 1e-6);
+    }
+    histogram_write(w, "ranger_poll_iterations", "Passes round the data-ready polling loop per sample; 1 when the interrupt is used.", &poll_iterations, 1.0);
+}
+
+void pipeline_init(void) {
+    metrics_add_collector(collect_pipeline);
+}
+
+static void write_histogram_json(metrics_writer *w, const histogram *h) {
+    uint32_t cumulative = 0;
+    uint8_t count = histogram_bucket_count(h);
+
+    metrics_printf(w, "\"buckets\":[");
+    for (uint32_t i = 0; i <= count; i++) {
+        cumulative += h->buckets[i].load(std::memory_order_relaxed);
+        if (i < count) {
+            metrics_printf(w, "%s[%.0f,%lu]", i ? "," : "", histogram_bound(h, i), (unsigned long)cumulative);
+        } else {
+            metrics_printf(w, ",[null,%lu]", (unsigned long)cumulative);
+        }
+    }
+    metrics_printf(w, "],\"count\":%lu,\"sum\":%llu", (unsigned long)cumulative,
+        (unsigned long long)h->sum.load(std::memory_order_relaxed));
+}
+
+// {"stages":{"<stage>":{"buckets":[[le_us,cumulative],...,[null,count]],
+// "count":N,"sum":us,"last":us,"max":us},...},"poll_iterations":{...}}
+static void write_json(metrics_writer *w, void *arg) {
+    metrics_printf(w, "{\"stages\":{");
+    for (int i = 0; i < PIPELINE_STAGE_COUNT; i++) {
+        metrics_printf(w, "%s\"%s\":{", i ? "," : "", stage_names[i]);
+        write_histogram_json(w, &stages[i].us);
+        metrics_printf(w, ",\"last\":%lu,\"max\":%lu}",
+            (unsigned long)stages[i].last_us.load(std::memory_order_relaxed),
+            (unsigned long)stages[i].max_us.load(std::memory_order_relaxed));
+    }
+    metrics_printf(w, "},\"poll_iterations\":{");
+    write_histogram_json(w, &poll_iterations);
+    metrics_printf(w, ",\"last\":%lu}}", (unsigned long)last_poll_iterations.load(std::memory_order_relaxed));
+}
+
+bool pipeline_write_json(metrics_sink sink, void *ctx) {
+    return metrics_write_with(sink, ctx, write_json, NULL);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+#include "metrics.hpp"
+
+// Bucket layouts as histogram_layout initializers; see range_metrics.hpp.
+#ifndef PIPELINE_US_BUCKETS
+#define PIPELINE_US_BUCKETS {125, 0, 16} // 125 us..4.1 s
+#endif
+#ifndef PIPELINE_POLL_BUCKETS
+#define PIPELINE_POLL_BUCKETS {1, 0, 10} // 1..512 iterations
+#endif
+
+// Where a sample's time goes, from the sensor to a scrape.
+typedef enum {
+    PIPELINE_DATA_READY_WAIT, // blocked in ranger_wait_measurement until data was ready
+    PIPELINE_DECODE,          // VL53L0X_GetRangingMeasurementData
+    PIPELINE_BUS,             // I2C bus time per sample, all of it
+    PIPELINE_DISPLAY,         // drawing a sample and pushing it to the LCD
+    PIPELINE_SAMPLE_AGE,      // age of the newest sample when a scrape is served
+    PIPELINE_STAGE_COUNT,
+} pipeline_stage;
+
+// Registers the /metrics collector. Call after metrics_init.
+void pipeline_init(void);
+
+void pipeline_observe(pipeline_stage stage, int64_t us);
+
+// Closes out a sample, recording the bus time and polling loop iterations
+// spent since the previous one. Only the sensor task may call this.
+void pipeline_sample_done(void);
+
+// Writes every stage as JSON for /debug/pipeline.
+bool pipeline_write_json(metrics_sink sink, void *ctx);
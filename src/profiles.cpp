@@ -0,0 +1,81 @@
+#include "profiles.hpp"
+
+#include <atomic>
+#include <string.h>
+#include <esp_log.h>
+#include <nvs.h>
+
+static const char *TAG = "profiles";
+
+#define PROFILES_NVS_NAMESPACE "ranger"
+#define PROFILES_NVS_KEY       "profile"
+
+// Budgets follow ST's application note. Long range lengthens both VCSEL pulse
+// periods and relaxes the limits to accept weaker returns; default keeps the
+// limits this firmware has always used. Burst spends high-accuracy's 200 ms
+// on ten high-speed measurements instead of one; adaptive spends anything
+// between high-speed's and high-accuracy's budgets as the target needs.
+const ranger_profile ranger_profiles[] = {
+    { "default",       30000,  14, 10, (FixPoint1616_t)(0.5 * 65536),  (FixPoint1616_t)(18 * 65536), 1, 0 },
+    { "high-speed",    20000,  14, 10, (FixPoint1616_t)(0.25 * 65536), (FixPoint1616_t)(32 * 65536), 1, 0 },
+    { "long-range",    33000,  18, 14, (FixPoint1616_t)(0.1 * 65536),  (FixPoint1616_t)(60 * 65536), 1, 0 },
+    { "high-accuracy", 200000, 14, 10, (FixPoint1616_t)(0.25 * 65536), (FixPoint1616_t)(18 * 65536), 1, 0 },
+    { "burst",         20000,  14, 10, (FixPoint1616_t)(0.25 * 65536), (FixPoint1616_t)(32 * 65536), 10, 0 },
+    { "adaptive",      20000,  14, 10, (FixPoint1616_t)(0.25 * 65536), (FixPoint1616_t)(32 * 65536), 1, 200000 },
+};
+const size_t ranger_profile_count = sizeof(ranger_profiles) / sizeof(ranger_profiles[0]);
+
+static std::atomic<const ranger_profile *> selected(&ranger_profiles[0]);
+
+const ranger_profile * profiles_find(const char *name) {
+    for (size_t i = 0; i < ranger_profile_count; i++) {
+        if (strcmp(ranger_profiles[i].name, name) == 0) {
+            return &ranger_profiles[i];
+        }
+    }
+    return NULL;
+}
+
+void profiles_init(void) {
+    nvs_handle_t handle;
+    char name[32];
+    size_t len = sizeof(name);
+
+    if (nvs_open(PROFILES_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        // Nothing saved yet.
+        return;
+    }
+    if (nvs_get_str(handle, PROFILES_NVS_KEY, name, &len) == ESP_OK) {
+        const ranger_profile *profile = profiles_find(name);
+        if (profile) {
+            selected.store(profile);
+        } else {
+            ESP_LOGW(TAG, "ignoring unknown saved profile \"%s\"", name);
+        }
+    }
+    nvs_close(handle);
+}
+
+const ranger_profile * profiles_selected(void) {
+    return selected.load();
+}
+
+void profiles_select(const ranger_profile *profile) {
+    nvs_handle_t handle;
+    esp_err_t err;
+
+    selected.store(profile);
+
+    err = nvs_open(PROFILES_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err == ESP_OK) {
+        err = nvs_set_str(handle, PROFILES_NVS_KEY, profile->name);
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    if (err != ESP_OK) {
+        // Still switch; it just won't survive a reboot.
+        ESP_LOGW(TAG, "couldn't save profile: %s", esp_err_to_name(err));
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+#include "vl53l0x_api.h"
+
+// A named set of ranging parameters. Everything here can be changed on a
+// running device without going back through DataInit/StaticInit.
+typedef struct {
+    const char *name;
+    uint32_t timing_budget_us;
+    uint8_t pre_range_vcsel_pclks;
+    uint8_t final_range_vcsel_pclks;
+    FixPoint1616_t signal_rate_limit_mcps; // SIGNAL_RATE_FINAL_RANGE
+    FixPoint1616_t sigma_limit_mm;         // SIGMA_FINAL_RANGE
+    uint8_t burst_count;                   // measurements combined per reported sample
+    uint32_t max_timing_budget_us;         // above timing_budget_us lets adaptive.hpp choose between them
+} ranger_profile;
+
+extern const ranger_profile ranger_profiles[];
+extern const size_t ranger_profile_count;
+
+// NULL if there's no profile by that name.
+const ranger_profile * profiles_find(const char *name);
+
+// Restores the last selected profile from NVS, falling back to "default".
+// NVS must be initialized.
+void profiles_init(void);
+
+// The profile the sensor should be running.
+const ranger_profile * profiles_selected(void);
+
+// Selects a profile and persists the choice. Safe from any task; the sensor
+// task picks the change up between samples.
+void profiles_select(const ranger_profile *profile);
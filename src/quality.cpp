@@ -0,0 +1,58 @@
+#include "quality.hpp"
+#include "metrics.hpp"
+
+#include <atomic>
+
+static const char *const reason_names[] = {
+    "ok",
+    "range_status",
+    "out_of_range",
+    "sigma",
+    "signal_rate",
+    "spads",
+};
+static_assert(sizeof(reason_names) / sizeof(reason_names[0]) == QUALITY_REASON_COUNT, "reason_names out of step with quality_reason");
+
+static const char *const reason_labels[] = {
+    "reason=\"ok\"",
+    "reason=\"range_status\"",
+    "reason=\"out_of_range\"",
+    "reason=\"sigma\"",
+    "reason=\"signal_rate\"",
+    "reason=\"spads\"",
+};
+
+static std::atomic<uint32_t> counts[QUALITY_REASON_COUNT];
+
+const char * quality_reason_name(quality_reason reason) {
+    return reason < QUALITY_REASON_COUNT ? reason_names[reason] : "unknown";
+}
+
+static void collect_quality(metrics_writer *w) {
+    metrics_write_family(w, "ranger_samples_rejected", "Total number of samples kept from the display and range statistics, by why.", "counter");
+    for (int i = QUALITY_OK + 1; i < QUALITY_REASON_COUNT; i++) {
+        metrics_write_sample(w, "ranger_samples_rejected", reason_labels[i], counts[i].load(std::memory_order_relaxed));
+    }
+}
+
+void quality_init(void) {
+    metrics_add_collector(collect_quality);
+}
+
+quality_reason quality_check(const VL53L0X_RangingMeasurementData_t *measurement, FixPoint1616_t sigma_mm) {
+    quality_reason reason = QUALITY_OK;
+
+    if (measurement->RangeStatus != 0) {
+        reason = QUALITY_RANGE_STATUS;
+    } else if (measurement->RangeMilliMeter >= QUALITY_MAX_RANGE_MM) {
+        reason = QUALITY_OUT_OF_RANGE;
+    } else if (sigma_mm > QUALITY_MAX_SIGMA_MM) {
+        reason = QUALITY_SIGMA;
+    } else if (measurement->SignalRateRtnMegaCps < QUALITY_MIN_SIGNAL_RATE_MCPS) {
+        reason = QUALITY_SIGNAL_RATE;
+    } else if (measurement->EffectiveSpadRtnCount < QUALITY_MIN_EFFECTIVE_SPADS) {
+        reason = QUALITY_SPADS;
+    }
+    counts[reason].fetch_add(1, std::memory_order_relaxed);
+    return reason;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+#include "vl53l0x_api.h"
+
+// Decides which samples are good enough for the display, the filter and the
+// range statistics. The device's own RangeStatus only applies the limit
+// checks a profile enables, so this adds a fixed floor under every profile.
+// Thresholds are in the API's units; override them in const.hpp.
+
+// Farthest distance the module is specified for; beyond it ranges are
+// placeholders or wrapped-around phase.
+#ifndef QUALITY_MAX_RANGE_MM
+#define QUALITY_MAX_RANGE_MM 2000
+#endif
+
+// Sigma estimate above which a sample is too noisy to use, 16.16 mm.
+#ifndef QUALITY_MAX_SIGMA_MM
+#define QUALITY_MAX_SIGMA_MM ((FixPoint1616_t)(40 * 65536))
+#endif
+
+// Return signal rate below which there's too little target to trust, 16.16
+// Mcps.
+#ifndef QUALITY_MIN_SIGNAL_RATE_MCPS
+#define QUALITY_MIN_SIGNAL_RATE_MCPS ((FixPoint1616_t)(0.1 * 65536))
+#endif
+
+// Fewest SPADs that must have seen the return, 8.8 like
+// EffectiveSpadRtnCount. Very few means a grazing or partial target.
+#ifndef QUALITY_MIN_EFFECTIVE_SPADS
+#define QUALITY_MIN_EFFECTIVE_SPADS (1 * 256)
+#endif
+
+// 0 publishes rejected samples flagged with their reason, so /stream and
+// /api/export still show them; 1 drops them after counting, and the display
+// holds the last accepted sample.
+#ifndef QUALITY_DROP_REJECTED
+#define QUALITY_DROP_REJECTED 0
+#endif
+
+// Why a sample was rejected, in the order the checks run.
+typedef enum {
+    QUALITY_OK,
+    QUALITY_RANGE_STATUS, // the device flagged it
+    QUALITY_OUT_OF_RANGE,
+    QUALITY_SIGMA,
+    QUALITY_SIGNAL_RATE,
+    QUALITY_SPADS,
+    QUALITY_REASON_COUNT,
+} quality_reason;
+
+const char * quality_reason_name(quality_reason reason);
+
+// Registers the /metrics collector. Call after metrics_init.
+void quality_init(void);
+
+// Checks one measurement and counts the outcome. Only the sensor task may
+// call this.
+quality_reason quality_check(const VL53L0X_RangingMeasurementData_t *measurement, FixPoint1616_t sigma_mm);
@@ -0,0 +1,55 @@
+#include "range_metrics.hpp"
+#include "histogram.hpp"
+#include "metrics.hpp"
+
+#include <atomic>
+
+// Every sample lands here, not just the one a scrape happens to see.
+static histogram range_mm = { RANGE_MM_BUCKETS, {}, {} };
+static histogram signal_rate_mcps = { SIGNAL_RATE_MCPS_BUCKETS, {}, {} };
+static histogram ambient_rate_mcps = { AMBIENT_RATE_MCPS_BUCKETS, {}, {} };
+static histogram sigma_mm = { SIGMA_MM_BUCKETS, {}, {} };
+
+// Indexed by RangeStatus; anything past the end (255 is "no update") is
+// counted as other.
+static const char * const status_labels[] = {
+    "status=\"valid\"",
+    "status=\"sigma_fail\"",
+    "status=\"signal_fail\"",
+    "status=\"min_range_fail\"",
+    "status=\"phase_fail\"",
+    "status=\"hardware_fail\"",
+    "status=\"other\"",
+};
+#define STATUS_COUNT (sizeof(status_labels) / sizeof(status_labels[0]))
+static std::atomic<uint32_t> status_counts[STATUS_COUNT];
+
+static void collect_ranges(metrics_writer *w) {
+    histogram_write(w, "ranger_range_mm", "Distance of every accepted sample.", &range_mm, 1.0);
+    histogram_write(w, "ranger_signal_rate_mcps", "Return signal rate of every sample, in mega counts per second.", &signal_rate_mcps, 1.0 / 65536);
+    histogram_write(w, "ranger_ambient_rate_mcps", "Ambient light rate of every sample, in mega counts per second.", &ambient_rate_mcps, 1.0 / 65536);
+    histogram_write(w, "ranger_sigma_mm", "Estimated standard deviation of every sample.", &sigma_mm, 1.0 / 65536);
+
+    metrics_write_family(w, "ranger_samples", "Total number of samples taken, by range status.", "counter");
+    for (size_t i = 0; i < STATUS_COUNT; i++) {
+        metrics_write_sample(w, "ranger_samples", status_labels[i], status_counts[i].load(std::memory_order_relaxed));
+    }
+}
+
+void range_metrics_init(void) {
+    metrics_add_collector(collect_ranges);
+}
+
+void range_metrics_observe(const VL53L0X_RangingMeasurementData_t *measurement, FixPoint1616_t sigma, bool accepted) {
+    uint8_t status = measurement->RangeStatus;
+
+    status_counts[status < STATUS_COUNT - 1 ? status : STATUS_COUNT - 1].fetch_add(1, std::memory_order_relaxed);
+    if (accepted) {
+        // Failed samples report a placeholder distance, and outliers would
+        // drag the distribution around.
+        histogram_observe(&range_mm, measurement->RangeMilliMeter);
+    }
+    histogram_observe(&signal_rate_mcps, measurement->SignalRateRtnMegaCps);
+    histogram_observe(&ambient_rate_mcps, measurement->AmbientRateRtnMegaCps);
+    histogram_observe(&sigma_mm, sigma);
+}
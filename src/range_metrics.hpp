@@ -0,0 +1,27 @@
+#pragma once
+
+#include "vl53l0x_api.h"
+
+// Bucket layouts as histogram_layout initializers: {first bound, step or 0
+// to double, bucket count}. Signal, ambient and sigma are 16.16 fixed point
+// like the API reports them. Override in const.hpp.
+#ifndef RANGE_MM_BUCKETS
+#define RANGE_MM_BUCKETS {50, 50, 40} // 50..2000 mm
+#endif
+#ifndef SIGNAL_RATE_MCPS_BUCKETS
+#define SIGNAL_RATE_MCPS_BUCKETS {(uint32_t)(0.0625 * 65536), 0, 10} // 0.0625..32 Mcps
+#endif
+#ifndef AMBIENT_RATE_MCPS_BUCKETS
+#define AMBIENT_RATE_MCPS_BUCKETS {(uint32_t)(0.03125 * 65536), 0, 10} // 0.03125..16 Mcps
+#endif
+#ifndef SIGMA_MM_BUCKETS
+#define SIGMA_MM_BUCKETS {4 * 65536, 4 * 65536, 16} // 4..64 mm
+#endif
+
+// Registers the /metrics collector. Call after metrics_init.
+void range_metrics_init(void);
+
+// Counts one measurement into the histograms; range only if quality_check
+// accepted it. Only the sensor task may call this; it's a handful of atomic
+// adds.
+void range_metrics_observe(const VL53L0X_RangingMeasurementData_t *measurement, FixPoint1616_t sigma_mm, bool accepted);
@@ -1,7 +1,42 @@
 #include "vl53l0x_api.h"
 #include "vl53l0x_platform.h"
 #include <malloc.h>
+#include <math.h>
 #include <esp_log.h>
+#include <esp_timer.h>
+#include <driver/gpio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "const.hpp"
+#include "ranger.hpp"
+#include "profiles.hpp"
+#include "calibration.hpp"
+#include "pipeline.hpp"
+#include "vl53l0x_api_core.h"
+
+// GPIO1 of the VL53L0X is an open-drain, active-low data-ready line. It isn't
+// brought out on every board, so by default the result register is polled;
+// define RANGER_INT_GPIO in const.hpp to the pin it's wired to and sleep until
+// it fires instead. The line needs a pull-up, and GPIO34-39 have no internal
+// ones. Every edge is checked against the device anyway.
+#ifndef RANGER_INT_GPIO
+#define RANGER_INT_GPIO GPIO_NUM_NC
+#endif
+
+// Redo the reference calibration once the temperature has drifted this far
+// from where it was measured. ST's guidance is 8 degrees C.
+#ifndef RANGER_RECAL_DELTA_C
+#define RANGER_RECAL_DELTA_C 8.0f
+#endif
+
+static TaskHandle_t ranger_task = NULL;
+// What the device is currently configured with, so profile switches only
+// write what changed.
+static ranger_profile applied;
+// What the device is calibrated with, as saved in NVS.
+static ranger_calibration calibration;
+static const gpio_num_t ranger_int_gpio = (gpio_num_t)RANGER_INT_GPIO;
 
 static void print_pal_error(const char *op, VL53L0X_Error Status){
     char buf[VL53L0X_MAX_STRING_LENGTH];
@@ -20,13 +55,438 @@ VL53L0X_Error ranger_measure(VL53L0X_Dev_t *pMyDevice, VL53L0X_RangingMeasuremen
     return VL53L0X_ERROR_NONE;
 }
 
-VL53L0X_Dev_t * ranger_init()  {
+static void IRAM_ATTR ranger_data_ready_isr(void *arg) {
+    BaseType_t higher_priority_woken = pdFALSE;
+    TaskHandle_t task = ranger_task;
+    // Edges before anyone has started ranging have nobody to wake.
+    if (task) {
+        vTaskNotifyGiveFromISR(task, &higher_priority_woken);
+        portYIELD_FROM_ISR(higher_priority_woken);
+    }
+}
+
+// Arms the data-ready interrupt. Done once; starting and stopping ranging
+// only reprograms the device.
+static void init_int_gpio(void)
+{
+    if (ranger_int_gpio == GPIO_NUM_NC) {
+        return;
+    }
+    gpio_config_t io_conf = {
+        .pin_bit_mask = 1ULL << ranger_int_gpio,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_NEGEDGE,
+    };
+    ESP_ERROR_CHECK(gpio_config(&io_conf));
+    // Someone else (M5Unified) may have already installed the ISR service.
+    esp_err_t err = gpio_install_isr_service(0);
+    if (err != ESP_ERR_INVALID_STATE) {
+        ESP_ERROR_CHECK(err);
+    }
+    ESP_ERROR_CHECK(gpio_isr_handler_add(ranger_int_gpio, ranger_data_ready_isr, NULL));
+}
+
+// Starts continuous ranging with GPIO1 driven by the given function. The
+// thresholds are in 16.16 mm and only matter to the threshold functions.
+static VL53L0X_Error start_ranging(VL53L0X_Dev_t *pMyDevice, uint32_t inter_measurement_ms,
+    VL53L0X_GpioFunctionality functionality, FixPoint1616_t low_mm, FixPoint1616_t high_mm)
+{
+    VL53L0X_Error Status = VL53L0X_ERROR_NONE;
+    // A zero period asks the sensor to range back-to-back.
+    VL53L0X_DeviceModes mode = inter_measurement_ms ?
+        VL53L0X_DEVICEMODE_CONTINUOUS_TIMED_RANGING : VL53L0X_DEVICEMODE_CONTINUOUS_RANGING;
+
+    // Interrupts are delivered to whichever task starts ranging; it's the one
+    // which will block in ranger_wait_measurement or ranger_wait_window.
+    ranger_task = xTaskGetCurrentTaskHandle();
+
+    Status = VL53L0X_SetDeviceMode(pMyDevice, mode);
+    if(Status != VL53L0X_ERROR_NONE) {
+        print_pal_error("VL53L0X_SetDeviceMode", Status);
+        return Status;
+    }
+
+    if (inter_measurement_ms) {
+        Status = VL53L0X_SetInterMeasurementPeriodMilliSeconds(pMyDevice, inter_measurement_ms);
+        if(Status != VL53L0X_ERROR_NONE) {
+            print_pal_error("VL53L0X_SetInterMeasurementPeriodMilliSeconds", Status);
+            return Status;
+        }
+    }
+
+    if (functionality != VL53L0X_GPIOFUNCTIONALITY_NEW_MEASURE_READY) {
+        Status = VL53L0X_SetInterruptThresholds(pMyDevice, mode, low_mm, high_mm);
+        if(Status != VL53L0X_ERROR_NONE) {
+            print_pal_error("VL53L0X_SetInterruptThresholds", Status);
+            return Status;
+        }
+    }
+
+    Status = VL53L0X_SetGpioConfig(pMyDevice, 0, mode, functionality, VL53L0X_INTERRUPTPOLARITY_LOW);
+    if(Status != VL53L0X_ERROR_NONE) {
+        print_pal_error("VL53L0X_SetGpioConfig", Status);
+        return Status;
+    }
+
+    // Also loads the threshold tuning through
+    // VL53L0X_CheckAndLoadInterruptSettings when GPIO1 is on a threshold.
+    Status = VL53L0X_StartMeasurement(pMyDevice);
+    if(Status != VL53L0X_ERROR_NONE) {
+        print_pal_error("VL53L0X_StartMeasurement", Status);
+        return Status;
+    }
+    return VL53L0X_ERROR_NONE;
+}
+
+VL53L0X_Error ranger_start_continuous(VL53L0X_Dev_t *pMyDevice, uint32_t inter_measurement_ms)
+{
+    return start_ranging(pMyDevice, inter_measurement_ms, VL53L0X_GPIOFUNCTIONALITY_NEW_MEASURE_READY, 0, 0);
+}
+
+VL53L0X_Error ranger_start_window(VL53L0X_Dev_t *pMyDevice, uint16_t low_mm, uint16_t high_mm, uint32_t inter_measurement_ms)
+{
+    return start_ranging(pMyDevice, inter_measurement_ms, VL53L0X_GPIOFUNCTIONALITY_THRESHOLD_CROSSED_OUT,
+        (FixPoint1616_t)low_mm << 16, (FixPoint1616_t)high_mm << 16);
+}
+
+VL53L0X_Error ranger_stop(VL53L0X_Dev_t *pMyDevice)
+{
+    VL53L0X_Error Status = VL53L0X_ERROR_NONE;
+    uint32_t stopped = 1;
+
+    Status = VL53L0X_StopMeasurement(pMyDevice);
+    if(Status != VL53L0X_ERROR_NONE) {
+        print_pal_error("VL53L0X_StopMeasurement", Status);
+        return Status;
+    }
+    // The ranging in flight finishes first; give it one budget plus slack.
+    int64_t deadline_us = esp_timer_get_time() + applied.timing_budget_us + 10000;
+    while (1) {
+        Status = VL53L0X_GetStopCompletedStatus(pMyDevice, &stopped);
+        if(Status != VL53L0X_ERROR_NONE) {
+            print_pal_error("VL53L0X_GetStopCompletedStatus", Status);
+            return Status;
+        }
+        if (!stopped || esp_timer_get_time() > deadline_us) {
+            break;
+        }
+        // One tick, not pdMS_TO_TICKS(1): at 100 Hz that's 0 and would spin.
+        vTaskDelay(1);
+    }
+    if (stopped) {
+        Status = VL53L0X_ERROR_TIME_OUT;
+        print_pal_error("VL53L0X_GetStopCompletedStatus", Status);
+        return Status;
+    }
+    // Don't leave a stale data-ready latched for whoever starts ranging next.
+    Status = VL53L0X_ClearInterruptMask(pMyDevice, 0);
+    if(Status != VL53L0X_ERROR_NONE) {
+        print_pal_error("VL53L0X_ClearInterruptMask", Status);
+        return Status;
+    }
+    if (ranger_int_gpio != GPIO_NUM_NC) {
+        ulTaskNotifyTake(pdTRUE, 0);
+    }
+    return VL53L0X_ERROR_NONE;
+}
+
+VL53L0X_Error ranger_apply_profile(VL53L0X_Dev_t *pMyDevice, const ranger_profile *profile)
+{
+    VL53L0X_Error Status = VL53L0X_ERROR_NONE;
+    bool vcsel_changed = false;
+
+    // applied is updated step by step so a failure part way leaves it
+    // describing the device, and the next attempt redoes only what's missing.
+    // It has no name until the whole profile is in.
+    applied.name = NULL;
+    if (profile->pre_range_vcsel_pclks != applied.pre_range_vcsel_pclks) {
+        Status = VL53L0X_SetVcselPulsePeriod(pMyDevice, VL53L0X_VCSEL_PERIOD_PRE_RANGE, profile->pre_range_vcsel_pclks);
+        if(Status != VL53L0X_ERROR_NONE) {
+            print_pal_error("VL53L0X_SetVcselPulsePeriod", Status);
+            return Status;
+        }
+        applied.pre_range_vcsel_pclks = profile->pre_range_vcsel_pclks;
+        vcsel_changed = true;
+    }
+    if (profile->final_range_vcsel_pclks != applied.final_range_vcsel_pclks) {
+        Status = VL53L0X_SetVcselPulsePeriod(pMyDevice, VL53L0X_VCSEL_PERIOD_FINAL_RANGE, profile->final_range_vcsel_pclks);
+        if(Status != VL53L0X_ERROR_NONE) {
+            print_pal_error("VL53L0X_SetVcselPulsePeriod", Status);
+            return Status;
+        }
+        applied.final_range_vcsel_pclks = profile->final_range_vcsel_pclks;
+        vcsel_changed = true;
+    }
+    // Step timeouts are in VCSEL periods, so a new period means re-spreading
+    // the budget even if it's the same number.
+    if (vcsel_changed || profile->timing_budget_us != applied.timing_budget_us) {
+        applied.timing_budget_us = 0;
+        Status = VL53L0X_SetMeasurementTimingBudgetMicroSeconds(pMyDevice, profile->timing_budget_us);
+        if(Status != VL53L0X_ERROR_NONE) {
+            print_pal_error("VL53L0X_SetMeasurementTimingBudgetMicroSeconds", Status);
+            return Status;
+        }
+        applied.timing_budget_us = profile->timing_budget_us;
+    }
+    if (profile->signal_rate_limit_mcps != applied.signal_rate_limit_mcps) {
+        Status = VL53L0X_SetLimitCheckValue(pMyDevice, VL53L0X_CHECKENABLE_SIGNAL_RATE_FINAL_RANGE, profile->signal_rate_limit_mcps);
+        if(Status != VL53L0X_ERROR_NONE) {
+            print_pal_error("VL53L0X_SetLimitCheckValue", Status);
+            return Status;
+        }
+        applied.signal_rate_limit_mcps = profile->signal_rate_limit_mcps;
+    }
+    // The sigma limit is only checked by the API, so this one is free.
+    if (profile->sigma_limit_mm != applied.sigma_limit_mm) {
+        Status = VL53L0X_SetLimitCheckValue(pMyDevice, VL53L0X_CHECKENABLE_SIGMA_FINAL_RANGE, profile->sigma_limit_mm);
+        if(Status != VL53L0X_ERROR_NONE) {
+            print_pal_error("VL53L0X_SetLimitCheckValue", Status);
+            return Status;
+        }
+        applied.sigma_limit_mm = profile->sigma_limit_mm;
+    }
+    // Not device settings; carried along so the sensor task finds them with
+    // the rest.
+    applied.burst_count = profile->burst_count;
+    applied.max_timing_budget_us = profile->max_timing_budget_us;
+    applied.name = profile->name;
+    ESP_LOGI("ranger", "profile %s applied", profile->name);
+    return VL53L0X_ERROR_NONE;
+}
+
+const ranger_profile * ranger_applied_profile(void)
+{
+    return applied.name ? &applied : NULL;
+}
+
+static VL53L0X_Error apply_calibration(VL53L0X_Dev_t *pMyDevice)
+{
+    VL53L0X_Error Status = VL53L0X_ERROR_NONE;
+
+    Status = VL53L0X_SetRefCalibration(pMyDevice, calibration.vhv_settings, calibration.phase_cal);
+    if(Status != VL53L0X_ERROR_NONE) {
+        print_pal_error("VL53L0X_SetRefCalibration", Status);
+        return Status;
+    }
+    if (calibration.has_offset) {
+        Status = VL53L0X_SetOffsetCalibrationDataMicroMeter(pMyDevice, calibration.offset_um);
+        if(Status != VL53L0X_ERROR_NONE) {
+            print_pal_error("VL53L0X_SetOffsetCalibrationDataMicroMeter", Status);
+            return Status;
+        }
+    }
+    if (calibration.has_xtalk) {
+        Status = VL53L0X_SetXTalkCompensationRateMegaCps(pMyDevice, calibration.xtalk_mcps);
+        if(Status != VL53L0X_ERROR_NONE) {
+            print_pal_error("VL53L0X_SetXTalkCompensationRateMegaCps", Status);
+            return Status;
+        }
+        Status = VL53L0X_SetXTalkCompensationEnable(pMyDevice, 1);
+        if(Status != VL53L0X_ERROR_NONE) {
+            print_pal_error("VL53L0X_SetXTalkCompensationEnable", Status);
+            return Status;
+        }
+    }
+    return VL53L0X_ERROR_NONE;
+}
+
+VL53L0X_Error ranger_calibrate(VL53L0X_Dev_t *pMyDevice, float temperature_c, uint16_t offset_target_mm, uint16_t xtalk_target_mm)
+{
     VL53L0X_Error Status = VL53L0X_ERROR_NONE;
-    VL53L0X_Dev_t *pMyDevice = (VL53L0X_Dev_t *) malloc(sizeof(VL53L0X_Dev_t));
-    VL53L0X_DeviceInfo_t                DeviceInfo;
     uint8_t VhvSettings;
     uint8_t PhaseCal;
 
+    Status = VL53L0X_PerformRefCalibration(pMyDevice, &VhvSettings, &PhaseCal);
+    if(Status != VL53L0X_ERROR_NONE) {
+        print_pal_error("VL53L0X_PerformRefCalibration", Status);
+        return Status;
+    }
+    calibration.vhv_settings = VhvSettings;
+    calibration.phase_cal = PhaseCal;
+    calibration.temperature_c = temperature_c;
+
+    // ST's order: offset first, then crosstalk, each against a target at a
+    // known distance.
+    if (offset_target_mm) {
+        Status = VL53L0X_PerformOffsetCalibration(pMyDevice, (FixPoint1616_t)offset_target_mm << 16, &calibration.offset_um);
+        if(Status != VL53L0X_ERROR_NONE) {
+            print_pal_error("VL53L0X_PerformOffsetCalibration", Status);
+            return Status;
+        }
+        calibration.has_offset = 1;
+    }
+    if (xtalk_target_mm) {
+        Status = VL53L0X_PerformXTalkCalibration(pMyDevice, (FixPoint1616_t)xtalk_target_mm << 16, &calibration.xtalk_mcps);
+        if(Status != VL53L0X_ERROR_NONE) {
+            print_pal_error("VL53L0X_PerformXTalkCalibration", Status);
+            return Status;
+        }
+        calibration.has_xtalk = 1;
+    }
+
+    ESP_LOGI("ranger", "calibrated at %.1fC: vhv %u phase %u offset %ldum xtalk %lu",
+        temperature_c, VhvSettings, PhaseCal, (long)calibration.offset_um, (unsigned long)calibration.xtalk_mcps);
+    calibration_save(&calibration);
+    return VL53L0X_ERROR_NONE;
+}
+
+bool ranger_calibration_stale(float temperature_c)
+{
+    // Without a temperature on either side there's nothing to compare.
+    if (isnan(temperature_c) || isnan(calibration.temperature_c)) {
+        return false;
+    }
+    return fabsf(temperature_c - calibration.temperature_c) > RANGER_RECAL_DELTA_C;
+}
+
+// Reads back what DataInit/StaticInit left on the device as the baseline for
+// ranger_apply_profile.
+static VL53L0X_Error read_applied(VL53L0X_Dev_t *pMyDevice)
+{
+    VL53L0X_Error Status = VL53L0X_ERROR_NONE;
+
+    applied.name = NULL;
+    Status = VL53L0X_GetVcselPulsePeriod(pMyDevice, VL53L0X_VCSEL_PERIOD_PRE_RANGE, &applied.pre_range_vcsel_pclks);
+    if (Status == VL53L0X_ERROR_NONE) {
+        Status = VL53L0X_GetVcselPulsePeriod(pMyDevice, VL53L0X_VCSEL_PERIOD_FINAL_RANGE, &applied.final_range_vcsel_pclks);
+    }
+    if (Status == VL53L0X_ERROR_NONE) {
+        Status = VL53L0X_GetMeasurementTimingBudgetMicroSeconds(pMyDevice, &applied.timing_budget_us);
+    }
+    if (Status == VL53L0X_ERROR_NONE) {
+        Status = VL53L0X_GetLimitCheckValue(pMyDevice, VL53L0X_CHECKENABLE_SIGNAL_RATE_FINAL_RANGE, &applied.signal_rate_limit_mcps);
+    }
+    if (Status == VL53L0X_ERROR_NONE) {
+        Status = VL53L0X_GetLimitCheckValue(pMyDevice, VL53L0X_CHECKENABLE_SIGMA_FINAL_RANGE, &applied.sigma_limit_mm);
+    }
+    return Status;
+}
+
+VL53L0X_Error ranger_wait_measurement(VL53L0X_Dev_t *pMyDevice, VL53L0X_RangingMeasurementData_t *measurement)
+{
+    VL53L0X_Error Status = VL53L0X_ERROR_NONE;
+    uint32_t budget_us, period_ms;
+    uint8_t ready = 0;
+    int64_t start_us = esp_timer_get_time();
+
+    VL53L0X_GETPARAMETERFIELD(pMyDevice, MeasurementTimingBudgetMicroSeconds, budget_us);
+    VL53L0X_GETPARAMETERFIELD(pMyDevice, InterMeasurementPeriodMilliSeconds, period_ms);
+    // Give the sensor two full periods before we call it stuck.
+    TickType_t timeout = pdMS_TO_TICKS(2 * (budget_us / 1000 + period_ms)) + 1;
+
+    if (ranger_int_gpio != GPIO_NUM_NC) {
+        TickType_t start = xTaskGetTickCount();
+        while (1) {
+            TickType_t elapsed = xTaskGetTickCount() - start;
+            bool notified = ulTaskNotifyTake(pdTRUE, elapsed < timeout ? timeout - elapsed : 0) != 0;
+            // Ask the device either way: no edge may mean it was missed or
+            // GPIO1 isn't wired, and an edge may be noise on the line.
+            Status = VL53L0X_GetMeasurementDataReady(pMyDevice, &ready);
+            if (Status != VL53L0X_ERROR_NONE || ready) {
+                break;
+            }
+            if (!notified || xTaskGetTickCount() - start >= timeout) {
+                Status = VL53L0X_ERROR_TIME_OUT;
+                break;
+            }
+        }
+    } else {
+        TickType_t start = xTaskGetTickCount();
+        while (1) {
+            Status = VL53L0X_GetMeasurementDataReady(pMyDevice, &ready);
+            if (Status != VL53L0X_ERROR_NONE || ready) {
+                break;
+            }
+            if (xTaskGetTickCount() - start > timeout) {
+                Status = VL53L0X_ERROR_TIME_OUT;
+                break;
+            }
+            VL53L0X_PollingDelay(pMyDevice);
+        }
+    }
+    if(Status != VL53L0X_ERROR_NONE) {
+        print_pal_error("VL53L0X_GetMeasurementDataReady", Status);
+        return Status;
+    }
+
+    int64_t ready_us = esp_timer_get_time();
+    pipeline_observe(PIPELINE_DATA_READY_WAIT, ready_us - start_us);
+
+    Status = VL53L0X_GetRangingMeasurementData(pMyDevice, measurement);
+    if(Status != VL53L0X_ERROR_NONE) {
+        print_pal_error("VL53L0X_GetRangingMeasurementData", Status);
+        return Status;
+    }
+    pipeline_observe(PIPELINE_DECODE, esp_timer_get_time() - ready_us);
+
+    // Clearing the interrupt releases GPIO1 and arms it for the next sample.
+    Status = VL53L0X_ClearInterruptMask(pMyDevice, 0);
+    if(Status != VL53L0X_ERROR_NONE) {
+        print_pal_error("VL53L0X_ClearInterruptMask", Status);
+        return Status;
+    }
+    return VL53L0X_ERROR_NONE;
+}
+
+VL53L0X_Error ranger_wait_window(VL53L0X_Dev_t *pMyDevice, VL53L0X_RangingMeasurementData_t *measurement,
+    uint32_t timeout_ms, bool *crossed)
+{
+    VL53L0X_Error Status = VL53L0X_ERROR_NONE;
+    uint32_t interrupt = 0;
+
+    if (ranger_int_gpio != GPIO_NUM_NC) {
+        // Nothing to do but sleep until the sensor has something to say. The
+        // status read covers an edge that was missed as well as one that came.
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeout_ms) + 1);
+        Status = VL53L0X_GetInterruptMaskStatus(pMyDevice, &interrupt);
+    } else {
+        uint32_t period_ms;
+        TickType_t start = xTaskGetTickCount();
+
+        // No need to poll faster than the sensor ranges.
+        VL53L0X_GETPARAMETERFIELD(pMyDevice, InterMeasurementPeriodMilliSeconds, period_ms);
+        while (1) {
+            Status = VL53L0X_GetInterruptMaskStatus(pMyDevice, &interrupt);
+            if (Status != VL53L0X_ERROR_NONE || interrupt || xTaskGetTickCount() - start > pdMS_TO_TICKS(timeout_ms)) {
+                break;
+            }
+            vTaskDelay(pdMS_TO_TICKS(period_ms) + 1);
+        }
+    }
+    if(Status != VL53L0X_ERROR_NONE) {
+        print_pal_error("VL53L0X_GetInterruptMaskStatus", Status);
+        return Status;
+    }
+    *crossed = interrupt != 0;
+
+    // The result registers follow every measurement whether or not it
+    // interrupted, so a timeout still reads the latest range.
+    int64_t start_us = esp_timer_get_time();
+    Status = VL53L0X_GetRangingMeasurementData(pMyDevice, measurement);
+    if(Status != VL53L0X_ERROR_NONE) {
+        print_pal_error("VL53L0X_GetRangingMeasurementData", Status);
+        return Status;
+    }
+    pipeline_observe(PIPELINE_DECODE, esp_timer_get_time() - start_us);
+
+    if (*crossed) {
+        Status = VL53L0X_ClearInterruptMask(pMyDevice, 0);
+        if(Status != VL53L0X_ERROR_NONE) {
+            print_pal_error("VL53L0X_ClearInterruptMask", Status);
+            return Status;
+        }
+    }
+    return VL53L0X_ERROR_NONE;
+}
+
+VL53L0X_Dev_t * ranger_init(float temperature_c)  {
+    VL53L0X_Error Status = VL53L0X_ERROR_NONE;
+    // calloc: the platform layer expects its batching state zeroed.
+    VL53L0X_Dev_t *pMyDevice = (VL53L0X_Dev_t *) calloc(1, sizeof(VL53L0X_Dev_t));
+    VL53L0X_DeviceInfo_t                DeviceInfo;
+
     // Initialize Commsr
     pMyDevice->I2cDevAddr      = 0x29;
     pMyDevice->comms_type      =  1;
@@ -41,6 +501,28 @@ VL53L0X_Dev_t * ranger_init()  {
         return NULL;
     }
     
+    // Everything saved is per part, so find out which one this is. That's two
+    // NVM words; the rest of what the API wants from NVM (SPAD map, product
+    // id, offset adjustment, ~15 words each a strobe and a poll) is restored
+    // from NVS when we've seen this part before.
+    uint32_t part_uid_upper, part_uid_lower;
+    VL53L0X_DeviceNvmInfo_t nvm_info;
+    Status = VL53L0X_read_part_uid(pMyDevice, &part_uid_upper, &part_uid_lower);
+    if(Status != VL53L0X_ERROR_NONE) {
+        print_pal_error("VL53L0X_read_part_uid", Status);
+        return NULL;
+    }
+    if (calibration_load_nvm_info(part_uid_upper, part_uid_lower, &nvm_info)) {
+        VL53L0X_set_nvm_info(pMyDevice, &nvm_info);
+    } else {
+        Status = VL53L0X_get_nvm_info(pMyDevice, &nvm_info);
+        if(Status != VL53L0X_ERROR_NONE) {
+            print_pal_error("VL53L0X_get_nvm_info", Status);
+            return NULL;
+        }
+        calibration_save_nvm_info(&nvm_info);
+    }
+
     Status = VL53L0X_GetDeviceInfo(pMyDevice, &DeviceInfo);
     if(Status != VL53L0X_ERROR_NONE) {
         print_pal_error("VL53L0X_GetDeviceInfo", Status);
@@ -68,10 +550,25 @@ VL53L0X_Dev_t * ranger_init()  {
         return NULL;
     }
     
-    Status = VL53L0X_PerformRefCalibration(pMyDevice, &VhvSettings, &PhaseCal); // Device Initialization
-    if(Status != VL53L0X_ERROR_NONE) {
-        print_pal_error("VL53L0X_PerformRefCalibration", Status);
-        return NULL;
+    // VHV and phase calibration are each a full measurement, so reuse the last
+    // results for this part unless the temperature has moved on since.
+    bool restored = calibration_load(part_uid_upper, part_uid_lower, &calibration);
+    if (restored) {
+        Status = apply_calibration(pMyDevice);
+        if(Status != VL53L0X_ERROR_NONE) {
+            return NULL;
+        }
+    } else {
+        calibration = {};
+        calibration.part_uid_upper = part_uid_upper;
+        calibration.part_uid_lower = part_uid_lower;
+        calibration.temperature_c = NAN;
+    }
+    if (!restored || ranger_calibration_stale(temperature_c)) {
+        Status = ranger_calibrate(pMyDevice, temperature_c, 0, 0);
+        if(Status != VL53L0X_ERROR_NONE) {
+            return NULL;
+        }
     }
 
     // This seemed to cause problems and in the docs it was described as optional if no cover-glass was used.
@@ -83,33 +580,28 @@ VL53L0X_Dev_t * ranger_init()  {
     // }
     // printf ("refSpadCount = %d, isApertureSpads = %d\n", refSpadCount, isApertureSpads);
 
-    // no need to do this when we use VL53L0X_PerformSingleRangingMeasurement
+    // ranger_start_continuous switches to a continuous mode; single ranging is
+    // the safe default until then.
     Status = VL53L0X_SetDeviceMode(pMyDevice, VL53L0X_DEVICEMODE_SINGLE_RANGING); // Setup in single ranging mode
     if(Status != VL53L0X_ERROR_NONE) {
         print_pal_error("VL53L0X_SetDeviceMode", Status);
         return NULL;
     }
 
-    // This seems to set the minimum required signal amount.
-    Status = VL53L0X_SetLimitCheckValue(pMyDevice, VL53L0X_CHECKENABLE_SIGNAL_RATE_FINAL_RANGE, (FixPoint1616_t)(0.5*65536));
+    Status = read_applied(pMyDevice);
     if(Status != VL53L0X_ERROR_NONE) {
-        print_pal_error("VL53L0X_SetLimitCheckValue", Status);
+        print_pal_error("read_applied", Status);
         return NULL;
     }
-    
-    // This seems to set the minimum range.
-    Status = VL53L0X_SetLimitCheckValue(pMyDevice, VL53L0X_CHECKENABLE_SIGMA_FINAL_RANGE, (FixPoint1616_t)(18*65536));
-    if(Status != VL53L0X_ERROR_NONE) {
-        print_pal_error("VL53L0X_SetLimitCheckValue", Status);
-        return NULL;
-    }			
-    
-    // 200ms (200000us) is high-accuracy mode, 30ms default, 33 long-range, and 20ms high-speed.
-    Status = VL53L0X_SetMeasurementTimingBudgetMicroSeconds(pMyDevice, 200000);
+
+    // The profile sets the timing budget, VCSEL periods and the signal/sigma
+    // limit checks. We range continuously, so the budget is what sets the
+    // sample rate.
+    Status = ranger_apply_profile(pMyDevice, profiles_selected());
     if(Status != VL53L0X_ERROR_NONE) {
-        print_pal_error("VL53L0X_SetMeasurementTimingBudgetMicroSeconds", Status);
         return NULL;
     }
-    
+
+    init_int_gpio();
     return pMyDevice;
 }
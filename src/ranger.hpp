@@ -1,5 +1,47 @@
 #include "vl53l0x_api.h"
+#include "profiles.hpp"
 
 VL53L0X_Error ranger_measure(VL53L0X_Dev_t *, VL53L0X_RangingMeasurementData_t *);
 
-VL53L0X_Dev_t * ranger_init();
\ No newline at end of file
+// Puts the sensor in continuous ranging and arms the GPIO1 data-ready
+// interrupt. Must be called from the task which will wait for samples.
+// inter_measurement_ms of 0 means back-to-back ranging.
+VL53L0X_Error ranger_start_continuous(VL53L0X_Dev_t *, uint32_t inter_measurement_ms);
+
+// Blocks until the next continuous sample is ready and reads it.
+VL53L0X_Error ranger_wait_measurement(VL53L0X_Dev_t *, VL53L0X_RangingMeasurementData_t *);
+
+// Puts the sensor in timed ranging with GPIO1 only interrupting for ranges
+// below low_mm or above high_mm, so in between the sensor ranges on its own
+// and the waiting task sleeps. inter_measurement_ms must be non-zero. Must be
+// called from the task which will call ranger_wait_window.
+VL53L0X_Error ranger_start_window(VL53L0X_Dev_t *, uint16_t low_mm, uint16_t high_mm, uint32_t inter_measurement_ms);
+
+// Blocks until a range falls outside the window or timeout_ms passes, and
+// reads the latest range either way; *crossed says which it was. A timeout
+// is not an error.
+VL53L0X_Error ranger_wait_window(VL53L0X_Dev_t *, VL53L0X_RangingMeasurementData_t *, uint32_t timeout_ms, bool *crossed);
+
+// Stops continuous ranging and waits for the measurement in flight to finish.
+VL53L0X_Error ranger_stop(VL53L0X_Dev_t *);
+
+// Moves the device to the given profile, writing only the settings which
+// differ from what it's running now. Ranging must be stopped.
+VL53L0X_Error ranger_apply_profile(VL53L0X_Dev_t *, const ranger_profile *);
+
+// The settings last applied to the device, or NULL before the first profile.
+const ranger_profile * ranger_applied_profile(void);
+
+// Runs the reference calibration, and offset/crosstalk calibration against a
+// target at the given distance when it's non-zero, then saves the results for
+// this part. Ranging must be stopped. temperature_c may be NAN.
+VL53L0X_Error ranger_calibrate(VL53L0X_Dev_t *, float temperature_c, uint16_t offset_target_mm, uint16_t xtalk_target_mm);
+
+// Whether the temperature has moved far enough from the last reference
+// calibration to redo it.
+bool ranger_calibration_stale(float temperature_c);
+
+// Initializes the sensor with the profile from profiles_selected(). The
+// saved calibration for this part is restored rather than re-measured unless
+// temperature_c (NAN if unknown) says it's stale.
+VL53L0X_Dev_t * ranger_init(float temperature_c);
\ No newline at end of file
@@ -0,0 +1,219 @@
+#include "remote_write.hpp"
+
+#ifdef REMOTE_WRITE_URL
+#include "remote_write_codec.h"
+#include "series.hpp"
+#include "metrics.hpp"
+#include "board.hpp"
+
+#include <atomic>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/time.h>
+#include <esp_http_client.h>
+#include <esp_log.h>
+#include <esp_netif_sntp.h>
+#include <esp_timer.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#ifdef CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+#include <esp_crt_bundle.h>
+#endif
+
+static const char *TAG = "remote_write";
+
+// Indexed as in sample_get.
+static const char *const series_names[] = {
+    "ranger_sample_range_mm",
+    "ranger_sample_signal_rate_mcps",
+    "ranger_sample_ambient_rate_mcps",
+    "ranger_sample_sigma_mm",
+    "ranger_sample_range_status",
+};
+#define SERIES_COUNT (sizeof(series_names) / sizeof(series_names[0]))
+
+// Upper bounds on the encoded size: a Sample with its framing, and a
+// TimeSeries' own framing plus its two labels.
+#define SAMPLE_BYTES 22
+#define SERIES_BYTES (3 + 2 * 14 + 32 + sizeof(HOSTNAME))
+#define PROTOBUF_BYTES (SERIES_COUNT * (SERIES_BYTES + REMOTE_WRITE_BATCH_SAMPLES * SAMPLE_BYTES))
+
+// Remote write task only, apart from the atomics the collector reads.
+static sample_codec_sample batch[REMOTE_WRITE_BATCH_SAMPLES];
+static uint8_t *protobuf;
+static uint8_t *compressed;
+static uint16_t snappy_table[REMOTE_WRITE_SNAPPY_TABLE_SIZE];
+static esp_http_client_handle_t client;
+static uint32_t cursor = 0; // last raw seq sent or given up on
+
+static std::atomic<uint32_t> sent(0);
+static std::atomic<uint32_t> overwritten(0);
+static std::atomic<uint32_t> rejected(0);
+static std::atomic<uint32_t> failures(0);
+static std::atomic<uint32_t> backoff_ms(0);
+static std::atomic<uint32_t> sent_seq(0);
+
+// Maps the raw samples' ms-since-boot clock onto Unix time.
+typedef struct {
+    int64_t unix_ms;
+    uint32_t boot_ms;
+    size_t count;
+} batch_clock;
+
+static bool sample_get(void *ctx, size_t series, size_t index, remote_write_sample *out) {
+    const batch_clock *clock = (const batch_clock *)ctx;
+    const sample_codec_sample *s = &batch[index];
+
+    if (series == 0 && s->rejected) {
+        // Like ranger_range_mm, range only counts when quality_check accepted it.
+        return false;
+    }
+    out->timestamp_ms = clock->unix_ms - (uint32_t)(clock->boot_ms - s->time_ms);
+    switch (series) {
+    case 0: out->value = s->range_mm; break;
+    case 1: out->value = s->signal_rate / 256.0; break;
+    case 2: out->value = s->ambient_rate / 256.0; break;
+    case 3: out->value = s->sigma / 64.0; break;
+    default: out->value = s->range_status; break;
+    }
+    return true;
+}
+
+static bool clock_set(void) {
+    // Anything before this firmware existed means SNTP hasn't answered yet.
+    return time(NULL) > 1700000000;
+}
+
+// Returns the HTTP status, or -1 if the request never got an answer.
+static int post(const uint8_t *body, size_t len) {
+    esp_http_client_set_post_field(client, (const char *)body, len);
+    esp_err_t err = esp_http_client_perform(client);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "push failed: %s", esp_err_to_name(err));
+        return -1;
+    }
+    return esp_http_client_get_status_code(client);
+}
+
+// Sends up to a batch of pending samples. Returns how many went, or -1 if
+// they should be retried later.
+static int push(void) {
+    uint32_t next = cursor;
+    batch_clock clock;
+    struct timeval tv;
+
+    clock.count = 0;
+    while (clock.count < REMOTE_WRITE_BATCH_SAMPLES && series_next_raw(&next, &batch[clock.count])) {
+        clock.count++;
+    }
+    if (!clock.count) {
+        return 0;
+    }
+    if (batch[0].seq != cursor + 1) {
+        // Fell out of the series ring while we couldn't send.
+        overwritten.fetch_add(batch[0].seq - cursor - 1, std::memory_order_relaxed);
+    }
+
+    gettimeofday(&tv, NULL);
+    clock.unix_ms = (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+    clock.boot_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    size_t len = remote_write_encode(series_names, SERIES_COUNT, clock.count, HOSTNAME, sample_get, &clock,
+        protobuf, PROTOBUF_BYTES);
+    if (!len) {
+        ESP_LOGE(TAG, "batch didn't fit; SAMPLE_BYTES or SERIES_BYTES is too small");
+        return -1;
+    }
+    len = remote_write_snappy(protobuf, len, compressed, snappy_table);
+
+    int status = post(compressed, len);
+    if (status >= 200 && status < 300) {
+        sent.fetch_add(clock.count, std::memory_order_relaxed);
+    } else if (status >= 400 && status < 500 && status != 429) {
+        // The receiver won't take it however often we ask.
+        ESP_LOGW(TAG, "receiver rejected %u samples with %d", (unsigned)clock.count, status);
+        rejected.fetch_add(clock.count, std::memory_order_relaxed);
+    } else {
+        if (status > 0) {
+            ESP_LOGW(TAG, "receiver answered %d; will retry", status);
+        }
+        return -1;
+    }
+    cursor = next;
+    sent_seq.store(cursor, std::memory_order_relaxed);
+    return clock.count;
+}
+
+static void remote_write_task(void *arg) {
+    // SNTP and the HTTP client both need the network up.
+    while (!board_get_stats().wifi_connected) {
+        vTaskDelay(pdMS_TO_TICKS(1000));
+    }
+    esp_sntp_config_t sntp_config = ESP_NETIF_SNTP_DEFAULT_CONFIG(REMOTE_WRITE_NTP_SERVER);
+    esp_netif_sntp_init(&sntp_config);
+
+    esp_http_client_config_t config = {};
+    config.url = REMOTE_WRITE_URL;
+    config.method = HTTP_METHOD_POST;
+    config.timeout_ms = REMOTE_WRITE_TIMEOUT_MS;
+#ifdef CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+    config.crt_bundle_attach = esp_crt_bundle_attach;
+#endif
+    client = esp_http_client_init(&config);
+    esp_http_client_set_header(client, "Content-Type", "application/x-protobuf");
+    esp_http_client_set_header(client, "Content-Encoding", "snappy");
+    esp_http_client_set_header(client, "X-Prometheus-Remote-Write-Version", "0.1.0");
+
+    uint32_t delay_ms = REMOTE_WRITE_INTERVAL_MS;
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(delay_ms));
+        if (!clock_set()) {
+            // Samples keep in the series ring meanwhile.
+            continue;
+        }
+        // Catch up on any backlog before waiting again.
+        int n;
+        while ((n = push()) == REMOTE_WRITE_BATCH_SAMPLES) {
+        }
+        if (n < 0) {
+            failures.fetch_add(1, std::memory_order_relaxed);
+            delay_ms = delay_ms * 2 > REMOTE_WRITE_BACKOFF_MAX_MS ? REMOTE_WRITE_BACKOFF_MAX_MS : delay_ms * 2;
+        } else {
+            delay_ms = REMOTE_WRITE_INTERVAL_MS;
+        }
+        backoff_ms.store(delay_ms == REMOTE_WRITE_INTERVAL_MS ? 0 : delay_ms, std::memory_order_relaxed);
+    }
+}
+
+static void collect_remote_write(metrics_writer *w) {
+    metrics_write_family(w, "remote_write_samples_sent", "Total number of samples pushed with remote_write.", "counter");
+    metrics_write_sample(w, "remote_write_samples_sent", NULL, double(sent.load(std::memory_order_relaxed)));
+    metrics_write_family(w, "remote_write_samples_dropped", "Total number of samples never pushed, by why.", "counter");
+    metrics_write_sample(w, "remote_write_samples_dropped", "reason=\"overwritten\"", double(overwritten.load(std::memory_order_relaxed)));
+    metrics_write_sample(w, "remote_write_samples_dropped", "reason=\"rejected\"", double(rejected.load(std::memory_order_relaxed)));
+    metrics_write_family(w, "remote_write_pending_samples", "Samples taken but not yet pushed.", "gauge");
+    metrics_write_sample(w, "remote_write_pending_samples", NULL,
+        double(series_raw_count() - sent_seq.load(std::memory_order_relaxed)));
+    metrics_write_family(w, "remote_write_failures", "Total number of pushes that will be retried.", "counter");
+    metrics_write_sample(w, "remote_write_failures", NULL, double(failures.load(std::memory_order_relaxed)));
+    metrics_write_family(w, "remote_write_backoff_seconds", "Delay before the next retry; 0 while pushes succeed.", "gauge");
+    metrics_write_sample(w, "remote_write_backoff_seconds", NULL, double(backoff_ms.load(std::memory_order_relaxed)) / 1e3);
+}
+
+void remote_write_start(void) {
+    protobuf = (uint8_t *)malloc(PROTOBUF_BYTES);
+    compressed = (uint8_t *)malloc(remote_write_snappy_bound(PROTOBUF_BYTES));
+    if (!protobuf || !compressed) {
+        ESP_LOGE(TAG, "no room for %u byte batches; lower REMOTE_WRITE_BATCH_SAMPLES", (unsigned)PROTOBUF_BYTES);
+        free(protobuf);
+        free(compressed);
+        return;
+    }
+    metrics_add_collector(collect_remote_write);
+    // esp_http_client, and mbedtls for https URLs, want a deep stack.
+    xTaskCreate(remote_write_task, "remote_write", 8192, NULL, 1, NULL);
+}
+#else
+void remote_write_start(void) {
+    // Push mode is off; /metrics is scraped as usual.
+}
+#endif
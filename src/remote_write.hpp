@@ -0,0 +1,40 @@
+#pragma once
+
+#include "const.hpp"
+
+// Define REMOTE_WRITE_URL in const.hpp (e.g.
+// "http://prometheus.lan:9090/api/v1/write") to also push every sample with
+// the Prometheus remote_write protocol, for when nothing can reach the device
+// to scrape it or the scrape interval is too coarse. Samples wait in the
+// /api/series raw ring until they're sent, so SERIES_RAW_SIZE is what caps the
+// backlog; anything older is dropped and counted. Timestamps need wall-clock
+// time, which comes from SNTP.
+
+#ifndef REMOTE_WRITE_NTP_SERVER
+#define REMOTE_WRITE_NTP_SERVER "pool.ntp.org"
+#endif
+
+// How often whatever has accumulated is pushed.
+#ifndef REMOTE_WRITE_INTERVAL_MS
+#define REMOTE_WRITE_INTERVAL_MS 5000
+#endif
+
+// Most samples per request. A backlog goes out as back-to-back requests of
+// this size. The request is built in buffers taken from the heap once, about
+// 240 bytes per sample.
+#ifndef REMOTE_WRITE_BATCH_SAMPLES
+#define REMOTE_WRITE_BATCH_SAMPLES 150
+#endif
+
+// Failed pushes are retried after REMOTE_WRITE_INTERVAL_MS, doubling up to this.
+#ifndef REMOTE_WRITE_BACKOFF_MAX_MS
+#define REMOTE_WRITE_BACKOFF_MAX_MS 60000
+#endif
+
+#ifndef REMOTE_WRITE_TIMEOUT_MS
+#define REMOTE_WRITE_TIMEOUT_MS 5000
+#endif
+
+// Starts pushing if REMOTE_WRITE_URL is set, and registers its /metrics
+// collector. Call before metrics_start.
+void remote_write_start(void);
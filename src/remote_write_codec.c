@@ -0,0 +1,230 @@
+#include "remote_write_codec.h"
+
+#include <string.h>
+
+// Protobuf output. With buf NULL nothing is written and len just counts, which
+// is how each nested message learns its length before it's written.
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+    size_t cap;
+} pb_out;
+
+#define WIRE_VARINT  0
+#define WIRE_FIXED64 1
+#define WIRE_BYTES   2
+
+static void put(pb_out *o, const void *data, size_t len)
+{
+    if (o->buf && o->len + len <= o->cap) {
+        memcpy(o->buf + o->len, data, len);
+    }
+    o->len += len;
+}
+
+static void put_varint(pb_out *o, uint64_t value)
+{
+    uint8_t bytes[10];
+    size_t n = 0;
+
+    while (value >= 0x80) {
+        bytes[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    bytes[n++] = (uint8_t)value;
+    put(o, bytes, n);
+}
+
+static void put_tag(pb_out *o, uint32_t field, uint32_t wire)
+{
+    put_varint(o, (field << 3) | wire);
+}
+
+static void put_string(pb_out *o, uint32_t field, const char *s)
+{
+    size_t len = strlen(s);
+
+    put_tag(o, field, WIRE_BYTES);
+    put_varint(o, len);
+    put(o, s, len);
+}
+
+static void put_label(pb_out *o, const char *name, const char *value)
+{
+    pb_out measure = { NULL, 0, 0 };
+
+    put_string(&measure, 1, name);
+    put_string(&measure, 2, value);
+    put_tag(o, 1, WIRE_BYTES);
+    put_varint(o, measure.len);
+    put_string(o, 1, name);
+    put_string(o, 2, value);
+}
+
+static void put_sample(pb_out *o, const remote_write_sample *s)
+{
+    // Both ends are little-endian, as protobuf's fixed64 is.
+    pb_out measure = { NULL, 0, 0 };
+
+    put_tag(&measure, 1, WIRE_FIXED64);
+    put(&measure, &s->value, sizeof(s->value));
+    put_tag(&measure, 2, WIRE_VARINT);
+    put_varint(&measure, (uint64_t)s->timestamp_ms);
+
+    put_tag(o, 2, WIRE_BYTES);
+    put_varint(o, measure.len);
+    put_tag(o, 1, WIRE_FIXED64);
+    put(o, &s->value, sizeof(s->value));
+    put_tag(o, 2, WIRE_VARINT);
+    put_varint(o, (uint64_t)s->timestamp_ms);
+}
+
+// The TimeSeries body; returns how many samples went in.
+static size_t put_series_body(pb_out *o, const char *name, const char *hostname, size_t series,
+    size_t sample_count, remote_write_sample_fn get, void *ctx)
+{
+    remote_write_sample s;
+    size_t n = 0;
+
+    // Labels sorted by name, as Prometheus expects.
+    put_label(o, "__name__", name);
+    put_label(o, "hostname", hostname);
+    for (size_t i = 0; i < sample_count; i++) {
+        if (get(ctx, series, i, &s)) {
+            put_sample(o, &s);
+            n++;
+        }
+    }
+    return n;
+}
+
+size_t remote_write_encode(const char *const *names, size_t series_count, size_t sample_count,
+    const char *hostname, remote_write_sample_fn get, void *ctx, uint8_t *out, size_t cap)
+{
+    pb_out o = { out, 0, cap };
+
+    for (size_t i = 0; i < series_count; i++) {
+        pb_out measure = { NULL, 0, 0 };
+        if (!put_series_body(&measure, names[i], hostname, i, sample_count, get, ctx)) {
+            continue;
+        }
+        put_tag(&o, 1, WIRE_BYTES);
+        put_varint(&o, measure.len);
+        put_series_body(&o, names[i], hostname, i, sample_count, get, ctx);
+    }
+    return out && o.len > cap ? 0 : o.len;
+}
+
+// Snappy's block format: the uncompressed length as a varint, then literals
+// and back-references. This is a plain greedy matcher over 4-byte hashes; it
+// gets most of what the reference compressor does on repetitive protobuf.
+
+#define SNAPPY_BLOCK_SIZE 65536 // copies never reach further back than this
+#define SNAPPY_HASH_SHIFT 22    // 32 - log2(REMOTE_WRITE_SNAPPY_TABLE_SIZE)
+
+size_t remote_write_snappy_bound(size_t len)
+{
+    return 32 + len + len / 6;
+}
+
+static uint32_t load32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static size_t emit_literal(uint8_t *out, const uint8_t *data, size_t len)
+{
+    size_t n = 0, m = len - 1;
+
+    if (m < 60) {
+        out[n++] = (uint8_t)(m << 2);
+    } else if (m < 256) {
+        out[n++] = 60 << 2;
+        out[n++] = (uint8_t)m;
+    } else {
+        out[n++] = 61 << 2;
+        out[n++] = (uint8_t)m;
+        out[n++] = (uint8_t)(m >> 8);
+    }
+    memcpy(out + n, data, len);
+    return n + len;
+}
+
+static size_t emit_copy_upto_64(uint8_t *out, size_t offset, size_t len)
+{
+    if (len < 12 && offset < 2048) {
+        out[0] = (uint8_t)(1 | ((len - 4) << 2) | ((offset >> 8) << 5));
+        out[1] = (uint8_t)offset;
+        return 2;
+    }
+    out[0] = (uint8_t)(2 | ((len - 1) << 2));
+    out[1] = (uint8_t)offset;
+    out[2] = (uint8_t)(offset >> 8);
+    return 3;
+}
+
+static size_t emit_copy(uint8_t *out, size_t offset, size_t len)
+{
+    size_t n = 0;
+
+    // Keep every piece at least 4 long so the short form stays available.
+    while (len >= 68) {
+        n += emit_copy_upto_64(out + n, offset, 64);
+        len -= 64;
+    }
+    if (len > 64) {
+        n += emit_copy_upto_64(out + n, offset, 60);
+        len -= 60;
+    }
+    return n + emit_copy_upto_64(out + n, offset, len);
+}
+
+static size_t compress_block(const uint8_t *in, size_t len, uint8_t *out, uint16_t *table)
+{
+    size_t n = 0, ip = 0, literal = 0;
+
+    memset(table, 0, REMOTE_WRITE_SNAPPY_TABLE_SIZE * sizeof(*table));
+    while (ip + 4 <= len) {
+        uint32_t word = load32(in + ip);
+        uint32_t hash = (word * 0x1E35A7BDu) >> SNAPPY_HASH_SHIFT;
+        size_t candidate = table[hash];
+
+        table[hash] = (uint16_t)ip;
+        if (candidate >= ip || load32(in + candidate) != word) {
+            ip++;
+            continue;
+        }
+        size_t match = 4;
+        while (ip + match < len && in[candidate + match] == in[ip + match]) {
+            match++;
+        }
+        if (literal < ip) {
+            n += emit_literal(out + n, in + literal, ip - literal);
+        }
+        n += emit_copy(out + n, ip - candidate, match);
+        ip += match;
+        literal = ip;
+    }
+    if (literal < len) {
+        n += emit_literal(out + n, in + literal, len - literal);
+    }
+    return n;
+}
+
+size_t remote_write_snappy(const uint8_t *in, size_t len, uint8_t *out, uint16_t table[REMOTE_WRITE_SNAPPY_TABLE_SIZE])
+{
+    size_t n = 0, value = len;
+
+    while (value >= 0x80) {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    for (size_t start = 0; start < len; start += SNAPPY_BLOCK_SIZE) {
+        size_t block = len - start < SNAPPY_BLOCK_SIZE ? len - start : SNAPPY_BLOCK_SIZE;
+        n += compress_block(in + start, block, out + n, table);
+    }
+    return n;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+// Body of a Prometheus remote_write request: a WriteRequest protobuf,
+// snappy-compressed in the block format. Plain C so the host stand-in
+// receiver (host/remote_write_receiver.c) checks the same code the firmware
+// runs. Only the fields the device sends are supported:
+//
+//   WriteRequest { repeated TimeSeries timeseries = 1; }
+//   TimeSeries   { repeated Label labels = 1; repeated Sample samples = 2; }
+//   Label        { string name = 1; string value = 2; }
+//   Sample       { double value = 1; int64 timestamp = 2; }
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    double value;
+    int64_t timestamp_ms; // Unix time
+} remote_write_sample;
+
+// Fills in sample index of series, or returns false to leave it out. Called
+// more than once per sample, so it should be cheap and give the same answer.
+typedef bool (*remote_write_sample_fn)(void *ctx, size_t series, size_t index, remote_write_sample *out);
+
+// Encodes a WriteRequest with one TimeSeries per name, labelled with the name
+// and hostname, holding whichever of samples 0..sample_count-1 get provides.
+// Series left with no samples are omitted. Returns the size, which is all
+// that's worked out when out is NULL, or 0 if that's more than cap.
+size_t remote_write_encode(const char *const *names, size_t series_count, size_t sample_count,
+    const char *hostname, remote_write_sample_fn get, void *ctx, uint8_t *out, size_t cap);
+
+// Entries in the hash table remote_write_snappy works with.
+#define REMOTE_WRITE_SNAPPY_TABLE_SIZE 1024
+
+// Most bytes remote_write_snappy can produce from len.
+size_t remote_write_snappy_bound(size_t len);
+
+// Compresses in to out, which needs remote_write_snappy_bound(len) bytes, and
+// returns the compressed size. table is scratch space.
+size_t remote_write_snappy(const uint8_t *in, size_t len, uint8_t *out, uint16_t table[REMOTE_WRITE_SNAPPY_TABLE_SIZE]);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,104 @@
+#include "sample_codec.h"
+
+#include <string.h>
+
+// Up to 35 bits, which covers everything here.
+static size_t put_varint(uint8_t *out, uint64_t value)
+{
+    size_t n = 0;
+
+    while (value >= 0x80) {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+// Returns the bytes consumed, or 0 if in ends first or the varint is too long.
+static size_t get_varint(const uint8_t *in, size_t len, uint64_t *value)
+{
+    uint64_t result = 0;
+
+    for (size_t n = 0; n < len && n < 5; n++) {
+        result |= (uint64_t)(in[n] & 0x7F) << (7 * n);
+        if (!(in[n] & 0x80)) {
+            *value = result;
+            return n + 1;
+        }
+    }
+    return 0;
+}
+
+static uint32_t zigzag(int32_t value)
+{
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t unzigzag(uint32_t value)
+{
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+void sample_codec_start(sample_codec_state *state, uint32_t since)
+{
+    memset(state, 0, sizeof(*state));
+    state->last.seq = since;
+}
+
+size_t sample_codec_encode(sample_codec_state *state, const sample_codec_sample *sample, uint8_t *out)
+{
+    sample_codec_sample *last = &state->last;
+    int32_t delta_ms = (int32_t)(sample->time_ms - last->time_ms);
+    size_t n = 0;
+
+    // A 32-bit skip with the rejected bit below it still fits five bytes.
+    n += put_varint(out + n, ((uint64_t)(sample->seq - last->seq - 1) << 1) | (sample->rejected ? 1 : 0));
+    n += put_varint(out + n, zigzag((int32_t)((uint32_t)delta_ms - (uint32_t)state->delta_ms)));
+    out[n++] = sample->range_status ^ last->range_status;
+    n += put_varint(out + n, zigzag((int32_t)sample->range_mm - last->range_mm));
+    n += put_varint(out + n, zigzag((int32_t)sample->signal_rate - last->signal_rate));
+    n += put_varint(out + n, zigzag((int32_t)sample->ambient_rate - last->ambient_rate));
+    n += put_varint(out + n, zigzag((int32_t)sample->sigma - last->sigma));
+
+    state->delta_ms = delta_ms;
+    *last = *sample;
+    return n;
+}
+
+size_t sample_codec_decode(sample_codec_state *state, const uint8_t *in, size_t len, sample_codec_sample *out)
+{
+    const sample_codec_sample *last = &state->last;
+    uint64_t fields[7];
+    size_t n = 0, used;
+
+    for (int i = 0; i < 7; i++) {
+        if (i == 2) {
+            // The status is a plain byte.
+            if (n == len) {
+                return 0;
+            }
+            fields[i] = in[n++];
+            continue;
+        }
+        used = get_varint(in + n, len - n, &fields[i]);
+        if (!used) {
+            return 0;
+        }
+        n += used;
+    }
+
+    int32_t delta_ms = (int32_t)((uint32_t)state->delta_ms + (uint32_t)unzigzag((uint32_t)fields[1]));
+    out->seq = last->seq + (uint32_t)(fields[0] >> 1) + 1;
+    out->rejected = fields[0] & 1;
+    out->time_ms = last->time_ms + (uint32_t)delta_ms;
+    out->range_status = (uint8_t)(last->range_status ^ fields[2]);
+    out->range_mm = (uint16_t)(last->range_mm + unzigzag((uint32_t)fields[3]));
+    out->signal_rate = (uint16_t)(last->signal_rate + unzigzag((uint32_t)fields[4]));
+    out->ambient_rate = (uint16_t)(last->ambient_rate + unzigzag((uint32_t)fields[5]));
+    out->sigma = (uint16_t)(last->sigma + unzigzag((uint32_t)fields[6]));
+
+    state->delta_ms = delta_ms;
+    state->last = *out;
+    return n;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+// Compact binary encoding of sample history for /api/export. Plain C so the
+// host decoder (host/export_decode.c) runs the same code as the firmware.
+//
+// An export is a sample_codec_header followed by encoded samples up to the end
+// of the body. Each sample is coded against the one before it:
+//
+//   varint         (seq - previous seq - 1) << 1 (0 unless samples were
+//                  skipped), plus 1 if quality_check rejected the sample
+//   zigzag varint  time delta - previous time delta, in ms
+//   byte           range status XOR previous range status
+//   zigzag varint  change in range, signal, ambient and sigma, in that order
+//
+// The first sample is coded against seq = header.since and everything else
+// zero. Varints are little-endian base 128. A steady 30 Hz stream costs about
+// eight bytes a sample.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SAMPLE_CODEC_VERSION 3
+
+// Most bytes one encoded sample can take.
+#define SAMPLE_CODEC_MAX_SAMPLE 23
+
+// Values are in the units /api/series stores.
+typedef struct {
+    uint32_t seq;
+    uint32_t time_ms;       // low 32 bits of ms since boot
+    uint16_t range_mm;
+    uint16_t signal_rate;   // 8.8 Mcps
+    uint16_t ambient_rate;  // 8.8 Mcps
+    uint16_t sigma;         // 10.6 mm
+    uint8_t range_status;
+    uint8_t rejected;       // 1 if quality_check rejected the sample, else 0
+} sample_codec_sample;
+
+// Little-endian, like the rest of the export.
+typedef struct {
+    char magic[4];          // "RSMP"
+    uint8_t version;        // SAMPLE_CODEC_VERSION
+    uint8_t header_size;    // sizeof(sample_codec_header); skip whatever follows what you know
+    uint8_t reserved[2];
+    uint32_t now_ms;        // time_ms clock at export, to age the samples
+    uint32_t since;         // seq the first sample is coded against
+    uint32_t next_since;    // since for the next export, to pick up where this one ends
+} sample_codec_header;
+
+// The previous sample, which the next one is coded against.
+typedef struct {
+    sample_codec_sample last;
+    int32_t delta_ms;
+} sample_codec_state;
+
+void sample_codec_start(sample_codec_state *state, uint32_t since);
+
+// Writes one sample to out, which must have room for SAMPLE_CODEC_MAX_SAMPLE
+// bytes, and returns the bytes written.
+size_t sample_codec_encode(sample_codec_state *state, const sample_codec_sample *sample, uint8_t *out);
+
+// Reads one sample from in and returns the bytes consumed, or 0 if in ends
+// partway through a sample.
+size_t sample_codec_decode(sample_codec_state *state, const uint8_t *in, size_t len, sample_codec_sample *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,98 @@
+#include "samples.hpp"
+
+#include <atomic>
+#include <string.h>
+#include <esp_timer.h>
+
+#include "vl53l0x_platform.h"
+
+// Single producer, many consumers. Each slot is guarded by its own sequence
+// number which doubles as a seqlock: the writer zeroes it, fills the payload
+// and then publishes the new seq. Readers retry or skip if the seq changed
+// underneath them, so neither side ever blocks.
+typedef struct {
+    std::atomic<uint32_t> seq;
+    range_sample sample;
+} sample_slot;
+
+static sample_slot ring[SAMPLES_RING_SIZE];
+static std::atomic<uint32_t> head_seq(0);
+
+// Producer-only state.
+static uint32_t last_transaction_count = 0;
+
+static_assert((SAMPLES_RING_SIZE & (SAMPLES_RING_SIZE - 1)) == 0, "SAMPLES_RING_SIZE must be a power of two");
+
+void samples_publish(const burst_result *sample, uint16_t filtered_range_mm) {
+    const VL53L0X_RangingMeasurementData_t *measurement = &sample->measurement;
+    uint32_t seq = head_seq.load(std::memory_order_relaxed) + 1;
+    uint32_t transaction_count = VL53L0X_get_transaction_count();
+    sample_slot *slot = &ring[seq & (SAMPLES_RING_SIZE - 1)];
+
+    slot->seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot->sample.timestamp_us = esp_timer_get_time();
+    slot->sample.seq = seq;
+    slot->sample.signal_rate_mcps = measurement->SignalRateRtnMegaCps;
+    slot->sample.ambient_rate_mcps = measurement->AmbientRateRtnMegaCps;
+    slot->sample.sigma_mm = sample->sigma_mm;
+    slot->sample.spread_mm = sample->spread_mm;
+    slot->sample.range_mm = measurement->RangeMilliMeter;
+    slot->sample.filtered_range_mm = filtered_range_mm;
+    slot->sample.effective_spad_rtn_count = measurement->EffectiveSpadRtnCount;
+    slot->sample.range_status = measurement->RangeStatus;
+    slot->sample.quality = sample->quality;
+    slot->sample.i2c_transactions = transaction_count - last_transaction_count;
+    last_transaction_count = transaction_count;
+
+    slot->seq.store(seq, std::memory_order_release);
+    head_seq.store(seq, std::memory_order_release);
+}
+
+// Copies the sample with the given seq. Fails if the slot has moved on.
+static bool read_slot(uint32_t seq, range_sample *out) {
+    const sample_slot *slot = &ring[seq & (SAMPLES_RING_SIZE - 1)];
+    if (slot->seq.load(std::memory_order_acquire) != seq) {
+        return false;
+    }
+    memcpy(out, &slot->sample, sizeof(*out));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot->seq.load(std::memory_order_relaxed) == seq;
+}
+
+bool samples_latest(range_sample *out) {
+    while (1) {
+        uint32_t seq = head_seq.load(std::memory_order_acquire);
+        if (seq == 0) {
+            return false;
+        }
+        if (read_slot(seq, out)) {
+            return true;
+        }
+        // The producer lapped us mid-copy; the new head is what we want anyway.
+    }
+}
+
+bool samples_next(uint32_t *cursor, range_sample *out) {
+    while (1) {
+        uint32_t head = head_seq.load(std::memory_order_acquire);
+        if (*cursor > head) {
+            // Cursor from some other boot; start over.
+            *cursor = 0;
+        }
+        if (head == *cursor) {
+            return false;
+        }
+        uint32_t seq = *cursor + 1;
+        // Skip whatever has already been overwritten, leaving one slot of
+        // slack for the sample being written right now.
+        if (head - seq >= SAMPLES_RING_SIZE - 1) {
+            seq = head - (SAMPLES_RING_SIZE - 2);
+        }
+        if (read_slot(seq, out)) {
+            *cursor = seq;
+            return true;
+        }
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include "vl53l0x_api.h"
+#include "burst.hpp"
+
+// Number of samples retained; must be a power of two. ~4s at 30Hz.
+#define SAMPLES_RING_SIZE 128
+
+// Compact copy of a VL53L0X_RangingMeasurementData_t plus the bits the
+// consumers need to order and age it.
+typedef struct {
+    int64_t timestamp_us;              // esp_timer_get_time() when the sample was read
+    uint32_t seq;                      // starts at 1; 0 means "no sample"
+    FixPoint1616_t signal_rate_mcps;   // SignalRateRtnMegaCps
+    FixPoint1616_t ambient_rate_mcps;  // AmbientRateRtnMegaCps
+    FixPoint1616_t sigma_mm;           // sigma estimate computed for this sample
+    FixPoint1616_t spread_mm;          // burst_result.spread_mm; 0 for single measurements
+    uint16_t range_mm;                 // RangeMilliMeter
+    uint16_t filtered_range_mm;        // range_mm after filter_update
+    uint16_t effective_spad_rtn_count; // EffectiveSpadRtnCount, 8.8 fixed point
+    uint8_t range_status;              // RangeStatus
+    uint8_t quality;                   // quality_reason; QUALITY_OK if accepted
+    uint16_t i2c_transactions;         // bus transactions since the previous sample
+} range_sample;
+
+// Publishes a new sample. Only the sensor task may call this.
+void samples_publish(const burst_result *sample, uint16_t filtered_range_mm);
+
+// Copies the most recent sample. Returns false if nothing has been published yet.
+bool samples_latest(range_sample *out);
+
+// Copies the oldest retained sample newer than *cursor and advances *cursor to
+// it. Start with *cursor = 0. Returns false when the reader is caught up. If the
+// reader fell behind and samples were overwritten, the gap is visible as a jump
+// in seq.
+bool samples_next(uint32_t *cursor, range_sample *out);
@@ -0,0 +1,514 @@
+#include "series.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include "freertos/FreeRTOS.h"
+
+static const char *TAG = "series";
+
+// Values are stored as 16 bits: range in mm, the rates in 8.8 Mcps and sigma
+// in 10.6 mm, all saturating. Indexed by series_metric.
+typedef struct {
+    const char *name;
+    uint8_t shift; // from the API's 16.16
+    double scale;  // back to the unit in the name
+} metric_info;
+
+static const metric_info metric_infos[] = {
+    { "range_mm",          0,  1.0 },
+    { "signal_rate_mcps",  8,  1.0 / 256 },
+    { "ambient_rate_mcps", 8,  1.0 / 256 },
+    { "sigma_mm",          10, 1.0 / 64 },
+};
+static_assert(sizeof(metric_infos) / sizeof(metric_infos[0]) == SERIES_METRIC_COUNT, "metric_infos out of step with series_metric");
+
+typedef struct {
+    uint32_t time_ms; // low 32 bits
+    uint16_t values[SERIES_METRIC_COUNT];
+    uint8_t range_status;
+    uint8_t rejected; // by quality_check
+    uint8_t reserved[2];
+} raw_record;
+
+// One interval of a tier. Range only covers the accepted samples, which valid
+// counts.
+typedef struct {
+    uint32_t interval; // time since boot / interval length
+    uint32_t count;
+    uint32_t valid;
+    uint16_t min[SERIES_METRIC_COUNT];
+    uint16_t max[SERIES_METRIC_COUNT];
+    uint16_t mean[SERIES_METRIC_COUNT];
+} tier_record;
+
+// The interval still being filled. Sensor task only.
+typedef struct {
+    uint32_t interval;
+    uint32_t count;
+    uint32_t valid;
+    uint16_t min[SERIES_METRIC_COUNT];
+    uint16_t max[SERIES_METRIC_COUNT];
+    uint64_t sum[SERIES_METRIC_COUNT];
+} accumulator;
+
+typedef struct {
+    uint32_t interval_ms;
+    tier_record *ring;
+    uint32_t size;
+    uint32_t head; // records written
+    accumulator acc;
+} tier;
+
+static_assert(sizeof(raw_record) == 16, "raw_record grew; update SERIES_RAW_SIZE's cost");
+static_assert(sizeof(tier_record) == 36, "tier_record grew; update SERIES_SECONDS_SIZE's cost");
+
+// The sensor task appends and httpd reads, each under the lock for a single
+// record copy, as i2c_trace does. The rings come from series_init; until
+// then, or if there wasn't room, nothing is recorded and the heads stay 0.
+static raw_record *raw_ring;
+static uint32_t raw_head = 0; // records written
+static int64_t next_raw_ms;   // sensor task only
+static tier tiers[] = {
+    { 1000,    NULL, SERIES_SECONDS_SIZE, 0, {} },
+    { 60000,   NULL, SERIES_MINUTES_SIZE, 0, {} },
+    { 3600000, NULL, SERIES_HOURS_SIZE,   0, {} },
+};
+#define TIER_COUNT (sizeof(tiers) / sizeof(tiers[0]))
+static portMUX_TYPE ring_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void series_init(void) {
+    size_t bytes = SERIES_RAW_SIZE * sizeof(raw_record);
+    raw_record *raw = (raw_record *)malloc(bytes);
+    tier_record *rings[TIER_COUNT];
+    bool ok = raw != NULL;
+
+    for (size_t i = 0; i < TIER_COUNT; i++) {
+        bytes += tiers[i].size * sizeof(tier_record);
+        rings[i] = (tier_record *)malloc(tiers[i].size * sizeof(tier_record));
+        ok = ok && rings[i];
+    }
+    if (!ok) {
+        ESP_LOGE(TAG, "no room for %u bytes of history; lower the SERIES_*_SIZE", (unsigned)bytes);
+        free(raw);
+        for (size_t i = 0; i < TIER_COUNT; i++) {
+            free(rings[i]);
+        }
+        return;
+    }
+    for (size_t i = 0; i < TIER_COUNT; i++) {
+        tiers[i].ring = rings[i];
+    }
+    raw_ring = raw;
+    ESP_LOGI(TAG, "%u bytes of history", (unsigned)bytes);
+}
+
+bool series_find_metric(const char *name, series_metric *out) {
+    for (int i = 0; i < SERIES_METRIC_COUNT; i++) {
+        if (strcmp(metric_infos[i].name, name) == 0) {
+            *out = (series_metric)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint16_t encode(uint32_t value, uint8_t shift) {
+    value >>= shift;
+    return value > UINT16_MAX ? UINT16_MAX : (uint16_t)value;
+}
+
+static void commit(tier *t) {
+    accumulator *a = &t->acc;
+    tier_record record;
+
+    record.interval = a->interval;
+    record.count = a->count;
+    record.valid = a->valid;
+    for (int m = 0; m < SERIES_METRIC_COUNT; m++) {
+        uint32_t n = m == SERIES_RANGE_MM ? a->valid : a->count;
+        record.min[m] = n ? a->min[m] : 0;
+        record.max[m] = n ? a->max[m] : 0;
+        record.mean[m] = n ? (uint16_t)((a->sum[m] + n / 2) / n) : 0;
+    }
+
+    taskENTER_CRITICAL(&ring_lock);
+    t->ring[t->head % t->size] = record;
+    t->head++;
+    taskEXIT_CRITICAL(&ring_lock);
+}
+
+static void accumulate(tier *t, int64_t now_ms, const raw_record *r) {
+    accumulator *a = &t->acc;
+    uint32_t interval = (uint32_t)(now_ms / t->interval_ms);
+    bool valid = !r->rejected;
+
+    if (a->count && a->interval != interval) {
+        commit(t);
+        a->count = 0;
+    }
+    if (!a->count) {
+        memset(a, 0, sizeof(*a));
+        memset(a->min, 0xFF, sizeof(a->min));
+        a->interval = interval;
+    }
+    a->count++;
+    a->valid += valid;
+    for (int m = 0; m < SERIES_METRIC_COUNT; m++) {
+        if (m == SERIES_RANGE_MM && !valid) {
+            continue;
+        }
+        uint16_t v = r->values[m];
+        if (v < a->min[m]) {
+            a->min[m] = v;
+        }
+        if (v > a->max[m]) {
+            a->max[m] = v;
+        }
+        a->sum[m] += v;
+    }
+}
+
+void series_observe(const VL53L0X_RangingMeasurementData_t *measurement, FixPoint1616_t sigma_mm, bool accepted) {
+    int64_t now_ms = esp_timer_get_time() / 1000;
+    raw_record record = {
+        .time_ms = (uint32_t)now_ms,
+        .values = {
+            measurement->RangeMilliMeter,
+            encode(measurement->SignalRateRtnMegaCps, metric_infos[SERIES_SIGNAL_RATE_MCPS].shift),
+            encode(measurement->AmbientRateRtnMegaCps, metric_infos[SERIES_AMBIENT_RATE_MCPS].shift),
+            encode(sigma_mm, metric_infos[SERIES_SIGMA_MM].shift),
+        },
+        .range_status = measurement->RangeStatus,
+        .rejected = !accepted,
+        .reserved = {0, 0},
+    };
+
+    if (!raw_ring) {
+        return;
+    }
+    // One raw sample per interval on a fixed grid, so the ring spans at least
+    // SERIES_RAW_SIZE intervals whatever the sample rate.
+    if (now_ms >= next_raw_ms) {
+        next_raw_ms = (now_ms / SERIES_RAW_INTERVAL_MS + 1) * SERIES_RAW_INTERVAL_MS;
+        taskENTER_CRITICAL(&ring_lock);
+        raw_ring[raw_head % SERIES_RAW_SIZE] = record;
+        raw_head++;
+        taskEXIT_CRITICAL(&ring_lock);
+    }
+
+    for (size_t i = 0; i < TIER_COUNT; i++) {
+        accumulate(&tiers[i], now_ms, &record);
+    }
+}
+
+// Sources of history, finest first: the raw ring, then each tier.
+#define SOURCE_COUNT (TIER_COUNT + 1)
+
+static uint32_t source_period_ms(int source) {
+    return source == 0 ? 0 : tiers[source - 1].interval_ms;
+}
+
+// One record of a source, reduced to the metric being queried.
+typedef struct {
+    int64_t start_ms;
+    uint32_t count; // 0 if the record has nothing for this metric
+    uint16_t min;
+    uint16_t max;
+    uint16_t mean;
+} span;
+
+// The seqs a source still holds, as [*first, *end).
+static void source_bounds(int source, uint32_t *first, uint32_t *end) {
+    uint32_t size = source == 0 ? SERIES_RAW_SIZE : tiers[source - 1].size;
+
+    taskENTER_CRITICAL(&ring_lock);
+    *end = source == 0 ? raw_head : tiers[source - 1].head;
+    taskEXIT_CRITICAL(&ring_lock);
+    *first = *end > size ? *end - size : 0;
+}
+
+static bool raw_read(uint32_t seq, raw_record *out) {
+    bool found = false;
+
+    taskENTER_CRITICAL(&ring_lock);
+    if (raw_head - seq - 1 < SERIES_RAW_SIZE) {
+        *out = raw_ring[seq % SERIES_RAW_SIZE];
+        found = true;
+    }
+    taskEXIT_CRITICAL(&ring_lock);
+    return found;
+}
+
+// Returns false if seq has been overwritten since source_bounds.
+static bool source_read(int source, uint32_t seq, series_metric metric, int64_t now_ms, span *out) {
+    if (source == 0) {
+        raw_record record;
+        if (!raw_read(seq, &record)) {
+            return false;
+        }
+        out->start_ms = now_ms - (uint32_t)((uint32_t)now_ms - record.time_ms);
+        out->count = metric == SERIES_RANGE_MM && record.rejected ? 0 : 1;
+        out->min = out->max = out->mean = record.values[metric];
+        return true;
+    }
+
+    tier *t = &tiers[source - 1];
+    tier_record record;
+    bool found = false;
+
+    taskENTER_CRITICAL(&ring_lock);
+    if (t->head - seq - 1 < t->size) {
+        record = t->ring[seq % t->size];
+        found = true;
+    }
+    taskEXIT_CRITICAL(&ring_lock);
+    if (!found) {
+        return false;
+    }
+    out->start_ms = (int64_t)record.interval * t->interval_ms;
+    out->count = metric == SERIES_RANGE_MM ? record.valid : record.count;
+    out->min = record.min[metric];
+    out->max = record.max[metric];
+    out->mean = record.mean[metric];
+    return true;
+}
+
+// First seq in [lo, hi) that ends after from_ms.
+static uint32_t source_seek(int source, uint32_t lo, uint32_t hi, int64_t from_ms, int64_t now_ms) {
+    int64_t length_ms = source_period_ms(source) ? source_period_ms(source) : 1;
+
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        span s;
+        if (!source_read(source, mid, SERIES_RANGE_MM, now_ms, &s) || s.start_ms + length_ms <= from_ms) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Start of the oldest record a source holds, or INT64_MAX if it's empty.
+static int64_t source_oldest_ms(int source, int64_t now_ms) {
+    uint32_t first, end;
+    span s;
+
+    source_bounds(source, &first, &end);
+    for (; first < end; first++) {
+        if (source_read(source, first, SERIES_RANGE_MM, now_ms, &s)) {
+            return s.start_ms;
+        }
+    }
+    return INT64_MAX;
+}
+
+// The point being built, covering [index * step, (index + 1) * step).
+typedef struct {
+    int64_t index; // -1 before the first
+    uint32_t count;
+    uint16_t min;
+    uint16_t max;
+    double sum;
+    bool first;
+} point;
+
+static void flush_point(metrics_writer *w, const series_query *q, point *p, int64_t step_ms) {
+    double scale = metric_infos[q->metric].scale;
+
+    if (p->index < 0 || !p->count) {
+        return;
+    }
+    metrics_printf(w, "%s[%lld,%.6g,%.6g,%.6g,%lu]", p->first ? "" : ",",
+        (long long)(p->index * step_ms), p->min * scale, p->max * scale,
+        p->sum / p->count * scale, (unsigned long)p->count);
+    p->first = false;
+}
+
+// {"metric":"range_mm","now":ms,"from":ms,"to":ms,"step":ms,
+// "points":[[start_ms,min,max,mean,samples],...]}
+static void write_json(metrics_writer *w, void *arg) {
+    const series_query *q = (const series_query *)arg;
+    int64_t now_ms = esp_timer_get_time() / 1000;
+    int64_t from_ms = q->from_ms <= 0 ? now_ms + q->from_ms : q->from_ms;
+    int64_t to_ms = q->to_ms <= 0 ? now_ms + q->to_ms : q->to_ms;
+    int64_t step_ms = q->step_ms;
+    int source = -1;
+
+    if (from_ms < 0) {
+        from_ms = 0;
+    }
+    if (to_ms > now_ms) {
+        to_ms = now_ms;
+    }
+    if (step_ms < 1) {
+        step_ms = 1;
+    }
+    if (to_ms > from_ms && (to_ms - from_ms) / step_ms >= SERIES_MAX_POINTS) {
+        step_ms = (to_ms - from_ms) / SERIES_MAX_POINTS + 1;
+    }
+
+    // The finest source that's no coarser than the step and reaches back to
+    // from, else the finest that reaches back at all, else the one holding the
+    // oldest history. Whatever it lacks at the recent end comes from the finer
+    // ones, down to the raw samples.
+    int64_t oldest_ms[SOURCE_COUNT];
+    for (int s = 0; s < (int)SOURCE_COUNT; s++) {
+        oldest_ms[s] = source_oldest_ms(s, now_ms);
+    }
+    for (int s = 0; s < (int)SOURCE_COUNT && source < 0; s++) {
+        if (source_period_ms(s) <= step_ms && oldest_ms[s] <= from_ms) {
+            source = s;
+        }
+    }
+    for (int s = 0; s < (int)SOURCE_COUNT && source < 0; s++) {
+        if (oldest_ms[s] <= from_ms) {
+            source = s;
+        }
+    }
+    if (source < 0) {
+        source = 0;
+        for (int s = 1; s < (int)SOURCE_COUNT; s++) {
+            if (oldest_ms[s] < oldest_ms[source]) {
+                source = s;
+            }
+        }
+    }
+    if ((int64_t)source_period_ms(source) > step_ms) {
+        step_ms = source_period_ms(source);
+    }
+
+    metrics_printf(w, "{\"metric\":\"%s\",\"now\":%lld,\"from\":%lld,\"to\":%lld,\"step\":%lld,\"points\":[",
+        metric_infos[q->metric].name, (long long)now_ms, (long long)from_ms, (long long)to_ms, (long long)step_ms);
+
+    point p = { -1, 0, 0, 0, 0.0, true };
+    int64_t cursor_ms = from_ms;
+    for (int s = source; s >= 0; s--) {
+        uint32_t first, end;
+        int64_t period_ms = source_period_ms(s);
+
+        source_bounds(s, &first, &end);
+        for (uint32_t seq = source_seek(s, first, end, cursor_ms, now_ms); seq < end; seq++) {
+            span sp;
+            if (!source_read(s, seq, q->metric, now_ms, &sp)) {
+                // Overwritten while we were getting to it.
+                continue;
+            }
+            if (sp.start_ms > to_ms) {
+                break;
+            }
+            cursor_ms = sp.start_ms + (period_ms ? period_ms : 1);
+            if (!sp.count) {
+                continue;
+            }
+            int64_t index = sp.start_ms / step_ms;
+            if (index != p.index) {
+                flush_point(w, q, &p, step_ms);
+                p.index = index;
+                p.count = 0;
+                p.min = UINT16_MAX;
+                p.max = 0;
+                p.sum = 0.0;
+            }
+            p.count += sp.count;
+            if (sp.min < p.min) {
+                p.min = sp.min;
+            }
+            if (sp.max > p.max) {
+                p.max = sp.max;
+            }
+            p.sum += (double)sp.mean * sp.count;
+        }
+    }
+    flush_point(w, q, &p, step_ms);
+    metrics_printf(w, "]}");
+}
+
+bool series_write_json(const series_query *query, metrics_sink sink, void *ctx) {
+    return metrics_write_with(sink, ctx, write_json, (void *)query);
+}
+
+bool series_next_raw(uint32_t *cursor, sample_codec_sample *out) {
+    raw_record record;
+    uint32_t seq = *cursor;
+    bool found = false;
+
+    taskENTER_CRITICAL(&ring_lock);
+    if (seq > raw_head) {
+        // Cursor from some other boot; start over.
+        seq = 0;
+    }
+    if (raw_head - seq > SERIES_RAW_SIZE) {
+        seq = raw_head - SERIES_RAW_SIZE;
+    }
+    if (seq < raw_head) {
+        record = raw_ring[seq % SERIES_RAW_SIZE];
+        found = true;
+    }
+    taskEXIT_CRITICAL(&ring_lock);
+    if (!found) {
+        return false;
+    }
+
+    out->seq = seq + 1;
+    out->time_ms = record.time_ms;
+    out->range_mm = record.values[SERIES_RANGE_MM];
+    out->signal_rate = record.values[SERIES_SIGNAL_RATE_MCPS];
+    out->ambient_rate = record.values[SERIES_AMBIENT_RATE_MCPS];
+    out->sigma = record.values[SERIES_SIGMA_MM];
+    out->range_status = record.range_status;
+    out->rejected = record.rejected;
+    *cursor = out->seq;
+    return true;
+}
+
+uint32_t series_raw_count(void) {
+    uint32_t count;
+
+    taskENTER_CRITICAL(&ring_lock);
+    count = raw_head;
+    taskEXIT_CRITICAL(&ring_lock);
+    return count;
+}
+
+bool series_export(uint32_t since, metrics_sink sink, void *ctx) {
+    uint8_t buf[METRICS_CHUNK_SIZE];
+    // Stop at what's there now so a steady stream of samples can't keep us
+    // here, and so the header can say where the next export should start.
+    uint32_t end = series_raw_count();
+    uint32_t cursor;
+    size_t len = 0;
+    sample_codec_state state;
+    sample_codec_sample sample;
+
+    if (since > end) {
+        // A seq from some other boot; start over.
+        since = 0;
+    }
+    sample_codec_header header = {
+        .magic = {'R', 'S', 'M', 'P'},
+        .version = SAMPLE_CODEC_VERSION,
+        .header_size = sizeof(sample_codec_header),
+        .reserved = {0, 0},
+        .now_ms = (uint32_t)(esp_timer_get_time() / 1000),
+        .since = since,
+        .next_since = end,
+    };
+    memcpy(buf, &header, sizeof(header));
+    len = sizeof(header);
+
+    sample_codec_start(&state, since);
+    cursor = since;
+    while (series_next_raw(&cursor, &sample) && sample.seq <= end) {
+        if (sizeof(buf) - len < SAMPLE_CODEC_MAX_SAMPLE) {
+            if (!sink(ctx, (const char *)buf, len)) {
+                return false;
+            }
+            len = 0;
+        }
+        len += sample_codec_encode(&state, &sample, buf + len);
+    }
+    return sink(ctx, (const char *)buf, len);
+}
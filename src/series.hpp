@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdint.h>
+#include "metrics.hpp"
+#include "sample_codec.h"
+#include "vl53l0x_api.h"
+
+// History kept at each resolution. Every sample goes into the 1 s, 1 min and
+// 1 h tiers, which keep min, max and mean per interval; the raw ring keeps at
+// most one sample per SERIES_RAW_INTERVAL_MS. The defaults hold at least 3
+// minutes of raw samples, 5 minutes of seconds, 6 hours of minutes and a week
+// of hours in about 54 KB, allocated from the heap by series_init.
+#ifndef SERIES_RAW_SIZE
+#define SERIES_RAW_SIZE 1536 // 16 bytes each
+#endif
+#ifndef SERIES_RAW_INTERVAL_MS
+#define SERIES_RAW_INTERVAL_MS 120 // every 4th sample at 33 Hz
+#endif
+#ifndef SERIES_SECONDS_SIZE
+#define SERIES_SECONDS_SIZE 300 // 36 bytes each, as are minutes and hours
+#endif
+#ifndef SERIES_MINUTES_SIZE
+#define SERIES_MINUTES_SIZE 360
+#endif
+#ifndef SERIES_HOURS_SIZE
+#define SERIES_HOURS_SIZE 168
+#endif
+
+// Most points one query returns; a finer step is widened to fit.
+#ifndef SERIES_MAX_POINTS
+#define SERIES_MAX_POINTS 600
+#endif
+
+typedef enum {
+    SERIES_RANGE_MM,          // accepted samples only
+    SERIES_SIGNAL_RATE_MCPS,
+    SERIES_AMBIENT_RATE_MCPS,
+    SERIES_SIGMA_MM,
+    SERIES_METRIC_COUNT,
+} series_metric;
+
+// Times are milliseconds on the esp_timer clock, i.e. since boot. Zero or
+// negative values count back from now.
+typedef struct {
+    series_metric metric;
+    int64_t from_ms;
+    int64_t to_ms;
+    int64_t step_ms; // 0 for the finest the range allows
+} series_query;
+
+// Allocates the history. Without room for it the history stays empty and
+// the rest of the firmware carries on.
+void series_init(void);
+
+// Looks a metric up by the name /api/series uses. Returns false if there's
+// no such metric.
+bool series_find_metric(const char *name, series_metric *out);
+
+// Records one measurement at every resolution, and in the raw ring if the
+// last raw sample is old enough. Range only counts if quality_check accepted
+// it. Only the sensor task may call this; it's a
+// record copy and a few additions per tier.
+void series_observe(const VL53L0X_RangingMeasurementData_t *measurement, FixPoint1616_t sigma_mm, bool accepted);
+
+// Writes the points for a query as JSON, drawing on the finest history that
+// reaches back far enough.
+bool series_write_json(const series_query *query, metrics_sink sink, void *ctx);
+
+// Writes the raw samples numbered after since, in the sample_codec format, for
+// /api/export. Raw samples are numbered from 1 as they're kept; pass the
+// header's next_since back to pick up where the last export ended.
+bool series_export(uint32_t since, metrics_sink sink, void *ctx);
+
+// Copies the oldest retained raw sample numbered after *cursor and advances
+// *cursor to it. Start with *cursor = 0. Returns false when caught up. Samples
+// which were overwritten show up as a jump in seq.
+bool series_next_raw(uint32_t *cursor, sample_codec_sample *out);
+
+// Raw samples kept so far, which is also the seq of the latest.
+uint32_t series_raw_count(void);
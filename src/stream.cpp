@@ -0,0 +1,261 @@
+#include "stream.hpp"
+#include "samples.hpp"
+#include "quality.hpp"
+#include "metrics.hpp"
+
+#include <atomic>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <esp_log.h>
+#include <sys/socket.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "stream";
+
+typedef struct {
+    httpd_handle_t server;
+    int fd;              // -1 if the slot is free
+    bool websocket;
+    uint32_t cursor;     // last seq sent, as for samples_next
+    uint32_t generation; // tells a client apart from an earlier one that had the same fd
+} stream_client;
+
+// Added and removed from httpd's task, walked by the stream task. The stream
+// task works on a copy so a client is never sent to under the lock.
+static stream_client clients[STREAM_MAX_CLIENTS];
+static portMUX_TYPE clients_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t next_generation = 1; // under clients_lock
+
+// Stream task only. What's been formatted for each slot but not yet taken by
+// its socket. Sends never block, so a client with a full TCP window keeps
+// the rest here until its next turn rather than holding up the others.
+typedef struct {
+    uint32_t generation; // of the client it was formatted for; 0 for none
+    size_t len;
+    size_t sent;
+    uint8_t buf[768];
+} pending_output;
+
+static pending_output pending[STREAM_MAX_CLIENTS];
+
+static std::atomic<uint32_t> client_count(0);
+static std::atomic<uint32_t> dropped(0);
+
+static_assert(sizeof(stream_record) == 24, "stream_record is part of the /stream format");
+static_assert(STREAM_QUEUE_DEPTH <= SAMPLES_RING_SIZE - 2, "STREAM_QUEUE_DEPTH is deeper than the samples ring");
+
+bool stream_full(void) {
+    return client_count.load(std::memory_order_relaxed) >= STREAM_MAX_CLIENTS;
+}
+
+bool stream_add_client(httpd_req_t *req, bool websocket) {
+    range_sample latest;
+    // Start from now rather than replaying the ring.
+    uint32_t cursor = samples_latest(&latest) ? latest.seq : 0;
+    int fd = httpd_req_to_sockfd(req);
+    bool added = false;
+
+    taskENTER_CRITICAL(&clients_lock);
+    for (int i = 0; i < STREAM_MAX_CLIENTS; i++) {
+        if (clients[i].fd < 0) {
+            clients[i] = { req->handle, fd, websocket, cursor, next_generation++ };
+            added = true;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&clients_lock);
+    if (added) {
+        client_count.fetch_add(1, std::memory_order_relaxed);
+    }
+    return added;
+}
+
+void stream_remove_client(int fd) {
+    bool removed = false;
+
+    taskENTER_CRITICAL(&clients_lock);
+    for (int i = 0; i < STREAM_MAX_CLIENTS; i++) {
+        if (clients[i].fd == fd) {
+            clients[i].fd = -1;
+            removed = true;
+        }
+    }
+    taskEXIT_CRITICAL(&clients_lock);
+    if (removed) {
+        client_count.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+// Moves a client which fell too far behind up to STREAM_QUEUE_DEPTH from the
+// head. The ring itself would drop them soon anyway; this bounds how stale
+// what a slow client gets can be.
+static void drop_oldest(stream_client *client, uint32_t head) {
+    if (head - client->cursor > STREAM_QUEUE_DEPTH) {
+        dropped.fetch_add(head - client->cursor - STREAM_QUEUE_DEPTH, std::memory_order_relaxed);
+        client->cursor = head - STREAM_QUEUE_DEPTH;
+    }
+}
+
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+// Formats one binary message. It's framed here rather than by
+// httpd_ws_send_frame_async, which always blocks: FIN and binary, no mask
+// from a server, and a 16-bit length.
+static void format_websocket(stream_client *client, pending_output *out) {
+    stream_record records[16];
+    range_sample sample;
+    size_t n = 0;
+
+    static_assert(4 + sizeof(records) <= sizeof(out->buf), "pending_output can't hold a message");
+    static_assert(sizeof(records) > 125 && sizeof(records) <= UINT16_MAX, "message length needs the 16-bit form");
+    while (n < sizeof(records) / sizeof(records[0]) && samples_next(&client->cursor, &sample)) {
+        records[n++] = {
+            .seq = sample.seq,
+            .timestamp_us = (uint32_t)sample.timestamp_us,
+            .range_mm = sample.range_mm,
+            .range_status = sample.range_status,
+            .reserved = 0,
+            .signal_rate_mcps = sample.signal_rate_mcps,
+            .ambient_rate_mcps = sample.ambient_rate_mcps,
+            .sigma_mm = sample.sigma_mm,
+        };
+    }
+    if (!n) {
+        return;
+    }
+    size_t len = n * sizeof(records[0]);
+    size_t header = len > 125 ? 4 : 2;
+    out->buf[0] = 0x80 | HTTPD_WS_TYPE_BINARY;
+    if (header == 4) {
+        out->buf[1] = 126;
+        out->buf[2] = (uint8_t)(len >> 8);
+        out->buf[3] = (uint8_t)len;
+    } else {
+        out->buf[1] = (uint8_t)len;
+    }
+    memcpy(out->buf + header, records, len);
+    out->len = header + len;
+}
+#endif
+
+static void format_events(stream_client *client, pending_output *out) {
+    char *buf = (char *)out->buf;
+    range_sample sample;
+    size_t len = 0;
+
+    // Stop while there's still room for the longest event.
+    while (len < sizeof(out->buf) - 288 && samples_next(&client->cursor, &sample)) {
+        len += snprintf(buf + len, sizeof(out->buf) - len,
+            "id: %lu\ndata: {\"seq\":%lu,\"timestamp_us\":%lld,\"range_mm\":%u,\"filtered_range_mm\":%u,"
+            "\"range_status\":%u,\"quality\":\"%s\","
+            "\"signal_rate_mcps\":%.3f,\"ambient_rate_mcps\":%.3f,\"sigma_mm\":%.2f,\"spread_mm\":%.2f}\n\n",
+            (unsigned long)sample.seq, (unsigned long)sample.seq, (long long)sample.timestamp_us,
+            sample.range_mm, sample.filtered_range_mm, sample.range_status,
+            quality_reason_name((quality_reason)sample.quality), sample.signal_rate_mcps / 65536.0,
+            sample.ambient_rate_mcps / 65536.0, sample.sigma_mm / 65536.0, sample.spread_mm / 65536.0);
+    }
+    out->len = len;
+}
+
+// Writes as much of what's pending as the socket takes without blocking.
+// Fails only if the socket is gone.
+static esp_err_t flush(const stream_client *client, pending_output *out) {
+    while (out->sent < out->len) {
+        // Straight to the socket: httpd_socket_send would just call send()
+        // too, but reports a missing session as a positive esp_err_t that
+        // can't be told apart from a byte count.
+        ssize_t n = send(client->fd, out->buf + out->sent, out->len - out->sent, MSG_DONTWAIT);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // Full window; the rest goes next time round.
+            return ESP_OK;
+        }
+        if (n <= 0) {
+            return ESP_FAIL;
+        }
+        out->sent += n;
+    }
+    out->len = out->sent = 0;
+    return ESP_OK;
+}
+
+static esp_err_t send_client(stream_client *client, pending_output *out) {
+    if (out->generation != client->generation) {
+        // The slot changed hands, maybe to a new client on the same fd; what
+        // was left is the tail of a message for someone else.
+        out->generation = client->generation;
+        out->len = out->sent = 0;
+    }
+    if (out->len) {
+        // Finish the last message before starting another, so frames and
+        // events are never split.
+        esp_err_t err = flush(client, out);
+        if (err != ESP_OK || out->len) {
+            return err;
+        }
+    }
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    if (client->websocket) {
+        format_websocket(client, out);
+    } else {
+        format_events(client, out);
+    }
+#else
+    format_events(client, out);
+#endif
+    return flush(client, out);
+}
+
+static void stream_task(void *arg) {
+    stream_client snapshot[STREAM_MAX_CLIENTS];
+    range_sample latest;
+    TickType_t last_wake = xTaskGetTickCount();
+
+    while (1) {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(STREAM_INTERVAL_MS));
+        if (client_count.load(std::memory_order_relaxed) == 0 || !samples_latest(&latest)) {
+            continue;
+        }
+
+        taskENTER_CRITICAL(&clients_lock);
+        memcpy(snapshot, clients, sizeof(snapshot));
+        taskEXIT_CRITICAL(&clients_lock);
+
+        for (int i = 0; i < STREAM_MAX_CLIENTS; i++) {
+            stream_client *client = &snapshot[i];
+            if (client->fd < 0) {
+                continue;
+            }
+            drop_oldest(client, latest.seq);
+            esp_err_t err = send_client(client, &pending[i]);
+            if (err != ESP_OK) {
+                ESP_LOGI(TAG, "dropping client on socket %d: %s", client->fd, esp_err_to_name(err));
+                stream_remove_client(client->fd);
+                httpd_sess_trigger_close(client->server, client->fd);
+                continue;
+            }
+
+            // Write the cursor back unless the slot changed hands meanwhile.
+            taskENTER_CRITICAL(&clients_lock);
+            if (clients[i].generation == client->generation) {
+                clients[i].cursor = client->cursor;
+            }
+            taskEXIT_CRITICAL(&clients_lock);
+        }
+    }
+}
+
+static void collect_stream(metrics_writer *w) {
+    metrics_write_family(w, "ranger_stream_clients", "Clients connected to /stream.", "gauge");
+    metrics_write_sample(w, "ranger_stream_clients", NULL, client_count.load(std::memory_order_relaxed));
+    metrics_write_family(w, "ranger_stream_dropped_samples", "Total number of samples skipped for /stream clients which fell behind.", "counter");
+    metrics_write_sample(w, "ranger_stream_dropped_samples", NULL, dropped.load(std::memory_order_relaxed));
+}
+
+void stream_start(void) {
+    for (int i = 0; i < STREAM_MAX_CLIENTS; i++) {
+        clients[i].fd = -1;
+    }
+    metrics_add_collector(collect_stream);
+    xTaskCreate(stream_task, "stream", 4096, NULL, 3, NULL);
+}
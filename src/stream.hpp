@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include <esp_http_server.h>
+
+// Connections /stream will feed at once. Each holds one of httpd's
+// max_open_sockets for as long as it's open.
+#ifndef STREAM_MAX_CLIENTS
+#define STREAM_MAX_CLIENTS 3
+#endif
+
+// Samples a client may fall behind before its oldest are dropped. At most
+// SAMPLES_RING_SIZE - 2.
+#ifndef STREAM_QUEUE_DEPTH
+#define STREAM_QUEUE_DEPTH 32
+#endif
+
+// Longest message a client may send /stream, which ignores them; anything
+// longer closes the connection.
+#ifndef STREAM_MAX_CLIENT_FRAME
+#define STREAM_MAX_CLIENT_FRAME 1024
+#endif
+
+// How often the stream task looks for new samples; at 20 ms a 50 Hz sensor
+// goes out one sample per message.
+#ifndef STREAM_INTERVAL_MS
+#define STREAM_INTERVAL_MS 20
+#endif
+
+// One sample in a WebSocket binary message, little-endian. A message is an
+// array of these. Samples dropped for a slow client show up as a jump in seq.
+typedef struct {
+    uint32_t seq;
+    uint32_t timestamp_us;       // low 32 bits of range_sample.timestamp_us
+    uint16_t range_mm;
+    uint8_t range_status;
+    uint8_t reserved;
+    uint32_t signal_rate_mcps;   // 16.16 fixed point
+    uint32_t ambient_rate_mcps;  // 16.16 fixed point
+    uint32_t sigma_mm;           // 16.16 fixed point
+} stream_record;
+
+// Starts the task that feeds the clients. Samples are read from the samples
+// ring, so the sensor task never waits on a client, and sends never block, so
+// neither does any other client. Call before metrics_start; it adds to
+// /metrics.
+void stream_start(void);
+
+// Whether stream_add_client would turn a client away.
+bool stream_full(void);
+
+// Feeds samples to the request's socket from now on, as WebSocket binary
+// messages or as server-sent events. Returns false if there's no room.
+bool stream_add_client(httpd_req_t *req, bool websocket);
+
+// Stops feeding the socket. Safe to call for sockets which were never added.
+void stream_remove_client(int fd);
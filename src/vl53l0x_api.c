@@ -2231,10 +2231,12 @@ VL53L0X_Error VL53L0X_CheckAndLoadInterruptSettings(VL53L0X_DEV Dev,
 				Status = VL53L0X_load_tuning_settings(Dev,
 						InterruptThresholdSettings);
 			} else {
+				VL53L0X_BeginBatch(Dev);
 				Status |= VL53L0X_WrByte(Dev, 0xFF, 0x04);
 				Status |= VL53L0X_WrByte(Dev, 0x70, 0x00);
 				Status |= VL53L0X_WrByte(Dev, 0xFF, 0x00);
 				Status |= VL53L0X_WrByte(Dev, 0x80, 0x00);
+				Status |= VL53L0X_EndBatch(Dev);
 			}
 		}
 		break;
@@ -2250,10 +2252,12 @@ VL53L0X_Error VL53L0X_CheckAndLoadInterruptSettings(VL53L0X_DEV Dev,
 				Status = VL53L0X_load_tuning_settings(Dev,
 						InterruptThresholdSettings);
 			} else {
+				VL53L0X_BeginBatch(Dev);
 				Status |= VL53L0X_WrByte(Dev, 0xFF, 0x04);
 				Status |= VL53L0X_WrByte(Dev, 0x70, 0x00);
 				Status |= VL53L0X_WrByte(Dev, 0xFF, 0x00);
 				Status |= VL53L0X_WrByte(Dev, 0x80, 0x00);
+				Status |= VL53L0X_EndBatch(Dev);
 			}
 		}
 		break;
@@ -2267,10 +2271,12 @@ VL53L0X_Error VL53L0X_CheckAndLoadInterruptSettings(VL53L0X_DEV Dev,
 				Status = VL53L0X_load_tuning_settings(Dev,
 						InterruptThresholdSettings);
 			} else {
+				VL53L0X_BeginBatch(Dev);
 				Status |= VL53L0X_WrByte(Dev, 0xFF, 0x04);
 				Status |= VL53L0X_WrByte(Dev, 0x70, 0x00);
 				Status |= VL53L0X_WrByte(Dev, 0xFF, 0x00);
 				Status |= VL53L0X_WrByte(Dev, 0x80, 0x00);
+				Status |= VL53L0X_EndBatch(Dev);
 			}
 		}
 		break;
@@ -2284,6 +2290,7 @@ VL53L0X_Error VL53L0X_CheckAndLoadInterruptSettings(VL53L0X_DEV Dev,
 VL53L0X_Error VL53L0X_StartMeasurement(VL53L0X_DEV Dev)
 {
 	VL53L0X_Error Status = VL53L0X_ERROR_NONE;
+	VL53L0X_Error BatchStatus;
 	VL53L0X_DeviceModes DeviceMode;
 	uint8_t Byte;
 	uint8_t StartStopByte = VL53L0X_REG_SYSRANGE_MODE_START_STOP;
@@ -2294,6 +2301,8 @@ VL53L0X_Error VL53L0X_StartMeasurement(VL53L0X_DEV Dev)
 	/* Get Current DeviceMode */
 	VL53L0X_GetDeviceMode(Dev, &DeviceMode);
 
+	/* Stop variable sequence and start go out as one bus session */
+	VL53L0X_BeginBatch(Dev);
 	Status = VL53L0X_WrByte(Dev, 0x80, 0x01);
 	Status = VL53L0X_WrByte(Dev, 0xFF, 0x01);
 	Status = VL53L0X_WrByte(Dev, 0x00, 0x00);
@@ -2360,6 +2369,9 @@ VL53L0X_Error VL53L0X_StartMeasurement(VL53L0X_DEV Dev)
 		Status = VL53L0X_ERROR_MODE_NOT_SUPPORTED;
 	}
 
+	BatchStatus = VL53L0X_EndBatch(Dev);
+	if (Status == VL53L0X_ERROR_NONE)
+		Status = BatchStatus;
 
 	LOG_FUNCTION_END(Status);
 	return Status;
@@ -2371,6 +2383,7 @@ VL53L0X_Error VL53L0X_StopMeasurement(VL53L0X_DEV Dev)
 
 	LOG_FUNCTION_START("");
 
+	VL53L0X_BeginBatch(Dev);
 	Status = VL53L0X_WrByte(Dev, VL53L0X_REG_SYSRANGE_START,
 	VL53L0X_REG_SYSRANGE_MODE_SINGLESHOT);
 
@@ -2379,6 +2392,7 @@ VL53L0X_Error VL53L0X_StopMeasurement(VL53L0X_DEV Dev)
 	Status = VL53L0X_WrByte(Dev, 0x91, 0x00);
 	Status = VL53L0X_WrByte(Dev, 0x00, 0x01);
 	Status = VL53L0X_WrByte(Dev, 0xFF, 0x00);
+	Status = VL53L0X_EndBatch(Dev);
 
 	if (Status == VL53L0X_ERROR_NONE) {
 		/* Set PAL State to Idle */
@@ -2727,6 +2741,7 @@ VL53L0X_Error VL53L0X_SetGpioConfig(VL53L0X_DEV Dev, uint8_t Pin,
 
 	} else if (DeviceMode == VL53L0X_DEVICEMODE_GPIO_OSC) {
 
+		VL53L0X_BeginBatch(Dev);
 		Status |= VL53L0X_WrByte(Dev, 0xff, 0x01);
 		Status |= VL53L0X_WrByte(Dev, 0x00, 0x00);
 
@@ -2747,6 +2762,7 @@ VL53L0X_Error VL53L0X_SetGpioConfig(VL53L0X_DEV Dev, uint8_t Pin,
 		Status |= VL53L0X_WrByte(Dev, 0xff, 0x00);
 		Status |= VL53L0X_WrByte(Dev, 0xff, 0x01);
 		Status |= VL53L0X_WrByte(Dev, 0x00, 0x00);
+		Status |= VL53L0X_EndBatch(Dev);
 
 	} else {
 
@@ -2948,6 +2964,7 @@ VL53L0X_Error VL53L0X_GetStopCompletedStatus(VL53L0X_DEV Dev,
 	*pStopStatus = Byte;
 
 	if (Byte == 0) {
+		VL53L0X_BeginBatch(Dev);
 		Status = VL53L0X_WrByte(Dev, 0x80, 0x01);
 		Status = VL53L0X_WrByte(Dev, 0xFF, 0x01);
 		Status = VL53L0X_WrByte(Dev, 0x00, 0x00);
@@ -2956,6 +2973,7 @@ VL53L0X_Error VL53L0X_GetStopCompletedStatus(VL53L0X_DEV Dev,
 		Status = VL53L0X_WrByte(Dev, 0x00, 0x01);
 		Status = VL53L0X_WrByte(Dev, 0xFF, 0x00);
 		Status = VL53L0X_WrByte(Dev, 0x80, 0x00);
+		Status = VL53L0X_EndBatch(Dev);
 	}
 
 	LOG_FUNCTION_END(Status);
@@ -2975,10 +2993,13 @@ VL53L0X_Error VL53L0X_ClearInterruptMask(VL53L0X_DEV Dev,
 	/* clear bit 0 range interrupt, bit 1 error interrupt */
 	LoopCount = 0;
 	do {
+		/* set and release go out together, the read flushes them */
+		VL53L0X_BeginBatch(Dev);
 		Status = VL53L0X_WrByte(Dev,
 			VL53L0X_REG_SYSTEM_INTERRUPT_CLEAR, 0x01);
 		Status |= VL53L0X_WrByte(Dev,
 			VL53L0X_REG_SYSTEM_INTERRUPT_CLEAR, 0x00);
+		Status |= VL53L0X_EndBatch(Dev);
 		Status |= VL53L0X_RdByte(Dev,
 			VL53L0X_REG_RESULT_INTERRUPT_STATUS, &Byte);
 		LoopCount++;
@@ -211,6 +211,48 @@ VL53L0X_Error VL53L0X_device_read_strobe(VL53L0X_DEV Dev)
 
 }
 
+/* Opens the NVM for VL53L0X_device_read_strobe(), words are then selected
+ * through 0x94 and read back from 0x90 */
+static VL53L0X_Error nvm_read_begin(VL53L0X_DEV Dev)
+{
+	VL53L0X_Error Status = VL53L0X_ERROR_NONE;
+	uint8_t byte;
+
+	Status |= VL53L0X_WrByte(Dev, 0x80, 0x01);
+	Status |= VL53L0X_WrByte(Dev, 0xFF, 0x01);
+	Status |= VL53L0X_WrByte(Dev, 0x00, 0x00);
+
+	Status |= VL53L0X_WrByte(Dev, 0xFF, 0x06);
+	Status |= VL53L0X_RdByte(Dev, 0x83, &byte);
+	Status |= VL53L0X_WrByte(Dev, 0x83, byte|4);
+	Status |= VL53L0X_WrByte(Dev, 0xFF, 0x07);
+	Status |= VL53L0X_WrByte(Dev, 0x81, 0x01);
+
+	Status |= VL53L0X_PollingDelay(Dev);
+
+	Status |= VL53L0X_WrByte(Dev, 0x80, 0x01);
+
+	return Status;
+}
+
+static VL53L0X_Error nvm_read_end(VL53L0X_DEV Dev)
+{
+	VL53L0X_Error Status = VL53L0X_ERROR_NONE;
+	uint8_t byte;
+
+	Status |= VL53L0X_WrByte(Dev, 0x81, 0x00);
+	Status |= VL53L0X_WrByte(Dev, 0xFF, 0x06);
+	Status |= VL53L0X_RdByte(Dev, 0x83, &byte);
+	Status |= VL53L0X_WrByte(Dev, 0x83, byte&0xfb);
+	Status |= VL53L0X_WrByte(Dev, 0xFF, 0x01);
+	Status |= VL53L0X_WrByte(Dev, 0x00, 0x01);
+
+	Status |= VL53L0X_WrByte(Dev, 0xFF, 0x00);
+	Status |= VL53L0X_WrByte(Dev, 0x80, 0x00);
+
+	return Status;
+}
+
 VL53L0X_Error VL53L0X_get_info_from_device(VL53L0X_DEV Dev, uint8_t option)
 {
 
@@ -246,19 +288,7 @@ VL53L0X_Error VL53L0X_get_info_from_device(VL53L0X_DEV Dev, uint8_t option)
 	 */
 	if (ReadDataFromDeviceDone != 7) {
 
-		Status |= VL53L0X_WrByte(Dev, 0x80, 0x01);
-		Status |= VL53L0X_WrByte(Dev, 0xFF, 0x01);
-		Status |= VL53L0X_WrByte(Dev, 0x00, 0x00);
-
-		Status |= VL53L0X_WrByte(Dev, 0xFF, 0x06);
-		Status |= VL53L0X_RdByte(Dev, 0x83, &byte);
-		Status |= VL53L0X_WrByte(Dev, 0x83, byte|4);
-		Status |= VL53L0X_WrByte(Dev, 0xFF, 0x07);
-		Status |= VL53L0X_WrByte(Dev, 0x81, 0x01);
-
-		Status |= VL53L0X_PollingDelay(Dev);
-
-		Status |= VL53L0X_WrByte(Dev, 0x80, 0x01);
+		Status |= nvm_read_begin(Dev);
 
 		if (((option & 1) == 1) &&
 			((ReadDataFromDeviceDone & 1) == 0)) {
@@ -397,15 +427,7 @@ VL53L0X_Error VL53L0X_get_info_from_device(VL53L0X_DEV Dev, uint8_t option)
 							>> 24);
 		}
 
-		Status |= VL53L0X_WrByte(Dev, 0x81, 0x00);
-		Status |= VL53L0X_WrByte(Dev, 0xFF, 0x06);
-		Status |= VL53L0X_RdByte(Dev, 0x83, &byte);
-		Status |= VL53L0X_WrByte(Dev, 0x83, byte&0xfb);
-		Status |= VL53L0X_WrByte(Dev, 0xFF, 0x01);
-		Status |= VL53L0X_WrByte(Dev, 0x00, 0x01);
-
-		Status |= VL53L0X_WrByte(Dev, 0xFF, 0x00);
-		Status |= VL53L0X_WrByte(Dev, 0x80, 0x00);
+		Status |= nvm_read_end(Dev);
 	}
 
 	if ((Status == VL53L0X_ERROR_NONE) &&
@@ -478,6 +500,107 @@ VL53L0X_Error VL53L0X_get_info_from_device(VL53L0X_DEV Dev, uint8_t option)
 	return Status;
 }
 
+VL53L0X_Error VL53L0X_read_part_uid(VL53L0X_DEV Dev,
+		uint32_t *pPartUIDUpper, uint32_t *pPartUIDLower)
+{
+	VL53L0X_Error Status = VL53L0X_ERROR_NONE;
+
+	LOG_FUNCTION_START("");
+
+	Status |= nvm_read_begin(Dev);
+
+	Status |= VL53L0X_WrByte(Dev, 0x94, 0x7B);
+	Status |= VL53L0X_device_read_strobe(Dev);
+	Status |= VL53L0X_RdDWord(Dev, 0x90, pPartUIDUpper);
+
+	Status |= VL53L0X_WrByte(Dev, 0x94, 0x7C);
+	Status |= VL53L0X_device_read_strobe(Dev);
+	Status |= VL53L0X_RdDWord(Dev, 0x90, pPartUIDLower);
+
+	Status |= nvm_read_end(Dev);
+
+	LOG_FUNCTION_END(Status);
+	return Status;
+}
+
+VL53L0X_Error VL53L0X_get_nvm_info(VL53L0X_DEV Dev,
+		VL53L0X_DeviceNvmInfo_t *pNvmInfo)
+{
+	VL53L0X_Error Status = VL53L0X_ERROR_NONE;
+	char *ProductId_tmp;
+	int i;
+
+	LOG_FUNCTION_START("");
+
+	Status = VL53L0X_get_info_from_device(Dev, 7);
+
+	if (Status == VL53L0X_ERROR_NONE) {
+		pNvmInfo->PartUIDUpper = VL53L0X_GETDEVICESPECIFICPARAMETER(
+			Dev, PartUIDUpper);
+		pNvmInfo->PartUIDLower = VL53L0X_GETDEVICESPECIFICPARAMETER(
+			Dev, PartUIDLower);
+		pNvmInfo->ModuleId = VL53L0X_GETDEVICESPECIFICPARAMETER(Dev,
+			ModuleId);
+		pNvmInfo->Revision = VL53L0X_GETDEVICESPECIFICPARAMETER(Dev,
+			Revision);
+		ProductId_tmp = VL53L0X_GETDEVICESPECIFICPARAMETER(Dev,
+			ProductId);
+		VL53L0X_COPYSTRING(pNvmInfo->ProductId, ProductId_tmp);
+		pNvmInfo->ReferenceSpadCount =
+			VL53L0X_GETDEVICESPECIFICPARAMETER(Dev,
+				ReferenceSpadCount);
+		pNvmInfo->ReferenceSpadType =
+			VL53L0X_GETDEVICESPECIFICPARAMETER(Dev,
+				ReferenceSpadType);
+		for (i = 0; i < VL53L0X_REF_SPAD_BUFFER_SIZE; i++)
+			pNvmInfo->RefGoodSpadMap[i] =
+				Dev->Data.SpadData.RefGoodSpadMap[i];
+		pNvmInfo->SignalRateMeasFixed400mm =
+			VL53L0X_GETDEVICESPECIFICPARAMETER(Dev,
+				SignalRateMeasFixed400mm);
+		pNvmInfo->Part2PartOffsetAdjustmentNVMMicroMeter =
+			PALDevDataGet(Dev,
+				Part2PartOffsetAdjustmentNVMMicroMeter);
+	}
+
+	LOG_FUNCTION_END(Status);
+	return Status;
+}
+
+void VL53L0X_set_nvm_info(VL53L0X_DEV Dev,
+		const VL53L0X_DeviceNvmInfo_t *pNvmInfo)
+{
+	char *ProductId_tmp;
+	int i;
+
+	LOG_FUNCTION_START("");
+
+	VL53L0X_SETDEVICESPECIFICPARAMETER(Dev, PartUIDUpper,
+		pNvmInfo->PartUIDUpper);
+	VL53L0X_SETDEVICESPECIFICPARAMETER(Dev, PartUIDLower,
+		pNvmInfo->PartUIDLower);
+	VL53L0X_SETDEVICESPECIFICPARAMETER(Dev, ModuleId, pNvmInfo->ModuleId);
+	VL53L0X_SETDEVICESPECIFICPARAMETER(Dev, Revision, pNvmInfo->Revision);
+	ProductId_tmp = VL53L0X_GETDEVICESPECIFICPARAMETER(Dev, ProductId);
+	VL53L0X_COPYSTRING(ProductId_tmp, pNvmInfo->ProductId);
+	VL53L0X_SETDEVICESPECIFICPARAMETER(Dev, ReferenceSpadCount,
+		pNvmInfo->ReferenceSpadCount);
+	VL53L0X_SETDEVICESPECIFICPARAMETER(Dev, ReferenceSpadType,
+		pNvmInfo->ReferenceSpadType);
+	for (i = 0; i < VL53L0X_REF_SPAD_BUFFER_SIZE; i++)
+		Dev->Data.SpadData.RefGoodSpadMap[i] =
+			pNvmInfo->RefGoodSpadMap[i];
+	VL53L0X_SETDEVICESPECIFICPARAMETER(Dev, SignalRateMeasFixed400mm,
+		pNvmInfo->SignalRateMeasFixed400mm);
+	PALDevDataSet(Dev, Part2PartOffsetAdjustmentNVMMicroMeter,
+		pNvmInfo->Part2PartOffsetAdjustmentNVMMicroMeter);
+
+	/* Everything VL53L0X_get_info_from_device() would read is now known */
+	VL53L0X_SETDEVICESPECIFICPARAMETER(Dev, ReadDataFromDeviceDone, 7);
+
+	LOG_FUNCTION_END(VL53L0X_ERROR_NONE);
+}
+
 
 uint32_t VL53L0X_calc_macro_period_ps(VL53L0X_DEV Dev,
 				      uint8_t vcsel_period_pclks)
@@ -1370,6 +1493,10 @@ VL53L0X_Error VL53L0X_load_tuning_settings(VL53L0X_DEV Dev,
 
 	Index = 0;
 
+	/* The tuning table is a long run of writes; queue them and let the
+	 * platform send them in as few bus sessions as it can. */
+	VL53L0X_BeginBatch(Dev);
+
 	while ((*(pTuningSettingBuffer + Index) != 0) &&
 			(Status == VL53L0X_ERROR_NONE)) {
 		NumberOfWrites = *(pTuningSettingBuffer + Index);
@@ -1434,6 +1561,11 @@ VL53L0X_Error VL53L0X_load_tuning_settings(VL53L0X_DEV Dev,
 		}
 	}
 
+	if (Status == VL53L0X_ERROR_NONE)
+		Status = VL53L0X_EndBatch(Dev);
+	else
+		VL53L0X_EndBatch(Dev);
+
 	LOG_FUNCTION_END(Status);
 	return Status;
 }
@@ -1529,7 +1661,7 @@ VL53L0X_Error get_dmax_lut_points(VL53L0X_DMaxLUT_t data, uint32_t lut_size,
 VL53L0X_Error VL53L0X_calc_dmax(
 	VL53L0X_DEV Dev, FixPoint1616_t ambRateMeas, uint32_t *pdmax_mm){
 	VL53L0X_Error Status = VL53L0X_ERROR_NONE;
-	VL53L0X_DeviceParameters_t CurrentParameters;
+	const VL53L0X_DeviceParameters_t *pCurrentParameters;
 	int32_t index0 = 0;
 	int32_t index1 = 0;
 	FixPoint1616_t amb0, amb1, dmax0, dmax1;
@@ -1538,27 +1670,30 @@ VL53L0X_Error VL53L0X_calc_dmax(
 
 	LOG_FUNCTION_START("");
 
-	Status = VL53L0X_GetDeviceParameters(Dev, &CurrentParameters);
+	/* The LUT only changes through the setters, so read it from the
+	 * parameter snapshot rather than VL53L0X_GetDeviceParameters(), which
+	 * goes back to the device for everything else it returns */
+	pCurrentParameters = &PALDevDataGet(Dev, CurrentParameters);
 
-	if (ambRateMeas <= CurrentParameters.dmax_lut.ambRate_mcps[0]) {
-		dmax_mm = CurrentParameters.dmax_lut.dmax_mm[0];
+	if (ambRateMeas <= pCurrentParameters->dmax_lut.ambRate_mcps[0]) {
+		dmax_mm = pCurrentParameters->dmax_lut.dmax_mm[0];
 	} else if (ambRateMeas >=
-		   CurrentParameters.dmax_lut.
+		   pCurrentParameters->dmax_lut.
 		   ambRate_mcps[VL53L0X_DMAX_LUT_SIZE - 1]) {
 		dmax_mm =
-		    CurrentParameters.dmax_lut.dmax_mm[VL53L0X_DMAX_LUT_SIZE -
+		    pCurrentParameters->dmax_lut.dmax_mm[VL53L0X_DMAX_LUT_SIZE -
 						       1];
 	} else{
-		get_dmax_lut_points(CurrentParameters.dmax_lut,
+		get_dmax_lut_points(pCurrentParameters->dmax_lut,
 			VL53L0X_DMAX_LUT_SIZE, ambRateMeas, &index0, &index1);
 
 		if (index0 == index1) {
-			dmax_mm = CurrentParameters.dmax_lut.dmax_mm[index0];
+			dmax_mm = pCurrentParameters->dmax_lut.dmax_mm[index0];
 		} else {
-			amb0 = CurrentParameters.dmax_lut.ambRate_mcps[index0];
-			amb1 = CurrentParameters.dmax_lut.ambRate_mcps[index1];
-			dmax0 = CurrentParameters.dmax_lut.dmax_mm[index0];
-			dmax1 = CurrentParameters.dmax_lut.dmax_mm[index1];
+			amb0 = pCurrentParameters->dmax_lut.ambRate_mcps[index0];
+			amb1 = pCurrentParameters->dmax_lut.ambRate_mcps[index1];
+			dmax0 = pCurrentParameters->dmax_lut.dmax_mm[index0];
+			dmax1 = pCurrentParameters->dmax_lut.dmax_mm[index1];
 			if ((amb1 - amb0) != 0) {
 				/* Fix16:16/Fix16:8 => Fix16:8 */
 				linearSlope = (dmax0-dmax1)/((amb1-amb0) >> 8);
@@ -52,6 +52,35 @@ uint32_t VL53L0X_quadrature_sum(uint32_t a, uint32_t b);
 
 VL53L0X_Error VL53L0X_get_info_from_device(VL53L0X_DEV Dev, uint8_t option);
 
+/* Everything VL53L0X_get_info_from_device() decodes from NVM. It is fixed
+ * per part, so a host may keep it and hand it back instead of re-reading. */
+typedef struct {
+	uint32_t PartUIDUpper;
+	uint32_t PartUIDLower;
+	uint8_t ModuleId;
+	uint8_t Revision;
+	char ProductId[VL53L0X_MAX_STRING_LENGTH];
+	uint8_t ReferenceSpadCount;
+	uint8_t ReferenceSpadType;
+	uint8_t RefGoodSpadMap[VL53L0X_REF_SPAD_BUFFER_SIZE];
+	FixPoint1616_t SignalRateMeasFixed400mm;
+	int32_t Part2PartOffsetAdjustmentNVMMicroMeter;
+} VL53L0X_DeviceNvmInfo_t;
+
+/* Reads just the part UID, two NVM words rather than all of them */
+VL53L0X_Error VL53L0X_read_part_uid(VL53L0X_DEV Dev,
+	uint32_t *pPartUIDUpper, uint32_t *pPartUIDLower);
+
+/* Reads all NVM info (unless already read since VL53L0X_DataInit()) and
+ * copies it out */
+VL53L0X_Error VL53L0X_get_nvm_info(VL53L0X_DEV Dev,
+	VL53L0X_DeviceNvmInfo_t *pNvmInfo);
+
+/* Restores NVM info saved from VL53L0X_get_nvm_info() on the same part, after
+ * VL53L0X_DataInit(). Later API calls will then not read the NVM. */
+void VL53L0X_set_nvm_info(VL53L0X_DEV Dev,
+	const VL53L0X_DeviceNvmInfo_t *pNvmInfo);
+
 VL53L0X_Error VL53L0X_set_vcsel_pulse_period(VL53L0X_DEV Dev,
 	VL53L0X_VcselPeriod VcselPeriodType, uint8_t VCSELPulsePeriodPCLK);
 
@@ -41,7 +41,9 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include <rom/ets_sys.h>
+#include <esp_timer.h>
 #include <M5Unified.h>
+#include "i2c_trace.hpp"
 
 
 
@@ -53,6 +55,21 @@
 #define STATUS_OK              0x00
 #define STATUS_FAIL            0x01
 
+#define I2C_FREQ_HZ            400000
+
+static uint32_t transaction_count = 0;
+static uint64_t bus_time_us = 0;
+
+uint32_t VL53L0X_get_transaction_count(void)
+{
+    return transaction_count;
+}
+
+uint64_t VL53L0X_get_bus_time_us(void)
+{
+    return bus_time_us;
+}
+
 int32_t VL53L0X_comms_initialise(uint8_t comms_type, uint16_t comms_speed_khz)
 {
    
@@ -88,7 +105,13 @@ int32_t VL53L0X_write_multi(uint8_t address, uint8_t index, uint8_t *pdata, int3
     trace_i2c("Write addr %02X, reg : 0x%04X, Val : 0x%s\n", address, index, value_as_str);
 #endif
 
-    if (!M5.Ex_I2C.writeRegister(address, index, pdata, count, 400000)) {
+    transaction_count++;
+    int64_t trace_start = i2c_trace_start();
+    int64_t start_us = esp_timer_get_time();
+    bool ok = M5.Ex_I2C.writeRegister(address, index, pdata, count, I2C_FREQ_HZ);
+    bus_time_us += esp_timer_get_time() - start_us;
+    i2c_trace_write(trace_start, index, pdata, count, 0, ok);
+    if (!ok) {
         return STATUS_FAIL;
     }
     return status;
@@ -104,7 +127,13 @@ int32_t VL53L0X_read_multi(uint8_t address, uint8_t index, uint8_t *pdata, int32
     char *pvalue_as_str;
 #endif
 
-    if (!(M5.Ex_I2C.readRegister(address, index, pdata, count, 400000))) {
+    transaction_count++;
+    int64_t trace_start = i2c_trace_start();
+    int64_t start_us = esp_timer_get_time();
+    bool ok = M5.Ex_I2C.readRegister(address, index, pdata, count, I2C_FREQ_HZ);
+    bus_time_us += esp_timer_get_time() - start_us;
+    i2c_trace_read(trace_start, index, count, ok);
+    if (!ok) {
         return STATUS_FAIL;
     }
 #ifdef VL53L0X_LOG_ENABLE
@@ -123,6 +152,55 @@ int32_t VL53L0X_read_multi(uint8_t address, uint8_t index, uint8_t *pdata, int32
     return status;
 }
 
+int32_t VL53L0X_write_batch(uint8_t address, uint8_t *pqueue, int32_t size)
+{
+    int32_t status = STATUS_OK;
+    int32_t pos = 0;
+    bool ok = true;
+    int64_t start_us = esp_timer_get_time();
+
+    transaction_count++;
+    while (ok && pos + 2 <= size) {
+        uint8_t index = pqueue[pos];
+        uint8_t count = pqueue[pos + 1];
+
+#ifdef VL53L0X_LOG_ENABLE
+        int32_t i = 0;
+        char value_as_str[VL53L0X_MAX_STRING_LENGTH_PLT];
+        char *pvalue_as_str;
+
+        pvalue_as_str =  value_as_str;
+
+        for(i = 0 ; i < count ; i++)
+        {
+            sprintf(pvalue_as_str,"%02X", pqueue[pos + 2 + i]);
+
+            pvalue_as_str += 2;
+        }
+        trace_i2c("Write addr %02X, reg : 0x%04X, Val : 0x%s (batched)\n", address, index, value_as_str);
+#endif
+
+        // The first record opens the session, the rest ride on repeated starts.
+        int64_t trace_start = i2c_trace_start();
+        if (pos == 0) {
+            ok = M5.Ex_I2C.start(address, false, I2C_FREQ_HZ);
+        } else {
+            ok = M5.Ex_I2C.restart(address, false, I2C_FREQ_HZ);
+        }
+        ok = ok && M5.Ex_I2C.write(index);
+        ok = ok && M5.Ex_I2C.write(&pqueue[pos + 2], count);
+        i2c_trace_write(trace_start, index, &pqueue[pos + 2], count, I2C_TRACE_BATCHED, ok);
+        pos += 2 + count;
+    }
+    // Always release the bus, even after a NACK.
+    ok = M5.Ex_I2C.stop() && ok;
+    bus_time_us += esp_timer_get_time() - start_us;
+
+    if (!ok) {
+        status = STATUS_FAIL;
+    }
+    return status;
+}
 
 int32_t VL53L0X_write_byte(uint8_t address, uint8_t index, uint8_t data)
 {
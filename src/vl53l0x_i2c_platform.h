@@ -121,6 +121,45 @@ int32_t VL53L0X_cycle_power(void);
 int32_t VL53L0X_write_multi(uint8_t address, uint8_t index, uint8_t  *pdata, int32_t count);
 
 
+/**
+ * @brief Writes a queue of register writes to the device in one bus session
+ *
+ * The queue is a packed sequence of records, each one byte of register index,
+ * one byte of length and then that many data bytes. Records are sent back to
+ * back separated by repeated starts, so the whole queue costs a single
+ * START ... STOP on the bus.
+ *
+ * @param  address - uint8_t device address value
+ * @param  pqueue - pointer to the packed record queue
+ * @param  size - total size of the queue in bytes
+ *
+ * @return status - status 0 = ok, 1 = error
+ *
+ */
+
+int32_t VL53L0X_write_batch(uint8_t address, uint8_t *pqueue, int32_t size);
+
+
+/**
+ * @brief Number of bus transactions (START ... STOP sessions) issued so far
+ *
+ * @return running count, wraps at 2^32
+ *
+ */
+
+uint32_t VL53L0X_get_transaction_count(void);
+
+
+/**
+ * @brief Time spent on the bus by those transactions
+ *
+ * @return running total in microseconds
+ *
+ */
+
+uint64_t VL53L0X_get_bus_time_us(void);
+
+
 /**
  * @brief  Reads the requested number of bytes from the device
  *
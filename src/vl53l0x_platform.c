@@ -37,8 +37,11 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "vl53l0x_platform.h"
 #include "vl53l0x_i2c_platform.h"
 #include "vl53l0x_api.h"
+#ifdef ESP_PLATFORM
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#endif
+#include <string.h>
 
 #define LOG_FUNCTION_START(fmt, ... )           _LOG_FUNCTION_START(TRACE_MODULE_PLATFORM, fmt, ##__VA_ARGS__)
 #define LOG_FUNCTION_END(status, ... )          _LOG_FUNCTION_END(TRACE_MODULE_PLATFORM, status, ##__VA_ARGS__)
@@ -102,6 +105,205 @@ VL53L0X_Error VL53L0X_UnlockSequenceAccess(VL53L0X_DEV Dev){
     return Status;
 }
 
+static uint32_t shadow_hits = 0;
+static uint32_t register_reads = 0;
+static uint32_t polling_delays = 0;
+
+uint32_t VL53L0X_GetShadowHitCount(void){
+    return shadow_hits;
+}
+
+uint32_t VL53L0X_GetRegisterReadCount(void){
+    return register_reads;
+}
+
+uint32_t VL53L0X_GetPollingDelayCount(void){
+    return polling_delays;
+}
+
+/* Page 0 registers the device never changes on its own. Everything else
+ * (results, interrupt status, start/stop, NVM access) always goes to the bus. */
+static int shadow_cacheable(uint32_t index){
+    switch (index) {
+    case VL53L0X_REG_SYSTEM_SEQUENCE_CONFIG:
+    case VL53L0X_REG_SYSTEM_INTERMEASUREMENT_PERIOD:
+    case VL53L0X_REG_SYSTEM_INTERMEASUREMENT_PERIOD + 1:
+    case VL53L0X_REG_SYSTEM_INTERMEASUREMENT_PERIOD + 2:
+    case VL53L0X_REG_SYSTEM_INTERMEASUREMENT_PERIOD + 3:
+    case VL53L0X_REG_SYSTEM_RANGE_CONFIG:
+    case VL53L0X_REG_SYSTEM_INTERRUPT_CONFIG_GPIO:
+    case VL53L0X_REG_SYSTEM_THRESH_HIGH:
+    case VL53L0X_REG_SYSTEM_THRESH_HIGH + 1:
+    case VL53L0X_REG_SYSTEM_THRESH_LOW:
+    case VL53L0X_REG_SYSTEM_THRESH_LOW + 1:
+    case VL53L0X_REG_CROSSTALK_COMPENSATION_PEAK_RATE_MCPS:
+    case VL53L0X_REG_CROSSTALK_COMPENSATION_PEAK_RATE_MCPS + 1:
+    case VL53L0X_REG_PRE_RANGE_CONFIG_MIN_SNR:
+    case VL53L0X_REG_ALGO_PART_TO_PART_RANGE_OFFSET_MM:
+    case VL53L0X_REG_ALGO_PART_TO_PART_RANGE_OFFSET_MM + 1:
+    case VL53L0X_REG_GLOBAL_CONFIG_VCSEL_WIDTH:
+    case VL53L0X_REG_FINAL_RANGE_CONFIG_MIN_COUNT_RATE_RTN_LIMIT:
+    case VL53L0X_REG_FINAL_RANGE_CONFIG_MIN_COUNT_RATE_RTN_LIMIT + 1:
+    case VL53L0X_REG_MSRC_CONFIG_TIMEOUT_MACROP:
+    case VL53L0X_REG_FINAL_RANGE_CONFIG_VALID_PHASE_LOW:
+    case VL53L0X_REG_FINAL_RANGE_CONFIG_VALID_PHASE_HIGH:
+    case VL53L0X_REG_PRE_RANGE_CONFIG_VCSEL_PERIOD:
+    case VL53L0X_REG_PRE_RANGE_CONFIG_TIMEOUT_MACROP_HI:
+    case VL53L0X_REG_PRE_RANGE_CONFIG_TIMEOUT_MACROP_LO:
+    case VL53L0X_REG_PRE_RANGE_CONFIG_VALID_PHASE_LOW:
+    case VL53L0X_REG_PRE_RANGE_CONFIG_VALID_PHASE_HIGH:
+    case VL53L0X_REG_MSRC_CONFIG_CONTROL:
+    case VL53L0X_REG_PRE_RANGE_CONFIG_SIGMA_THRESH_HI:
+    case VL53L0X_REG_PRE_RANGE_CONFIG_SIGMA_THRESH_LO:
+    case VL53L0X_REG_PRE_RANGE_MIN_COUNT_RATE_RTN_LIMIT:
+    case VL53L0X_REG_PRE_RANGE_MIN_COUNT_RATE_RTN_LIMIT + 1:
+    case VL53L0X_REG_FINAL_RANGE_CONFIG_MIN_SNR:
+    case VL53L0X_REG_FINAL_RANGE_CONFIG_VCSEL_PERIOD:
+    case VL53L0X_REG_FINAL_RANGE_CONFIG_TIMEOUT_MACROP_HI:
+    case VL53L0X_REG_FINAL_RANGE_CONFIG_TIMEOUT_MACROP_LO:
+    case VL53L0X_REG_GPIO_HV_MUX_ACTIVE_HIGH:
+    case VL53L0X_REG_OSC_CALIBRATE_VAL:
+    case VL53L0X_REG_OSC_CALIBRATE_VAL + 1:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* Shadowed values are only good on page 0 with the internal registers
+ * closed; anything else may alias the same indexes. */
+static int shadow_active(VL53L0X_DEV Dev){
+    return Dev->ShadowPage == 0 && Dev->ShadowPowerForce == 0;
+}
+
+void VL53L0X_ShadowInvalidate(VL53L0X_DEV Dev){
+    memset(Dev->ShadowValid, 0, sizeof(Dev->ShadowValid));
+}
+
+static int shadow_read(VL53L0X_DEV Dev, uint8_t index, uint8_t *pdata, uint32_t count){
+    uint32_t i, reg;
+
+    if (!shadow_active(Dev))
+        return 0;
+
+    for (i = 0; i < count; i++) {
+        reg = index + i;
+        if (reg > 0xFF || !shadow_cacheable(reg) ||
+            !(Dev->ShadowValid[reg / 32] & (1u << (reg % 32))))
+            return 0;
+    }
+    memcpy(pdata, &Dev->ShadowRegs[index], count);
+    shadow_hits++;
+    return 1;
+}
+
+static void shadow_fill(VL53L0X_DEV Dev, uint8_t index, const uint8_t *pdata, uint32_t count){
+    uint32_t i, reg;
+
+    if (!shadow_active(Dev))
+        return;
+
+    for (i = 0; i < count && index + i <= 0xFF; i++) {
+        reg = index + i;
+        if (shadow_cacheable(reg)) {
+            Dev->ShadowRegs[reg] = pdata[i];
+            Dev->ShadowValid[reg / 32] |= 1u << (reg % 32);
+        }
+    }
+}
+
+/* Called for every write, sent or queued, to follow the page and keep the
+ * shadow current */
+static void shadow_write(VL53L0X_DEV Dev, uint8_t index, const uint8_t *pdata, uint32_t count){
+    uint32_t i, reg;
+
+    for (i = 0; i < count && index + i <= 0xFF; i++) {
+        reg = index + i;
+        if (reg == 0xFF) {
+            Dev->ShadowPage = pdata[i];
+        } else if (Dev->ShadowPage != 0) {
+            continue;
+        } else if (reg == VL53L0X_REG_POWER_MANAGEMENT_GO1_POWER_FORCE) {
+            Dev->ShadowPowerForce = pdata[i];
+        } else if (reg == VL53L0X_REG_SOFT_RESET_GO2_SOFT_RESET_N) {
+            VL53L0X_ShadowInvalidate(Dev);
+        } else if (shadow_cacheable(reg)) {
+            if (Dev->ShadowPowerForce == 0) {
+                Dev->ShadowRegs[reg] = pdata[i];
+                Dev->ShadowValid[reg / 32] |= 1u << (reg % 32);
+            } else {
+                Dev->ShadowValid[reg / 32] &= ~(1u << (reg % 32));
+            }
+        }
+    }
+}
+
+static VL53L0X_Error batch_flush(VL53L0X_DEV Dev){
+    VL53L0X_Error Status = VL53L0X_ERROR_NONE;
+    int32_t status_int;
+
+    if (Dev->BatchSize == 0)
+        return Status;
+
+    status_int = VL53L0X_write_batch(Dev->I2cDevAddr, Dev->BatchQueue, Dev->BatchSize);
+    Dev->BatchSize = 0;
+
+    /* The shadow already has the queued values; not all of them landed */
+    if (status_int != 0) {
+        VL53L0X_ShadowInvalidate(Dev);
+        Status = VL53L0X_ERROR_CONTROL_INTERFACE;
+    }
+
+    return Status;
+}
+
+static VL53L0X_Error batch_write(VL53L0X_DEV Dev, uint8_t index, uint8_t *pdata, uint32_t count){
+    VL53L0X_Error Status = VL53L0X_ERROR_NONE;
+    uint8_t *last;
+
+    if (Dev->BatchSize > 0) {
+        last = &Dev->BatchQueue[Dev->BatchLastRecord];
+        /* Extend the previous record when this write picks up at the next
+         * index. 0xFF is the page select so it never takes part in a burst. */
+        if (index != 0xFF && (uint32_t)last[0] + last[1] == index &&
+            last[1] + count < VL53L0X_MAX_I2C_XFER_SIZE &&
+            Dev->BatchSize + count <= VL53L0X_BATCH_QUEUE_SIZE) {
+            memcpy(&Dev->BatchQueue[Dev->BatchSize], pdata, count);
+            last[1] += count;
+            Dev->BatchSize += count;
+            return Status;
+        }
+    }
+
+    if (Dev->BatchSize + 2 + count > VL53L0X_BATCH_QUEUE_SIZE)
+        Status = batch_flush(Dev);
+
+    Dev->BatchLastRecord = Dev->BatchSize;
+    Dev->BatchQueue[Dev->BatchSize] = index;
+    Dev->BatchQueue[Dev->BatchSize + 1] = (uint8_t)count;
+    memcpy(&Dev->BatchQueue[Dev->BatchSize + 2], pdata, count);
+    Dev->BatchSize += 2 + count;
+
+    return Status;
+}
+
+VL53L0X_Error VL53L0X_BeginBatch(VL53L0X_DEV Dev){
+    Dev->BatchDepth++;
+    return VL53L0X_ERROR_NONE;
+}
+
+VL53L0X_Error VL53L0X_EndBatch(VL53L0X_DEV Dev){
+    VL53L0X_Error Status = VL53L0X_ERROR_NONE;
+
+    if (Dev->BatchDepth > 0)
+        Dev->BatchDepth--;
+
+    if (Dev->BatchDepth == 0)
+        Status = batch_flush(Dev);
+
+    return Status;
+}
+
 // the ranging_sensor_comms.dll will take care of the page selection
 VL53L0X_Error VL53L0X_WriteMulti(VL53L0X_DEV Dev, uint8_t index, uint8_t *pdata, uint32_t count){
 
@@ -113,12 +315,23 @@ VL53L0X_Error VL53L0X_WriteMulti(VL53L0X_DEV Dev, uint8_t index, uint8_t *pdata,
         Status = VL53L0X_ERROR_INVALID_PARAMS;
     }
 
+    shadow_write(Dev, index, pdata, count);
+
+    if (Dev->BatchDepth > 0 && count + 2 <= VL53L0X_BATCH_QUEUE_SIZE)
+        return batch_write(Dev, index, pdata, count);
+
+    if (batch_flush(Dev) != VL53L0X_ERROR_NONE) {
+        return VL53L0X_ERROR_CONTROL_INTERFACE;
+    }
+
 	deviceAddress = Dev->I2cDevAddr;
 
 	status_int = VL53L0X_write_multi(deviceAddress, index, pdata, count);
 
-	if (status_int != 0)
+	if (status_int != 0) {
+		VL53L0X_ShadowInvalidate(Dev);
 		Status = VL53L0X_ERROR_CONTROL_INTERFACE;
+	}
 
     return Status;
 }
@@ -129,17 +342,29 @@ VL53L0X_Error VL53L0X_ReadMulti(VL53L0X_DEV Dev, uint8_t index, uint8_t *pdata,
     VL53L0X_Error Status = VL53L0X_ERROR_NONE;
     int32_t status_int;
 	uint8_t deviceAddress;
+    register_reads++;
 
     if (count>=VL53L0X_MAX_I2C_XFER_SIZE){
         Status = VL53L0X_ERROR_INVALID_PARAMS;
     }
 
+    if (shadow_read(Dev, index, pdata, count))
+        return Status;
+
+    if (batch_flush(Dev) != VL53L0X_ERROR_NONE) {
+        return VL53L0X_ERROR_CONTROL_INTERFACE;
+    }
+
     deviceAddress = Dev->I2cDevAddr;
 
 	status_int = VL53L0X_read_multi(deviceAddress, index, pdata, count);
 
-	if (status_int != 0)
+	if (status_int != 0) {
+		VL53L0X_ShadowInvalidate(Dev);
 		Status = VL53L0X_ERROR_CONTROL_INTERFACE;
+	} else {
+		shadow_fill(Dev, index, pdata, count);
+	}
 
     return Status;
 }
@@ -150,12 +375,23 @@ VL53L0X_Error VL53L0X_WrByte(VL53L0X_DEV Dev, uint8_t index, uint8_t data){
     int32_t status_int;
 	uint8_t deviceAddress;
 
+    shadow_write(Dev, index, &data, 1);
+
+    if (Dev->BatchDepth > 0)
+        return batch_write(Dev, index, &data, 1);
+
+    Status = batch_flush(Dev);
+    if (Status != VL53L0X_ERROR_NONE)
+        return Status;
+
     deviceAddress = Dev->I2cDevAddr;
 
 	status_int = VL53L0X_write_byte(deviceAddress, index, data);
 
-	if (status_int != 0)
+	if (status_int != 0) {
+		VL53L0X_ShadowInvalidate(Dev);
 		Status = VL53L0X_ERROR_CONTROL_INTERFACE;
+	}
 
     return Status;
 }
@@ -164,13 +400,27 @@ VL53L0X_Error VL53L0X_WrWord(VL53L0X_DEV Dev, uint8_t index, uint16_t data){
     VL53L0X_Error Status = VL53L0X_ERROR_NONE;
     int32_t status_int;
 	uint8_t deviceAddress;
+    uint8_t buffer[BYTES_PER_WORD];
+
+    buffer[0] = (uint8_t)(data >> 8);
+    buffer[1] = (uint8_t)(data &  0x00FF);
+    shadow_write(Dev, index, buffer, BYTES_PER_WORD);
+
+    if (Dev->BatchDepth > 0)
+        return batch_write(Dev, index, buffer, BYTES_PER_WORD);
+
+    Status = batch_flush(Dev);
+    if (Status != VL53L0X_ERROR_NONE)
+        return Status;
 
     deviceAddress = Dev->I2cDevAddr;
 
 	status_int = VL53L0X_write_word(deviceAddress, index, data);
 
-	if (status_int != 0)
+	if (status_int != 0) {
+		VL53L0X_ShadowInvalidate(Dev);
 		Status = VL53L0X_ERROR_CONTROL_INTERFACE;
+	}
 
     return Status;
 }
@@ -179,13 +429,29 @@ VL53L0X_Error VL53L0X_WrDWord(VL53L0X_DEV Dev, uint8_t index, uint32_t data){
     VL53L0X_Error Status = VL53L0X_ERROR_NONE;
     int32_t status_int;
 	uint8_t deviceAddress;
+    uint8_t buffer[BYTES_PER_DWORD];
+
+    buffer[0] = (uint8_t) (data >> 24);
+    buffer[1] = (uint8_t)((data &  0x00FF0000) >> 16);
+    buffer[2] = (uint8_t)((data &  0x0000FF00) >> 8);
+    buffer[3] = (uint8_t) (data &  0x000000FF);
+    shadow_write(Dev, index, buffer, BYTES_PER_DWORD);
+
+    if (Dev->BatchDepth > 0)
+        return batch_write(Dev, index, buffer, BYTES_PER_DWORD);
+
+    Status = batch_flush(Dev);
+    if (Status != VL53L0X_ERROR_NONE)
+        return Status;
 
     deviceAddress = Dev->I2cDevAddr;
 
 	status_int = VL53L0X_write_dword(deviceAddress, index, data);
 
-	if (status_int != 0)
+	if (status_int != 0) {
+		VL53L0X_ShadowInvalidate(Dev);
 		Status = VL53L0X_ERROR_CONTROL_INTERFACE;
+	}
 
     return Status;
 }
@@ -195,20 +461,28 @@ VL53L0X_Error VL53L0X_UpdateByte(VL53L0X_DEV Dev, uint8_t index, uint8_t AndData
     int32_t status_int;
     uint8_t deviceAddress;
     uint8_t data;
+    register_reads++;
 
     deviceAddress = Dev->I2cDevAddr;
 
-    status_int = VL53L0X_read_byte(deviceAddress, index, &data);
+    /* A shadowed register needs no read, so an open batch stays open */
+    if (!shadow_read(Dev, index, &data, 1)) {
+        Status = batch_flush(Dev);
+        if (Status != VL53L0X_ERROR_NONE)
+            return Status;
 
-    if (status_int != 0)
-        Status = VL53L0X_ERROR_CONTROL_INTERFACE;
+        status_int = VL53L0X_read_byte(deviceAddress, index, &data);
+
+        if (status_int != 0) {
+            VL53L0X_ShadowInvalidate(Dev);
+            Status = VL53L0X_ERROR_CONTROL_INTERFACE;
+        }
+    }
 
     if (Status == VL53L0X_ERROR_NONE) {
         data = (data & AndData) | OrData;
-        status_int = VL53L0X_write_byte(deviceAddress, index, data);
-
-        if (status_int != 0)
-            Status = VL53L0X_ERROR_CONTROL_INTERFACE;
+        /* queued if a batch is open */
+        Status = VL53L0X_WrByte(Dev, index, data);
     }
 
     return Status;
@@ -218,13 +492,25 @@ VL53L0X_Error VL53L0X_RdByte(VL53L0X_DEV Dev, uint8_t index, uint8_t *data){
     VL53L0X_Error Status = VL53L0X_ERROR_NONE;
     int32_t status_int;
     uint8_t deviceAddress;
+    register_reads++;
+
+    if (shadow_read(Dev, index, data, 1))
+        return Status;
 
     deviceAddress = Dev->I2cDevAddr;
 
+    Status = batch_flush(Dev);
+    if (Status != VL53L0X_ERROR_NONE)
+        return Status;
+
     status_int = VL53L0X_read_byte(deviceAddress, index, data);
 
-    if (status_int != 0)
+    if (status_int != 0) {
+        VL53L0X_ShadowInvalidate(Dev);
         Status = VL53L0X_ERROR_CONTROL_INTERFACE;
+    } else {
+        shadow_fill(Dev, index, data, 1);
+    }
 
     return Status;
 }
@@ -233,28 +519,65 @@ VL53L0X_Error VL53L0X_RdWord(VL53L0X_DEV Dev, uint8_t index, uint16_t *data){
     VL53L0X_Error Status = VL53L0X_ERROR_NONE;
     int32_t status_int;
     uint8_t deviceAddress;
+    uint8_t buffer[BYTES_PER_WORD];
+    register_reads++;
+
+    if (shadow_read(Dev, index, buffer, BYTES_PER_WORD)) {
+        *data = ((uint16_t)buffer[0] << 8) | buffer[1];
+        return Status;
+    }
 
     deviceAddress = Dev->I2cDevAddr;
 
+    Status = batch_flush(Dev);
+    if (Status != VL53L0X_ERROR_NONE)
+        return Status;
+
     status_int = VL53L0X_read_word(deviceAddress, index, data);
 
-    if (status_int != 0)
+    if (status_int != 0) {
+        VL53L0X_ShadowInvalidate(Dev);
         Status = VL53L0X_ERROR_CONTROL_INTERFACE;
+    } else {
+        buffer[0] = (uint8_t)(*data >> 8);
+        buffer[1] = (uint8_t)(*data & 0x00FF);
+        shadow_fill(Dev, index, buffer, BYTES_PER_WORD);
+    }
 
     return Status;
 }
 
-VL53L0X_Error  VL53L0X_RdDWord(VL53L0X_DEV Dev, uint8_t index, uint32_t *data){
+VL53L0X_Error VL53L0X_RdDWord(VL53L0X_DEV Dev, uint8_t index, uint32_t *data){
     VL53L0X_Error Status = VL53L0X_ERROR_NONE;
     int32_t status_int;
     uint8_t deviceAddress;
+    uint8_t buffer[BYTES_PER_DWORD];
+    register_reads++;
+
+    if (shadow_read(Dev, index, buffer, BYTES_PER_DWORD)) {
+        *data = ((uint32_t)buffer[0] << 24) | ((uint32_t)buffer[1] << 16) |
+                ((uint32_t)buffer[2] << 8) | buffer[3];
+        return Status;
+    }
 
     deviceAddress = Dev->I2cDevAddr;
 
+    Status = batch_flush(Dev);
+    if (Status != VL53L0X_ERROR_NONE)
+        return Status;
+
     status_int = VL53L0X_read_dword(deviceAddress, index, data);
 
-    if (status_int != 0)
+    if (status_int != 0) {
+        VL53L0X_ShadowInvalidate(Dev);
         Status = VL53L0X_ERROR_CONTROL_INTERFACE;
+    } else {
+        buffer[0] = (uint8_t) (*data >> 24);
+        buffer[1] = (uint8_t)((*data & 0x00FF0000) >> 16);
+        buffer[2] = (uint8_t)((*data & 0x0000FF00) >> 8);
+        buffer[3] = (uint8_t) (*data & 0x000000FF);
+        shadow_fill(Dev, index, buffer, BYTES_PER_DWORD);
+    }
 
     return Status;
 }
@@ -264,8 +587,14 @@ VL53L0X_Error VL53L0X_PollingDelay(VL53L0X_DEV Dev){
     VL53L0X_Error status = VL53L0X_ERROR_NONE;
     LOG_FUNCTION_START("");
 
+    polling_delays++;
+#ifdef ESP_PLATFORM
     // vTaskDelay(pdMS_TO_TICKS(1));
     vTaskDelay(1);
+#else
+    // Host builds run against the simulator, whose clock only moves when told.
+    VL53L0X_wait_ms(1);
+#endif
 
     LOG_FUNCTION_END(status);
     return status;
@@ -55,6 +55,9 @@ extern "C" {
  * @brief    Generic PAL device type that does link between API and platform abstraction layer
  *
  */
+/** Size of the per device register write queue, see VL53L0X_BeginBatch() */
+#define VL53L0X_BATCH_QUEUE_SIZE 128
+
 typedef struct {
     VL53L0X_DevData_t Data;               /*!< embed ST Ewok Dev  data as "Data"*/
 
@@ -63,6 +66,18 @@ typedef struct {
     uint8_t   comms_type;                /*!< Type of comms : VL53L0X_COMMS_I2C or VL53L0X_COMMS_SPI */
     uint16_t  comms_speed_khz;           /*!< Comms speed [kHz] : typically 400kHz for I2C           */
 
+    /*!< register write batching, must be zeroed before VL53L0X_DataInit() */
+    uint8_t   BatchDepth;                /*!< Nesting depth of open batches, 0 writes straight through */
+    uint8_t   BatchSize;                 /*!< Bytes used in BatchQueue */
+    uint8_t   BatchLastRecord;           /*!< Offset of the last record in BatchQueue */
+    uint8_t   BatchQueue[VL53L0X_BATCH_QUEUE_SIZE]; /*!< Pending writes as {index, count, data...} records */
+
+    /*!< shadow of static configuration registers, must be zeroed before VL53L0X_DataInit() */
+    uint8_t   ShadowPage;                /*!< Last value written to the page select 0xFF */
+    uint8_t   ShadowPowerForce;          /*!< Last value written to 0x80, non zero opens the internal registers */
+    uint32_t  ShadowValid[8];            /*!< One bit per page 0 register, set when ShadowRegs holds its value */
+    uint8_t   ShadowRegs[256];           /*!< Write-through copies of page 0 registers */
+
 } VL53L0X_Dev_t;
 
 
@@ -212,6 +227,60 @@ VL53L0X_Error VL53L0X_RdDWord(VL53L0X_DEV Dev, uint8_t index, uint32_t *data);
  */
 VL53L0X_Error VL53L0X_UpdateByte(VL53L0X_DEV Dev, uint8_t index, uint8_t AndData, uint8_t OrData);
 
+/**
+ * Start queueing register writes instead of sending them one transaction each
+ *
+ * Until the matching VL53L0X_EndBatch() all writes are queued in the device.
+ * Writes which continue at the next register index are merged into one burst
+ * and the queue is flushed as a single bus session. Any read flushes the queue
+ * first so reads always observe earlier writes. Batches may be nested.
+ * @param   Dev       Device Handle
+ * @return  VL53L0X_ERROR_NONE        Success
+ * @return  "Other error code"    See ::VL53L0X_Error
+ */
+VL53L0X_Error VL53L0X_BeginBatch(VL53L0X_DEV Dev);
+
+/**
+ * Close a batch opened with VL53L0X_BeginBatch(), flushing the queue when the
+ * outermost batch closes
+ * @param   Dev       Device Handle
+ * @return  VL53L0X_ERROR_NONE        Success
+ * @return  "Other error code"    See ::VL53L0X_Error
+ */
+VL53L0X_Error VL53L0X_EndBatch(VL53L0X_DEV Dev);
+
+/**
+ * Forget every shadowed register value so the next reads go to the device
+ *
+ * Reads of page 0 configuration registers which only change when written by
+ * the host (sequence config, VCSEL periods, timeouts, GPIO config, limits...)
+ * are served from a write-through copy in the device once known. The copy is
+ * dropped on soft reset and on any bus error; call this too if the device may
+ * have been reset behind the API's back.
+ * @param   Dev       Device Handle
+ */
+void VL53L0X_ShadowInvalidate(VL53L0X_DEV Dev);
+
+/**
+ * Number of register reads served from the shadow copy instead of the bus
+ * @return running count, wraps at 2^32
+ */
+uint32_t VL53L0X_GetShadowHitCount(void);
+
+/**
+ * Number of register reads the API asked for, whether served by the bus or
+ * the shadow copy
+ * @return running count, wraps at 2^32
+ */
+uint32_t VL53L0X_GetRegisterReadCount(void);
+
+/**
+ * Number of VL53L0X_PollingDelay calls, i.e. iterations of the API's and the
+ * application's wait-for-data-ready loops
+ * @return running count, wraps at 2^32
+ */
+uint32_t VL53L0X_GetPollingDelayCount(void);
+
 /** @} end of VL53L0X_registerAccess_group */
 
 